@@ -0,0 +1,81 @@
+#pragma once
+#include <benchmark/benchmark.h>
+#include <vtwrapper/vtwrapper.h>
+
+namespace bench
+{
+
+//! 計測対象とするノード数(10〜100k)
+inline void nodeCounts(benchmark::internal::Benchmark* b)
+{
+    b->RangeMultiplier(10)->Range(10, 100000);
+}
+
+//! 計測対象とするノード当たりのプロパティ数(1〜1k)
+inline void propertyCounts(benchmark::internal::Benchmark* b)
+{
+    b->RangeMultiplier(10)->Range(1, 1000);
+}
+
+//! 事前に生成したプロパティIDを返す。計測中のIdentifier生成コストを除外するため
+inline const std::vector<juce::Identifier>& getPropertyIds(int numProperties)
+{
+    static std::vector<juce::Identifier> ids;
+    while ((int)ids.size() < numProperties)
+        ids.push_back(juce::Identifier("p" + juce::String((int)ids.size())));
+    return ids;
+}
+
+//! numPropertiesのfloatプロパティを持つValueTreeを作成する
+inline juce::ValueTree createNode(const juce::Identifier& type, int numProperties)
+{
+    juce::ValueTree vt(type);
+    const auto& ids = getPropertyIds(numProperties);
+    for (int i = 0; i < numProperties; ++i)
+        vt.setProperty(ids[(size_t)i], (float)i, nullptr);
+    return vt;
+}
+
+//! numChildren個の子を持つValueTreeを作成する
+inline juce::ValueTree createList(const juce::Identifier& parentType, const juce::Identifier& childType, int numChildren, int numProperties)
+{
+    juce::ValueTree vt(parentType);
+    for (int i = 0; i < numChildren; ++i)
+        vt.appendChild(createNode(childType, numProperties), nullptr);
+    return vt;
+}
+
+//! 任意数のfloatプロパティをラップするWrappedTree
+class PropertyNode
+: public vtwrapper::WrappedTree
+{
+public:
+    PropertyNode() = default;
+    explicit PropertyNode(int numPropertiesToWrap) : numProperties(numPropertiesToWrap) {}
+    ~PropertyNode() override = default;
+
+    void wrapPropertiesAndChildren() override
+    {
+        const auto& ids = getPropertyIds(numProperties);
+        properties.resize((size_t)numProperties);
+        for (int i = 0; i < numProperties; ++i)
+        {
+            if (properties[(size_t)i] == nullptr)
+                properties[(size_t)i] = std::make_unique<vtwrapper::WrappedProperty<float>>();
+            properties[(size_t)i]->referTo(valueTree, ids[(size_t)i], undoManager);
+        }
+    }
+
+    int numProperties = 1;
+    std::vector<std::unique_ptr<vtwrapper::WrappedProperty<float>>> properties;
+};
+
+//! プロパティを持たないWrappedTree
+class EmptyNode
+: public vtwrapper::WrappedTree
+{
+public:
+    void wrapPropertiesAndChildren() override {}
+};
+
+} // namespace bench
@@ -0,0 +1,61 @@
+#include "BenchmarkUtility.h"
+
+//==============================================================================
+// 書き込み・読み込み: ValueTree::writeToStream()とBinaryTreeFormatの比較
+//==============================================================================
+static void BM_ValueTree_writeToStream(benchmark::State& state)
+{
+    auto vt = bench::createList("list", "item", (int)state.range(0), 8);
+
+    for (auto _ : state)
+    {
+        juce::MemoryOutputStream mo;
+        vt.writeToStream(mo);
+        benchmark::DoNotOptimize(mo.getData());
+        state.counters["bytes"] = (double)mo.getDataSize();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ValueTree_writeToStream)->Apply(bench::nodeCounts);
+
+static void BM_BinaryTreeFormat_writeToStream(benchmark::State& state)
+{
+    auto vt = bench::createList("list", "item", (int)state.range(0), 8);
+
+    for (auto _ : state)
+    {
+        juce::MemoryOutputStream mo;
+        vtwrapper::BinaryTreeFormat::writeToStream(vt, mo);
+        benchmark::DoNotOptimize(mo.getData());
+        state.counters["bytes"] = (double)mo.getDataSize();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BinaryTreeFormat_writeToStream)->Apply(bench::nodeCounts);
+
+static void BM_ValueTree_readFromStream(benchmark::State& state)
+{
+    auto vt = bench::createList("list", "item", (int)state.range(0), 8);
+    juce::MemoryOutputStream mo;
+    vt.writeToStream(mo);
+
+    for (auto _ : state)
+    {
+        juce::MemoryInputStream mi(mo.getData(), mo.getDataSize(), false);
+        benchmark::DoNotOptimize(juce::ValueTree::readFromStream(mi));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ValueTree_readFromStream)->Apply(bench::nodeCounts);
+
+static void BM_BinaryTreeFormat_readFromData(benchmark::State& state)
+{
+    auto vt = bench::createList("list", "item", (int)state.range(0), 8);
+    juce::MemoryOutputStream mo;
+    vtwrapper::BinaryTreeFormat::writeToStream(vt, mo);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(vtwrapper::BinaryTreeFormat::readFromData(mo.getData(), mo.getDataSize()));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BinaryTreeFormat_readFromData)->Apply(bench::nodeCounts);
@@ -0,0 +1,27 @@
+#include <benchmark/benchmark.h>
+#include <cstring>
+#include <vector>
+
+// 回帰検出用にデフォルトでJSON形式で出力する。
+// --benchmark_formatが明示的に指定された場合はそちらを優先する
+int main(int argc, char *argv[])
+{
+  std::vector<char*> args(argv, argv + argc);
+  bool hasFormat = false;
+  for (int i = 1; i < argc; ++i)
+    if (std::strncmp(argv[i], "--benchmark_format", 18) == 0)
+      hasFormat = true;
+
+  char jsonFormat[] = "--benchmark_format=json";
+  if (! hasFormat)
+    args.push_back(jsonFormat);
+
+  int numArgs = (int)args.size();
+  ::benchmark::Initialize(&numArgs, args.data());
+  if (::benchmark::ReportUnrecognizedArguments(numArgs, args.data()))
+    return 1;
+
+  ::benchmark::RunSpecifiedBenchmarks();
+  ::benchmark::Shutdown();
+  return 0;
+}
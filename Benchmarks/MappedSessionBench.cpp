@@ -0,0 +1,126 @@
+#include "BenchmarkUtility.h"
+
+namespace
+{
+//! 計測対象の要素数で作成したセッションファイル。計測終了時に削除される
+struct ScopedSessionFile
+{
+    explicit ScopedSessionFile(int numChildren)
+    {
+        auto vt = bench::createList("list", "item", numChildren, 8);
+        auto output = file.createOutputStream();
+        vtwrapper::MappedSession::writeToStream(vt, *output);
+    }
+    ~ScopedSessionFile() { file.deleteFile(); }
+
+    juce::File file = juce::File::createTempFile(".vtws");
+};
+
+constexpr int numVisibleItems = 50;
+}
+
+//==============================================================================
+// 読み込み後の最初のアクセス: ファイル全体の読み込みとメモリマップによる遅延読み込みの比較
+// 表示される先頭のnumVisibleItems要素のみにアクセスする
+//==============================================================================
+static void BM_BinaryTreeFormat_loadAndAccessVisible(benchmark::State& state)
+{
+    auto vt = bench::createList("list", "item", (int)state.range(0), 8);
+
+    juce::MemoryOutputStream mo;
+    vtwrapper::BinaryTreeFormat::writeToStream(vt, mo);
+
+    for (auto _ : state)
+    {
+        auto restored = vtwrapper::BinaryTreeFormat::readFromData(mo.getData(), mo.getDataSize());
+
+        vtwrapper::WrappedTreeList<bench::PropertyNode> list;
+        list.setLazyWrapping(true);
+        list.wrap(restored, "list", "item", nullptr);
+
+        for (int i = 0; i < juce::jmin(numVisibleItems, list.size()); ++i)
+            benchmark::DoNotOptimize(list[i]);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BinaryTreeFormat_loadAndAccessVisible)->Apply(bench::nodeCounts);
+
+static void BM_MappedSession_loadAndAccessVisible(benchmark::State& state)
+{
+    ScopedSessionFile sessionFile((int)state.range(0));
+
+    for (auto _ : state)
+    {
+        vtwrapper::MappedSession session(sessionFile.file);
+
+        vtwrapper::WrappedTreeList<bench::PropertyNode> list;
+        list.setLazyWrapping(true);
+        list.wrap(session.getRoot(), "list", "item", nullptr);
+
+        for (int i = 0; i < juce::jmin(numVisibleItems, list.size()); ++i)
+            benchmark::DoNotOptimize(list[i]);
+
+        state.counters["loadedNodes"] = session.getNumLoadedNodes();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MappedSession_loadAndAccessVisible)->Apply(bench::nodeCounts);
+
+//==============================================================================
+// 保存: 一要素のみ変更した場合の全体の書き込みと変更部分のみの書き込みの比較
+//==============================================================================
+static void BM_BinaryTreeFormat_saveAfterSingleChange(benchmark::State& state)
+{
+    auto vt = bench::createList("list", "item", (int)state.range(0), 8);
+
+    for (auto _ : state)
+    {
+        vt.getChild(0).setProperty("p0", (float)state.iterations(), nullptr);
+
+        juce::MemoryOutputStream mo;
+        vtwrapper::BinaryTreeFormat::writeToStream(vt, mo);
+        benchmark::DoNotOptimize(mo.getData());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BinaryTreeFormat_saveAfterSingleChange)->Apply(bench::nodeCounts);
+
+static void BM_MappedSession_saveAfterSingleChange(benchmark::State& state)
+{
+    ScopedSessionFile sessionFile((int)state.range(0));
+    vtwrapper::MappedSession session(sessionFile.file);
+
+    auto first = session.getRoot().getChild(0);
+    vtwrapper::MappedSession::ensureLoaded(first);
+
+    for (auto _ : state)
+    {
+        first.setProperty("p0", (float)state.iterations(), nullptr);
+
+        juce::MemoryOutputStream mo;
+        session.writeToStream(mo);
+        benchmark::DoNotOptimize(mo.getData());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_MappedSession_saveAfterSingleChange)->Apply(bench::nodeCounts);
+
+//==============================================================================
+// 編集: 読み込み済みの末尾の要素のプロパティを繰り返し変更する(スライダーの操作など)
+// 変更のたびに保存時の差分のための経路を記録する
+//==============================================================================
+static void BM_MappedSession_repeatedPropertyChange(benchmark::State& state)
+{
+    ScopedSessionFile sessionFile((int)state.range(0));
+    vtwrapper::MappedSession session(sessionFile.file);
+
+    auto last = session.getRoot().getChild(session.getRoot().getNumChildren() - 1);
+    vtwrapper::MappedSession::ensureLoaded(last);
+
+    float value = 0.0f;
+    for (auto _ : state)
+        last.setProperty("p0", value += 1.0f, nullptr);
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MappedSession_repeatedPropertyChange)->Apply(bench::nodeCounts);
@@ -0,0 +1,75 @@
+#include "BenchmarkUtility.h"
+
+//==============================================================================
+// 自動保存: 一要素のみ変更した場合の全体の書き込みと差分のみの書き込みの比較
+//==============================================================================
+static void BM_BinaryTreeFormat_autosaveAfterSingleChange(benchmark::State& state)
+{
+    auto vt = bench::createList("list", "item", (int)state.range(0), 8);
+
+    for (auto _ : state)
+    {
+        vt.getChild(0).setProperty("p0", (float)state.iterations(), nullptr);
+
+        juce::MemoryOutputStream mo;
+        vtwrapper::BinaryTreeFormat::writeToStream(vt, mo);
+        benchmark::DoNotOptimize(mo.getData());
+        state.counters["bytes"] = (double)mo.getDataSize();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BinaryTreeFormat_autosaveAfterSingleChange)->Apply(bench::nodeCounts);
+
+static void BM_DeltaRecorder_autosaveAfterSingleChange(benchmark::State& state)
+{
+    auto vt = bench::createList("list", "item", (int)state.range(0), 8);
+    vtwrapper::DeltaRecorder recorder(vt);
+
+    for (auto _ : state)
+    {
+        vt.getChild((int)state.range(0) - 1).setProperty("p0", (float)state.iterations(), nullptr);
+
+        auto deltas = recorder.takePendingDeltas();
+        benchmark::DoNotOptimize(deltas.getData());
+        state.counters["bytes"] = (double)deltas.getSize();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DeltaRecorder_autosaveAfterSingleChange)->Apply(bench::nodeCounts);
+
+//==============================================================================
+// 同期: 受信側での全体の読み込みと差分の適用の比較
+//==============================================================================
+static void BM_BinaryTreeFormat_syncAfterSingleChange(benchmark::State& state)
+{
+    auto vt = bench::createList("list", "item", (int)state.range(0), 8);
+    vt.getChild(0).setProperty("p0", 1.0f, nullptr);
+
+    juce::MemoryOutputStream mo;
+    vtwrapper::BinaryTreeFormat::writeToStream(vt, mo);
+
+    for (auto _ : state)
+    {
+        auto replica = vtwrapper::BinaryTreeFormat::readFromData(mo.getData(), mo.getDataSize());
+        benchmark::DoNotOptimize(replica);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BinaryTreeFormat_syncAfterSingleChange)->Apply(bench::nodeCounts);
+
+static void BM_DeltaPlayer_syncAfterSingleChange(benchmark::State& state)
+{
+    auto vt = bench::createList("list", "item", (int)state.range(0), 8);
+    auto replica = vt.createCopy();
+
+    vtwrapper::DeltaRecorder recorder(vt);
+    vtwrapper::DeltaPlayer player;
+
+    for (auto _ : state)
+    {
+        vt.getChild(0).setProperty("p0", (float)state.iterations(), nullptr);
+        benchmark::DoNotOptimize(player.apply(replica, recorder.takePendingDeltas()));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_DeltaPlayer_syncAfterSingleChange)->Apply(bench::nodeCounts);
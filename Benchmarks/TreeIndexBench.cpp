@@ -0,0 +1,84 @@
+#include "BenchmarkUtility.h"
+
+//==============================================================================
+// root → tracks → track[id] → plugins → plugin[id] の探索: 各階層の線形探索とTreeIndexの比較
+//==============================================================================
+static juce::ValueTree createSession(int numTracks, int numPlugins)
+{
+    juce::ValueTree root("root");
+    juce::ValueTree tracks("tracks");
+    root.appendChild(tracks, nullptr);
+
+    for (int t = 0; t < numTracks; ++t)
+    {
+        juce::ValueTree track("track");
+        track.setProperty("id", t, nullptr);
+        juce::ValueTree plugins("plugins");
+        for (int p = 0; p < numPlugins; ++p)
+        {
+            juce::ValueTree plugin("plugin");
+            plugin.setProperty("id", p, nullptr);
+            plugins.appendChild(plugin, nullptr);
+        }
+        track.appendChild(plugins, nullptr);
+        tracks.appendChild(track, nullptr);
+    }
+    return root;
+}
+
+static void BM_ValueTree_findDeep(benchmark::State& state)
+{
+    const int numTracks = (int)state.range(0);
+    auto root = createSession(numTracks, 8);
+
+    juce::Random random(1);
+    for (auto _ : state)
+    {
+        const int trackId = random.nextInt(numTracks);
+        auto track = root.getChildWithName("tracks").getChildWithProperty("id", trackId);
+        benchmark::DoNotOptimize(track.getChildWithName("plugins").getChildWithProperty("id", 7));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ValueTree_findDeep)->Arg(100)->Arg(1000)->Arg(10000);
+
+static void BM_TreeIndex_findDeep(benchmark::State& state)
+{
+    const int numTracks = (int)state.range(0);
+    auto root = createSession(numTracks, 8);
+    vtwrapper::TreeIndex index(root, "id");
+
+    juce::Random random(1);
+    for (auto _ : state)
+    {
+        const int trackId = random.nextInt(numTracks);
+        benchmark::DoNotOptimize(index.find({ { "tracks" }, { "track", trackId }, { "plugins" }, { "plugin", 7 } }));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TreeIndex_findDeep)->Arg(100)->Arg(1000)->Arg(10000);
+
+//==============================================================================
+// 索引の更新のコスト: 深い位置への子の追加削除
+//==============================================================================
+static void BM_TreeIndex_appendAndRemoveDeep(benchmark::State& state)
+{
+    const int numTracks = (int)state.range(0);
+    const bool withIndex = state.range(1) != 0;
+    auto root = createSession(numTracks, 8);
+
+    vtwrapper::TreeIndex index;
+    if (withIndex)
+        index.attachTo(root, "id");
+
+    auto plugins = root.getChild(0).getChild(numTracks / 2).getChild(0);
+    for (auto _ : state)
+    {
+        juce::ValueTree plugin("plugin");
+        plugin.setProperty("id", 100, nullptr);
+        plugins.appendChild(plugin, nullptr);
+        plugins.removeChild(plugin, nullptr);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TreeIndex_appendAndRemoveDeep)->ArgsProduct({ { 100, 10000 }, { 0, 1 } })->ArgNames({ "tracks", "index" });
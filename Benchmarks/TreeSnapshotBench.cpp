@@ -0,0 +1,42 @@
+#include "BenchmarkUtility.h"
+
+//==============================================================================
+// ひとつのプロパティを変更した後にワーカースレッド向けの読み取り用データを作成するコスト
+// ValueTree::createCopy()による全体の複製とSnapshotBuilderによる差分の作り直しの比較
+//==============================================================================
+static void BM_ValueTree_createCopyAfterChange(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    auto vt = bench::createList("list", "item", numChildren, 4);
+    const auto& id = bench::getPropertyIds(1)[0];
+
+    float value = 0.0f;
+    for (auto _ : state)
+    {
+        vt.getChild(numChildren / 2).setProperty(id, value, nullptr);
+        benchmark::DoNotOptimize(vt.createCopy());
+        value += 1.0f;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ValueTree_createCopyAfterChange)->Apply(bench::nodeCounts);
+
+static void BM_SnapshotBuilder_publishAfterChange(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    auto vt = bench::createList("list", "item", numChildren, 4);
+    const auto& id = bench::getPropertyIds(1)[0];
+
+    vtwrapper::SnapshotBuilder builder(vt);
+    builder.publish();
+
+    float value = 0.0f;
+    for (auto _ : state)
+    {
+        vt.getChild(numChildren / 2).setProperty(id, value, nullptr);
+        benchmark::DoNotOptimize(builder.publish());
+        value += 1.0f;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SnapshotBuilder_publishAfterChange)->Apply(bench::nodeCounts);
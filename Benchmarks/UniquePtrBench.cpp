@@ -0,0 +1,78 @@
+#include "BenchmarkUtility.h"
+
+//==============================================================================
+// referTo(): 兄弟ノード数に対するコスト(対象の子は末尾に置く)
+//==============================================================================
+static void BM_ValueTree_getChildWithName(benchmark::State& state)
+{
+    const int numSiblings = (int)state.range(0);
+    auto vt = bench::createList("root", "sibling", numSiblings, 0);
+    vt.appendChild(juce::ValueTree("target"), nullptr);
+    const juce::Identifier targetType("target");
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(vt.getChildWithName(targetType));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ValueTree_getChildWithName)->Apply(bench::nodeCounts);
+
+static void BM_UniquePtr_referTo(benchmark::State& state)
+{
+    const int numSiblings = (int)state.range(0);
+    auto vt = bench::createList("root", "sibling", numSiblings, 0);
+    vt.appendChild(juce::ValueTree("target"), nullptr);
+    const juce::Identifier targetType("target");
+
+    vtwrapper::UniquePtr<bench::EmptyNode> ptr;
+    for (auto _ : state)
+        ptr.referTo(vt, targetType, nullptr);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_UniquePtr_referTo)->Apply(bench::nodeCounts);
+
+//==============================================================================
+// 親への追加削除に追従したポインタの同期
+//==============================================================================
+static void BM_UniquePtr_toggleParent(benchmark::State& state)
+{
+    const int numProperties = (int)state.range(0);
+    juce::ValueTree vt("root");
+    auto child = bench::createNode("target", numProperties);
+    vt.appendChild(child, nullptr);
+
+    vtwrapper::UniquePtr<bench::EmptyNode> ptr;
+    ptr.referTo(vt, "target", nullptr);
+    for (auto _ : state)
+    {
+        vt.removeChild(child, nullptr);
+        vt.appendChild(child, nullptr);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_UniquePtr_toggleParent)->Apply(bench::propertyCounts);
+
+//==============================================================================
+// Undoによる追加削除の切り替え: 親から外れたオブジェクトを破棄する場合と保持して再利用する場合の比較
+//==============================================================================
+static void BM_UniquePtr_toggleWithUndo(benchmark::State& state)
+{
+    const int numProperties = (int)state.range(0);
+    const bool retain = state.range(1) != 0;
+    juce::UndoManager um;
+    juce::ValueTree vt("root");
+    vt.appendChild(bench::createNode("target", numProperties), nullptr);
+
+    vtwrapper::UniquePtr<bench::PropertyNode> ptr([numProperties] { return new bench::PropertyNode(numProperties); });
+    ptr.setRetainDetached(retain);
+    ptr.referTo(vt, "target", &um);
+
+    um.beginNewTransaction();
+    ptr.deactivate();
+    for (auto _ : state)
+    {
+        um.undo();
+        um.redo();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_UniquePtr_toggleWithUndo)->ArgsProduct({ { 1, 16, 64 }, { 0, 1 } })->ArgNames({ "properties", "retain" });
@@ -0,0 +1,252 @@
+#include "BenchmarkUtility.h"
+#include <numeric>
+
+//==============================================================================
+// set(): ノード当たりのプロパティ数に対するコスト
+//==============================================================================
+static void BM_ValueTree_setProperty(benchmark::State& state)
+{
+    const int numProperties = (int)state.range(0);
+    auto vt = bench::createNode("node", numProperties);
+    const auto& id = bench::getPropertyIds(numProperties)[(size_t)numProperties - 1];
+
+    float value = 0.0f;
+    for (auto _ : state)
+    {
+        vt.setProperty(id, value, nullptr);
+        value += 1.0f;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ValueTree_setProperty)->Apply(bench::propertyCounts);
+
+static void BM_CachedValue_set(benchmark::State& state)
+{
+    const int numProperties = (int)state.range(0);
+    auto vt = bench::createNode("node", numProperties);
+    const auto& ids = bench::getPropertyIds(numProperties);
+
+    // ノード上の全プロパティをCachedValueで保持し、リスナー数もWrappedPropertyと揃える
+    std::vector<std::unique_ptr<juce::CachedValue<float>>> values;
+    for (int i = 0; i < numProperties; ++i)
+        values.push_back(std::make_unique<juce::CachedValue<float>>(vt, ids[(size_t)i], nullptr));
+
+    auto& target = *values.back();
+    float value = 0.0f;
+    for (auto _ : state)
+    {
+        target = value;
+        value += 1.0f;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CachedValue_set)->Apply(bench::propertyCounts);
+
+static void BM_WrappedProperty_set(benchmark::State& state)
+{
+    const int numProperties = (int)state.range(0);
+    bench::PropertyNode node(numProperties);
+    node.wrap(bench::createNode("node", numProperties), "node", nullptr);
+
+    auto& target = *node.properties.back();
+    float value = 0.0f;
+    for (auto _ : state)
+    {
+        target.set(value);
+        value += 1.0f;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WrappedProperty_set)->Apply(bench::propertyCounts);
+
+//==============================================================================
+// get()
+//==============================================================================
+static void BM_ValueTree_getProperty(benchmark::State& state)
+{
+    const int numProperties = (int)state.range(0);
+    auto vt = bench::createNode("node", numProperties);
+    const auto& id = bench::getPropertyIds(numProperties)[(size_t)numProperties - 1];
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize((float)vt[id]);
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ValueTree_getProperty)->Apply(bench::propertyCounts);
+
+static void BM_WrappedProperty_get(benchmark::State& state)
+{
+    const int numProperties = (int)state.range(0);
+    bench::PropertyNode node(numProperties);
+    node.wrap(bench::createNode("node", numProperties), "node", nullptr);
+
+    auto& target = *node.properties.back();
+    for (auto _ : state)
+        benchmark::DoNotOptimize(target.get());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WrappedProperty_get)->Apply(bench::propertyCounts);
+
+//==============================================================================
+// 制限処理・変更コールバックの型によるset()のコストおよびプロパティ当たりのメモリ
+// bytesPerPropertyはWrappedPropertyオブジェクト自体のサイズ(ValueTree側のメモリは含まない)
+//==============================================================================
+template <typename PropertyType>
+static void BM_WrappedProperty_setConstrained(benchmark::State& state, PropertyType& property)
+{
+    int numCalls = 0;
+    property.onChange = [&numCalls]() { ++numCalls; };
+
+    float value = -2.0f;
+    for (auto _ : state)
+    {
+        property.set(value);
+        value = value > 2.0f ? -2.0f : value + 0.25f;
+    }
+    benchmark::DoNotOptimize(numCalls);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["bytesPerProperty"] = (double)sizeof(PropertyType);
+}
+
+static void BM_WrappedProperty_setDynamicConstrainer(benchmark::State& state)
+{
+    juce::ValueTree vt("node");
+    vtwrapper::WrappedProperty<float> property(vt, "value", nullptr);
+    property.setConstrainer([](float& v, bool) { v = juce::jlimit(-1.0f, 1.0f, v); });
+    BM_WrappedProperty_setConstrained(state, property);
+}
+BENCHMARK(BM_WrappedProperty_setDynamicConstrainer);
+
+static void BM_WrappedProperty_setRangeConstrainer(benchmark::State& state)
+{
+    juce::ValueTree vt("node");
+    vtwrapper::WrappedProperty<float, vtwrapper::RangeConstrainer<float>> property(vt, "value", nullptr);
+    property.setConstrainer({ -1.0f, 1.0f });
+    BM_WrappedProperty_setConstrained(state, property);
+}
+BENCHMARK(BM_WrappedProperty_setRangeConstrainer);
+
+static void BM_WrappedProperty_setRangeConstrainerFixedCallback(benchmark::State& state)
+{
+    juce::ValueTree vt("node");
+    vtwrapper::WrappedProperty<float, vtwrapper::RangeConstrainer<float>, juce::FixedSizeFunction<sizeof(void*), void()>> property(vt, "value", nullptr);
+    property.setConstrainer({ -1.0f, 1.0f });
+    BM_WrappedProperty_setConstrained(state, property);
+}
+BENCHMARK(BM_WrappedProperty_setRangeConstrainerFixedCallback);
+
+static void BM_WrappedProperty_sizeWithoutConstrainer(benchmark::State& state)
+{
+    for (auto _ : state) {}
+    state.counters["bytesPerProperty"] = (double)sizeof(vtwrapper::WrappedProperty<float, vtwrapper::NoConstrainer<float>, juce::FixedSizeFunction<sizeof(void*), void()>>);
+}
+BENCHMARK(BM_WrappedProperty_sizeWithoutConstrainer)->Iterations(1);
+
+//==============================================================================
+// 外部からのプロパティ変更: ノード当たりのプロパティ数に対するコスト
+// 制限処理を設定した状態で、範囲内の値(書き戻し不要)を書き込む
+//==============================================================================
+static void BM_WrappedProperty_externalChangeConstrained(benchmark::State& state)
+{
+    const int numProperties = (int)state.range(0);
+    auto vt = bench::createNode("node", numProperties);
+    bench::PropertyNode node(numProperties);
+    node.wrap(vt, "node", nullptr);
+
+    const auto& id = bench::getPropertyIds(numProperties)[(size_t)numProperties - 1];
+    node.properties.back()->setConstrainer([](float& v, bool) { v = juce::jlimit(0.0f, 1.0f, v); });
+
+    float value = 0.0f;
+    for (auto _ : state)
+    {
+        vt.setProperty(id, value, nullptr);
+        value = value >= 1.0f ? 0.0f : value + 0.125f;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WrappedProperty_externalChangeConstrained)->Apply(bench::propertyCounts);
+
+//==============================================================================
+// ドラッグ中のset(): 一回の書き込みごとにトランザクションを区切った場合のUndo履歴の量
+//==============================================================================
+static void BM_WrappedProperty_dragWithUndo(benchmark::State& state)
+{
+    juce::UndoManager um(std::numeric_limits<int>::max(), 0);
+    auto vt = bench::createNode("node", 1);
+    vtwrapper::WrappedProperty<float> property(vt, "gain", &um, 0.0f);
+
+    float value = 0.0f;
+    for (auto _ : state)
+    {
+        um.beginNewTransaction();
+        property.set(value);
+        value += 1.0f;
+    }
+    state.counters["undoUnits"] = um.getNumberOfUnitsTakenUpByStoredCommands();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WrappedProperty_dragWithUndo);
+
+static void BM_WrappedProperty_dragWithCoalescedUndo(benchmark::State& state)
+{
+    juce::UndoManager um(std::numeric_limits<int>::max(), 0);
+    auto vt = bench::createNode("node", 1);
+    vtwrapper::WrappedProperty<float> property(vt, "gain", &um, 0.0f);
+    property.beginGesture();
+
+    float value = 0.0f;
+    for (auto _ : state)
+    {
+        um.beginNewTransaction();
+        property.set(value);
+        value += 1.0f;
+    }
+    property.endGesture();
+    state.counters["undoUnits"] = um.getNumberOfUnitsTakenUpByStoredCommands();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WrappedProperty_dragWithCoalescedUndo);
+
+//==============================================================================
+// 連続した変更: onChangeで再計算を行う場合に、同期的に通知するか非同期にまとめるかの比較
+// 一回の反復で全プロパティに1000回ずつ書き込み、async=1ではその後に一度だけ配信する
+//==============================================================================
+static void BM_WrappedProperty_burstWithChangeCallback(benchmark::State& state)
+{
+    const int numProperties = 10;
+    const bool isAsync = state.range(0) != 0;
+    vtwrapper::AsyncChangeQueue queue;
+    auto vt = bench::createNode("node", numProperties);
+
+    std::vector<float> data(1000, 1.0f);
+    int numCallbacks = 0;
+
+    juce::OwnedArray<vtwrapper::WrappedProperty<float>> properties;
+    const auto& ids = bench::getPropertyIds(numProperties);
+    for (int i = 0; i < numProperties; ++i)
+    {
+        auto* property = properties.add(new vtwrapper::WrappedProperty<float>(vt, ids[(size_t)i], nullptr, 0.0f));
+        property->setAsyncChangeNotification(isAsync, queue);
+        property->onChange = [&]
+        {
+            // 再描画や再計算の代わり
+            ++numCallbacks;
+            benchmark::DoNotOptimize(std::accumulate(data.begin(), data.end(), 0.0f));
+        };
+    }
+
+    float value = 0.0f;
+    for (auto _ : state)
+    {
+        for (int i = 0; i < 1000; ++i)
+        {
+            value += 1.0f;
+            for (auto* property : properties)
+                property->set(value);
+        }
+        queue.flush();
+    }
+    state.counters["callbacks"] = benchmark::Counter((double)numCallbacks, benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(state.iterations() * 1000 * numProperties);
+}
+BENCHMARK(BM_WrappedProperty_burstWithChangeCallback)->Arg(0)->Arg(1)->ArgName("async");
@@ -0,0 +1,136 @@
+#include "BenchmarkUtility.h"
+
+//==============================================================================
+// wrap(): ノード当たりのプロパティ数に対するコスト
+//==============================================================================
+static void BM_CachedValue_referToAll(benchmark::State& state)
+{
+    const int numProperties = (int)state.range(0);
+    auto vt = bench::createNode("node", numProperties);
+    const auto& ids = bench::getPropertyIds(numProperties);
+
+    std::vector<juce::CachedValue<float>> values((size_t)numProperties);
+    for (auto _ : state)
+    {
+        for (int i = 0; i < numProperties; ++i)
+            values[(size_t)i].referTo(vt, ids[(size_t)i], nullptr);
+    }
+    state.SetItemsProcessed(state.iterations() * numProperties);
+}
+BENCHMARK(BM_CachedValue_referToAll)->Apply(bench::propertyCounts);
+
+static void BM_WrappedTree_wrap(benchmark::State& state)
+{
+    const int numProperties = (int)state.range(0);
+    auto vt = bench::createNode("node", numProperties);
+
+    bench::PropertyNode node(numProperties);
+    for (auto _ : state)
+        node.wrap(vt, "node", nullptr, false, false);
+    state.SetItemsProcessed(state.iterations() * numProperties);
+}
+BENCHMARK(BM_WrappedTree_wrap)->Apply(bench::propertyCounts);
+
+//==============================================================================
+// 全プロパティがリッスンされているノードへの書き込み
+//==============================================================================
+static void BM_WrappedTree_setAllProperties(benchmark::State& state)
+{
+    const int numProperties = (int)state.range(0);
+    bench::PropertyNode node(numProperties);
+    node.wrap(bench::createNode("node", numProperties), "node", nullptr);
+
+    float value = 0.0f;
+    for (auto _ : state)
+    {
+        for (auto& p : node.properties)
+            p->set(value);
+        value += 1.0f;
+    }
+    state.SetItemsProcessed(state.iterations() * numProperties);
+}
+BENCHMARK(BM_WrappedTree_setAllProperties)->Apply(bench::propertyCounts);
+
+static void BM_WrappedTree_setAllPropertiesInTransaction(benchmark::State& state)
+{
+    const int numProperties = (int)state.range(0);
+    juce::UndoManager um;
+    bench::PropertyNode node(numProperties);
+    node.wrap(bench::createNode("node", numProperties), "node", &um);
+
+    float value = 0.0f;
+    for (auto _ : state)
+    {
+        vtwrapper::WrappedTree::ScopedTransaction transaction(node);
+        for (auto& p : node.properties)
+        {
+            p->set(value);
+            p->set(value + 0.5f); // 同じプロパティへの書き込みはまとめられる
+        }
+        value += 1.0f;
+    }
+    state.SetItemsProcessed(state.iterations() * numProperties);
+}
+BENCHMARK(BM_WrappedTree_setAllPropertiesInTransaction)->Apply(bench::propertyCounts);
+
+//==============================================================================
+// wrap(): 8プロパティの紐付けで、文字列リテラルからjuce::Identifierを作成する場合と
+// PropertySchemaで事前に作成したjuce::Identifierを用いる場合の比較
+//==============================================================================
+namespace
+{
+class LiteralIdNode
+: public vtwrapper::WrappedTree
+{
+public:
+    void wrapPropertiesAndChildren() override
+    {
+        p0.referTo(valueTree, "p0", undoManager);
+        p1.referTo(valueTree, "p1", undoManager);
+        p2.referTo(valueTree, "p2", undoManager);
+        p3.referTo(valueTree, "p3", undoManager);
+        p4.referTo(valueTree, "p4", undoManager);
+        p5.referTo(valueTree, "p5", undoManager);
+        p6.referTo(valueTree, "p6", undoManager);
+        p7.referTo(valueTree, "p7", undoManager);
+    }
+
+    vtwrapper::WrappedProperty<float, vtwrapper::NoConstrainer<float>> p0, p1, p2, p3, p4, p5, p6, p7;
+};
+
+class SchemaNode
+: public vtwrapper::WrappedTree
+{
+public:
+    using Def = vtwrapper::PropertyDef<float>;
+    using Schema = vtwrapper::PropertySchema<Def, Def, Def, Def, Def, Def, Def, Def>;
+
+    static const Schema& getSchema()
+    {
+        static const Schema schema { { "p0" }, { "p1" }, { "p2" }, { "p3" }, { "p4" }, { "p5" }, { "p6" }, { "p7" } };
+        return schema;
+    }
+
+    void wrapPropertiesAndChildren() override { getSchema().bind(properties, valueTree, undoManager); }
+
+    Schema::Properties properties;
+};
+
+template <typename NodeType>
+void wrapEightProperties(benchmark::State& state)
+{
+    auto vt = bench::createNode("node", 8);
+    const juce::Identifier nodeType("node");
+
+    NodeType node;
+    for (auto _ : state)
+        node.wrap(vt, nodeType, nullptr, false, false);
+    state.SetItemsProcessed(state.iterations() * 8);
+}
+}
+
+static void BM_WrappedTree_wrapLiteralIds(benchmark::State& state) { wrapEightProperties<LiteralIdNode>(state); }
+BENCHMARK(BM_WrappedTree_wrapLiteralIds);
+
+static void BM_PropertySchema_bind(benchmark::State& state) { wrapEightProperties<SchemaNode>(state); }
+BENCHMARK(BM_PropertySchema_bind);
@@ -0,0 +1,442 @@
+#include "BenchmarkUtility.h"
+
+//==============================================================================
+// wrap(): 子ノード数に対するコスト
+//==============================================================================
+static void BM_ValueTree_iterateChildren(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    auto vt = bench::createList("list", "item", numChildren, 1);
+    const auto& id = bench::getPropertyIds(1)[0];
+
+    for (auto _ : state)
+    {
+        float sum = 0.0f;
+        for (auto child : vt)
+            sum += (float)child[id];
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * numChildren);
+}
+BENCHMARK(BM_ValueTree_iterateChildren)->Apply(bench::nodeCounts);
+
+static void BM_WrappedTreeList_wrap(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    auto vt = bench::createList("list", "item", numChildren, 1);
+
+    vtwrapper::WrappedTreeList<bench::PropertyNode> list;
+    for (auto _ : state)
+        list.wrap(vt, "list", "item", nullptr, false, false);
+    state.SetItemsProcessed(state.iterations() * numChildren);
+}
+BENCHMARK(BM_WrappedTreeList_wrap)->Apply(bench::nodeCounts);
+
+namespace
+{
+struct EightPropertyNode : bench::PropertyNode
+{
+    EightPropertyNode() : PropertyNode(8) {}
+};
+}
+
+//! 8プロパティを持つ要素をpoolのスレッド数を変えてwrap()する。0はsetParallelWrapping()を使用しない
+static void BM_WrappedTreeList_wrapParallel(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    const int numThreads = (int)state.range(1);
+    auto vt = bench::createList("list", "item", numChildren, 8);
+
+    juce::ThreadPool pool(juce::jmax(1, numThreads));
+    vtwrapper::WrappedTreeList<EightPropertyNode> list;
+    if (numThreads > 0)
+        list.setParallelWrapping(&pool);
+
+    for (auto _ : state)
+        list.wrap(vt, "list", "item", nullptr, false, false);
+
+    state.SetItemsProcessed(state.iterations() * numChildren);
+}
+BENCHMARK(BM_WrappedTreeList_wrapParallel)->ArgsProduct({ { 10000, 100000 }, { 0, 1, 3, 7 } })->ArgNames({ "children", "threads" })->UseRealTime();
+
+static void BM_WrappedTreeList_rewrapReusingChildren(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    auto vt = bench::createList("list", "item", numChildren, 1);
+
+    vtwrapper::WrappedTreeList<bench::PropertyNode> list;
+    list.setReuseChildrenOnWrap(true);
+    list.wrap(vt, "list", "item", nullptr, false, false);
+
+    for (auto _ : state)
+        list.wrap(vt, "list", "item", nullptr, false, false);
+    state.SetItemsProcessed(state.iterations() * numChildren);
+}
+BENCHMARK(BM_WrappedTreeList_rewrapReusingChildren)->Apply(bench::nodeCounts);
+
+// プリセットの読み込みなど、子が全て別のValueTreeに置き換えられた場合の再wrap
+static void BM_WrappedTreeList_rewrapOntoFreshChildren(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    juce::ValueTree trees[] = { bench::createList("list", "item", numChildren, 1), bench::createList("list", "item", numChildren, 1) };
+
+    vtwrapper::WrappedTreeList<bench::PropertyNode> list;
+    list.setReuseChildrenOnWrap(true);
+    list.wrap(trees[0], "list", "item", nullptr, false, false);
+
+    int next = 1;
+    for (auto _ : state)
+    {
+        list.wrap(trees[next], "list", "item", nullptr, false, false);
+        next = 1 - next;
+    }
+    state.SetItemsProcessed(state.iterations() * numChildren);
+}
+BENCHMARK(BM_WrappedTreeList_rewrapOntoFreshChildren)->Apply(bench::nodeCounts);
+
+static void BM_WrappedTreeList_iterate(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    auto vt = bench::createList("list", "item", numChildren, 1);
+
+    vtwrapper::WrappedTreeList<bench::PropertyNode> list;
+    list.wrap(vt, "list", "item", nullptr, false, false);
+
+    for (auto _ : state)
+    {
+        float sum = 0.0f;
+        for (auto* item : list)
+            sum += item->properties[0]->get();
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * numChildren);
+}
+BENCHMARK(BM_WrappedTreeList_iterate)->Apply(bench::nodeCounts);
+
+//==============================================================================
+// ValueTree経由での子の追加削除
+//==============================================================================
+template <typename Allocator>
+static void BM_WrappedTreeList_appendAndRemoveChild(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    auto vt = bench::createList("list", "item", numChildren, 1);
+
+    vtwrapper::WrappedTreeList<bench::PropertyNode, Allocator> list;
+    list.wrap(vt, "list", "item", nullptr, false, false);
+
+    for (auto _ : state)
+    {
+        vt.appendChild(bench::createNode("item", 1), nullptr);
+        vt.removeChild(numChildren, nullptr);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_WrappedTreeList_appendAndRemoveChild, vtwrapper::HeapAllocator<bench::PropertyNode>)->Apply(bench::nodeCounts);
+BENCHMARK_TEMPLATE(BM_WrappedTreeList_appendAndRemoveChild, vtwrapper::PooledAllocator<bench::PropertyNode>)->Apply(bench::nodeCounts);
+
+//==============================================================================
+// 追加削除を繰り返した後の全要素の走査: 型ごとに共有されるPooledAllocatorと、リストごとのChunkedAllocatorの比較
+// storage=1ではforEachInStorageOrder()でメモリ上の順に走査する
+//==============================================================================
+template <typename Allocator>
+static void BM_WrappedTreeList_iterateAfterChurn(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    const bool inStorageOrder = state.range(1) != 0;
+    auto vt = bench::createList("list", "item", numChildren, 1);
+    auto otherVt = bench::createList("list", "item", numChildren, 1);
+
+    vtwrapper::WrappedTreeList<bench::PropertyNode, Allocator> list, other;
+    list.wrap(vt, "list", "item", nullptr, false, false);
+    other.wrap(otherVt, "list", "item", nullptr, false, false);
+
+    // 2つのリストで交互に追加削除し、要素をメモリ上で散らばらせる
+    juce::Random random(1);
+    for (int i = 0; i < numChildren; ++i)
+    {
+        for (auto* tree : { &vt, &otherVt })
+        {
+            tree->removeChild(random.nextInt(numChildren), nullptr);
+            tree->addChild(bench::createNode("item", 1), random.nextInt(numChildren), nullptr);
+        }
+    }
+
+    for (auto _ : state)
+    {
+        float sum = 0.0f;
+        if constexpr (std::is_same_v<Allocator, vtwrapper::PooledAllocator<bench::PropertyNode>>)
+        {
+            for (auto* item : list)
+                sum += item->properties[0]->get();
+        }
+        else
+        {
+            if (inStorageOrder)
+                list.forEachInStorageOrder([&](bench::PropertyNode& item) { sum += item.properties[0]->get(); });
+            else
+                for (auto* item : list)
+                    sum += item->properties[0]->get();
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * numChildren);
+}
+BENCHMARK_TEMPLATE(BM_WrappedTreeList_iterateAfterChurn, vtwrapper::PooledAllocator<bench::PropertyNode>)->ArgsProduct({ { 1000, 100000 }, { 0 } })->ArgNames({ "children", "storage" });
+BENCHMARK_TEMPLATE(BM_WrappedTreeList_iterateAfterChurn, vtwrapper::ChunkedAllocator<bench::PropertyNode>)->ArgsProduct({ { 1000, 100000 }, { 0, 1 } })->ArgNames({ "children", "storage" });
+
+//==============================================================================
+// 要素の一括追加: add()の繰り返しとaddRange()の比較
+//==============================================================================
+static void BM_WrappedTreeList_addEach(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    juce::UndoManager um;
+
+    for (auto _ : state)
+    {
+        juce::ValueTree vt("list");
+        vtwrapper::WrappedTreeList<bench::EmptyNode> list;
+        list.wrap(vt, "list", "item", &um);
+
+        for (int i = 0; i < numChildren; ++i)
+        {
+            um.beginNewTransaction();
+            list.add(new bench::EmptyNode());
+        }
+        um.clearUndoHistory();
+    }
+    state.SetItemsProcessed(state.iterations() * numChildren);
+}
+BENCHMARK(BM_WrappedTreeList_addEach)->Apply(bench::nodeCounts);
+
+static void BM_WrappedTreeList_addRange(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    juce::UndoManager um;
+
+    for (auto _ : state)
+    {
+        juce::ValueTree vt("list");
+        vtwrapper::WrappedTreeList<bench::EmptyNode> list;
+        list.wrap(vt, "list", "item", &um);
+
+        juce::Array<bench::EmptyNode*> items;
+        items.ensureStorageAllocated(numChildren);
+        for (int i = 0; i < numChildren; ++i)
+            items.add(new bench::EmptyNode());
+
+        list.addRange(items);
+        um.clearUndoHistory();
+    }
+    state.SetItemsProcessed(state.iterations() * numChildren);
+}
+BENCHMARK(BM_WrappedTreeList_addRange)->Apply(bench::nodeCounts);
+
+//==============================================================================
+// キーによる要素の検索: 線形探索とsetIndexKey()による索引の比較
+//==============================================================================
+static juce::ValueTree createKeyedList(int numChildren)
+{
+    juce::ValueTree vt("list");
+    for (int i = 0; i < numChildren; ++i)
+        vt.appendChild(juce::ValueTree("item").setProperty("id", i, nullptr), nullptr);
+    return vt;
+}
+
+static void BM_WrappedTreeList_findLinear(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    auto vt = createKeyedList(numChildren);
+
+    vtwrapper::WrappedTreeList<bench::EmptyNode> list;
+    list.wrap(vt, "list", "item", nullptr, false, false);
+
+    const juce::Identifier id("id");
+    int key = 0;
+    for (auto _ : state)
+    {
+        const juce::var target(key);
+        bench::EmptyNode* found = nullptr;
+        for (auto* item : list)
+        {
+            if (item->getValueTree()[id] == target)
+            {
+                found = item;
+                break;
+            }
+        }
+        benchmark::DoNotOptimize(found);
+        key = (key + 7919) % numChildren;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WrappedTreeList_findLinear)->Apply(bench::nodeCounts);
+
+static void BM_WrappedTreeList_findIndexed(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    auto vt = createKeyedList(numChildren);
+
+    vtwrapper::WrappedTreeList<bench::EmptyNode> list;
+    list.wrap(vt, "list", "item", nullptr, false, false);
+    list.setIndexKey("id");
+
+    int key = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(list.find(key));
+        key = (key + 7919) % numChildren;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WrappedTreeList_findIndexed)->Apply(bench::nodeCounts);
+
+// 索引のキーとなるプロパティを変更するコスト。要素数に依存しないはず
+static void BM_WrappedTreeList_changeIndexedKey(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    auto vt = createKeyedList(numChildren);
+
+    vtwrapper::WrappedTreeList<bench::EmptyNode> list;
+    list.wrap(vt, "list", "item", nullptr, false, false);
+    list.setIndexKey("id");
+
+    const juce::Identifier id("id");
+    int index = 0;
+    int nextKey = numChildren;
+    for (auto _ : state)
+    {
+        vt.getChild(index).setProperty(id, nextKey++, nullptr);
+        index = (index + 7919) % numChildren;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WrappedTreeList_changeIndexedKey)->Apply(bench::nodeCounts);
+
+//==============================================================================
+// 遅延作成: wrap()後に先頭の一部の要素のみアクセスする場合のコスト
+//==============================================================================
+static void BM_WrappedTreeList_wrapAndAccessVisible(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    const bool lazy = state.range(1) != 0;
+    const int numVisible = juce::jmin(numChildren, 200);
+    auto vt = bench::createList("list", "item", numChildren, 4);
+
+    for (auto _ : state)
+    {
+        // WrappedTreeListの破棄時に子ValueTreeも削除されるため、毎回複製したものを用いる
+        state.PauseTiming();
+        auto target = vt.createCopy();
+        state.ResumeTiming();
+
+        vtwrapper::WrappedTreeList<bench::PropertyNode> list;
+        list.setLazyWrapping(lazy);
+        list.wrap(target, "list", "item", nullptr, false, false);
+
+        float sum = 0.0f;
+        for (int i = 0; i < numVisible; ++i)
+            sum += list[i]->properties[0]->get();
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * numChildren);
+}
+BENCHMARK(BM_WrappedTreeList_wrapAndAccessVisible)->ArgsProduct({ { 1000, 10000, 100000 }, { 0, 1 } })->ArgNames({ "children", "lazy" });
+
+//==============================================================================
+// 並び順の維持: 一要素のキーを変更するごとに全体をsort()する場合と、変更された要素のみ移動する場合の比較
+// キーはp0。createList()では要素の順に昇順となっている
+//==============================================================================
+static void BM_WrappedTreeList_sortAfterEdit(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    auto vt = bench::createList("list", "item", numChildren, 1);
+
+    vtwrapper::WrappedTreeList<bench::PropertyNode> list;
+    list.wrap(vt, "list", "item", nullptr);
+    vtwrapper::PropertyComparator comparator("p0");
+
+    juce::Random random(1);
+    for (auto _ : state)
+    {
+        list[random.nextInt(numChildren)]->properties[0]->set(random.nextFloat() * (float)numChildren);
+        list.sort(comparator, true);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WrappedTreeList_sortAfterEdit)->Apply(bench::nodeCounts);
+
+static void BM_SortedWrappedTreeList_edit(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    auto vt = bench::createList("list", "item", numChildren, 1);
+
+    vtwrapper::SortedWrappedTreeList<bench::PropertyNode> list(vtwrapper::PropertyComparator("p0"));
+    list.wrap(vt, "list", "item", nullptr);
+
+    juce::Random random(1);
+    for (auto _ : state)
+        list[random.nextInt(numChildren)]->properties[0]->set(random.nextFloat() * (float)numChildren);
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SortedWrappedTreeList_edit)->Apply(bench::nodeCounts);
+
+//==============================================================================
+// 全要素のプロパティの読み出し: 要素ごとにポインタを辿る場合と、PropertyColumnの連続した配列から読み出す場合の比較
+//==============================================================================
+static void BM_WrappedTreeList_sumProperty(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    auto vt = bench::createList("list", "item", numChildren, 1);
+
+    vtwrapper::WrappedTreeList<bench::PropertyNode> list;
+    list.wrap(vt, "list", "item", nullptr);
+
+    for (auto _ : state)
+    {
+        float sum = 0.0f;
+        for (auto* item : list)
+            sum += item->properties[0]->get();
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * numChildren);
+}
+BENCHMARK(BM_WrappedTreeList_sumProperty)->Apply(bench::nodeCounts);
+
+static void BM_PropertyColumn_sum(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    auto vt = bench::createList("list", "item", numChildren, 1);
+
+    vtwrapper::WrappedTreeList<bench::PropertyNode> list;
+    list.wrap(vt, "list", "item", nullptr);
+    vtwrapper::PropertyColumn<float> column(list, "p0");
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(column.getSum());
+
+    state.SetItemsProcessed(state.iterations() * numChildren);
+}
+BENCHMARK(BM_PropertyColumn_sum)->Apply(bench::nodeCounts);
+
+//! PropertyColumnの追従のコスト。drag=1では同じ要素を変更し続け、0では毎回ランダムな要素を変更する
+static void BM_PropertyColumn_edit(benchmark::State& state)
+{
+    const int numChildren = (int)state.range(0);
+    const bool isDrag = state.range(1) != 0;
+    auto vt = bench::createList("list", "item", numChildren, 1);
+
+    vtwrapper::WrappedTreeList<bench::PropertyNode> list;
+    list.wrap(vt, "list", "item", nullptr);
+    vtwrapper::PropertyColumn<float> column(list, "p0");
+
+    juce::Random random(1);
+    const int dragged = numChildren / 2;
+    for (auto _ : state)
+        list[isDrag ? dragged : random.nextInt(numChildren)]->properties[0]->set(random.nextFloat());
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PropertyColumn_edit)->ArgsProduct({ { 100, 10000, 100000 }, { 0, 1 } })->ArgNames({ "children", "drag" });
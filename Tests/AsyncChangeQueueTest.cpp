@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <vtwrapper/vtwrapper.h>
+
+namespace
+{
+class CountingClient
+: public vtwrapper::AsyncChangeQueue::Client
+{
+public:
+    void handleQueuedChange() override
+    {
+        ++numCalls;
+        if (onHandle) onHandle();
+    }
+
+    int numCalls = 0;
+    std::function<void()> onHandle;
+};
+}
+
+TEST(async_change_queue, coalesce)
+{
+    vtwrapper::AsyncChangeQueue queue;
+    CountingClient a, b;
+
+    // 同じClientは一度の配信で一度だけ通知されるはず
+    for (int i = 0; i < 10; ++i)
+    {
+        queue.enqueue(&a);
+        queue.enqueue(&b);
+    }
+    EXPECT_EQ (queue.getNumQueued(), 2);
+    EXPECT_TRUE (a.isQueued());
+
+    queue.flush();
+    EXPECT_EQ (a.numCalls, 1);
+    EXPECT_EQ (b.numCalls, 1);
+    EXPECT_EQ (queue.getNumQueued(), 0);
+
+    // 配信中に登録されたClientは次の配信で通知されるはず
+    a.onHandle = [&] { queue.enqueue(&a); };
+    queue.enqueue(&a);
+    queue.flush();
+    EXPECT_EQ (a.numCalls, 2);
+    EXPECT_TRUE (a.isQueued());
+    a.onHandle = nullptr;
+    queue.flush();
+    EXPECT_EQ (a.numCalls, 3);
+
+    // 破棄されたClientはキューから削除されるはず
+    queue.enqueue(&a);
+    {
+        CountingClient temporary;
+        queue.enqueue(&temporary);
+    }
+    queue.enqueue(&b);
+    EXPECT_EQ (queue.getNumQueued(), 2);
+
+    // 通知中に後続のClientが削除された場合は通知されないはず
+    a.onHandle = [&] { queue.remove(&b); };
+    queue.flush();
+    EXPECT_EQ (a.numCalls, 4);
+    EXPECT_EQ (b.numCalls, 1);
+}
+
+TEST(async_change_queue, wrapped_property)
+{
+    vtwrapper::AsyncChangeQueue queue;
+    juce::ValueTree t("root");
+    vtwrapper::WrappedProperty<int> wp(t, "value", nullptr, 0);
+    wp.setAsyncChangeNotification(true, queue);
+
+    int numChanges = 0;
+    wp.onChange = [&] { ++numChanges; };
+
+    // 連続した変更は配信時に一度だけ通知されるはず
+    for (int i = 1; i <= 1000; ++i)
+        wp.set(i);
+    t.setProperty("value", 2000, nullptr);
+    EXPECT_EQ (numChanges, 0);
+    EXPECT_EQ (wp.get(), 2000);
+
+    queue.flush();
+    EXPECT_EQ (numChanges, 1);
+
+    // 配信までに元の値に戻った場合は通知されないはず
+    wp.set(1);
+    wp.set(2000);
+    queue.flush();
+    EXPECT_EQ (numChanges, 1);
+
+    // 無効にした時点で配信待ちの変更は通知され、以降は同期的に通知されるはず
+    wp.set(3);
+    wp.setAsyncChangeNotification(false);
+    EXPECT_EQ (numChanges, 2);
+    EXPECT_EQ (queue.getNumQueued(), 0);
+    wp.set(4);
+    EXPECT_EQ (numChanges, 3);
+}
+
+TEST(async_change_queue, transaction)
+{
+    class Node
+    : public vtwrapper::WrappedTree
+    {
+    public:
+        void wrapPropertiesAndChildren() override { value.referTo(valueTree, "value", undoManager, 0); }
+        vtwrapper::WrappedProperty<int> value;
+    };
+
+    vtwrapper::AsyncChangeQueue queue;
+    juce::ValueTree t("root");
+    Node node;
+    node.wrap(t, "root", nullptr);
+    node.value.setAsyncChangeNotification(true, queue);
+
+    int numChanges = 0;
+    node.value.onChange = [&] { ++numChanges; };
+
+    // トランザクション終了時の通知も非同期になるはず
+    {
+        vtwrapper::WrappedTree::ScopedTransaction transaction(node);
+        node.value.set(1);
+        node.value.set(2);
+    }
+    EXPECT_EQ (numChanges, 0);
+    EXPECT_EQ ((int)t["value"], 2);
+
+    queue.flush();
+    EXPECT_EQ (numChanges, 1);
+}
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <vtwrapper/vtwrapper.h>
+
+namespace
+{
+juce::ValueTree createTree()
+{
+    juce::MemoryBlock binary;
+    binary.append("\x00\x01\x02\xff", 4);
+
+    juce::ValueTree vt("root");
+    vt.setProperty("int", -123, nullptr)
+      .setProperty("int64", (juce::int64)1 << 40, nullptr)
+      .setProperty("double", 0.125, nullptr)
+      .setProperty("bool", true, nullptr)
+      .setProperty("string", juce::String::fromUTF8("テキスト"), nullptr)
+      .setProperty("binary", binary, nullptr);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        juce::ValueTree child("child");
+        child.setProperty("int", i, nullptr);
+        child.appendChild(juce::ValueTree("leaf").setProperty("double", i * 0.5, nullptr), nullptr);
+        vt.appendChild(child, nullptr);
+    }
+    return vt;
+}
+}
+
+TEST(binary_tree_format, round_trip)
+{
+    auto vt = createTree();
+
+    juce::MemoryOutputStream mo;
+    EXPECT_TRUE (vtwrapper::BinaryTreeFormat::writeToStream(vt, mo));
+
+    auto restored = vtwrapper::BinaryTreeFormat::readFromData(mo.getData(), mo.getDataSize());
+    ASSERT_TRUE (restored.isValid());
+    EXPECT_TRUE (restored.isEquivalentTo(vt));
+
+    // 型も保持されるはず
+    EXPECT_TRUE (restored["int"].isInt());
+    EXPECT_TRUE (restored["int64"].isInt64());
+    EXPECT_TRUE (restored["double"].isDouble());
+    EXPECT_TRUE (restored["bool"].isBool());
+    EXPECT_TRUE (restored["binary"].isBinaryData());
+}
+
+TEST(binary_tree_format, stream_position)
+{
+    auto vt = createTree();
+
+    // 後続のデータがあっても、読み込み後はその先頭に位置するはず
+    juce::MemoryOutputStream mo;
+    vtwrapper::BinaryTreeFormat::writeToStream(vt, mo);
+    mo.writeInt(12345);
+
+    juce::MemoryInputStream mi(mo.getData(), mo.getDataSize(), false);
+    auto restored = vtwrapper::BinaryTreeFormat::readFromStream(mi);
+    EXPECT_TRUE (restored.isEquivalentTo(vt));
+    EXPECT_EQ (mi.readInt(), 12345);
+}
+
+TEST(binary_tree_format, smaller_than_value_tree_stream)
+{
+    juce::ValueTree vt("root");
+    for (int i = 0; i < 100; ++i)
+        vt.appendChild(juce::ValueTree("child").setProperty("parameterValue", i, nullptr), nullptr);
+
+    juce::MemoryOutputStream binary, standard;
+    vtwrapper::BinaryTreeFormat::writeToStream(vt, binary);
+    vt.writeToStream(standard);
+
+    // Identifierを一度だけ書き込むため小さくなるはず
+    EXPECT_LT (binary.getDataSize() * 2, standard.getDataSize());
+}
+
+TEST(binary_tree_format, invalid_data)
+{
+    auto vt = createTree();
+    juce::MemoryOutputStream mo;
+    vtwrapper::BinaryTreeFormat::writeToStream(vt, mo);
+
+    // 途中で途切れたデータやヘッダが異なるデータは無効なValueTreeとなるはず
+    EXPECT_FALSE (vtwrapper::BinaryTreeFormat::readFromData(mo.getData(), mo.getDataSize() - 1).isValid());
+    EXPECT_FALSE (vtwrapper::BinaryTreeFormat::readFromData("VTWX", 4).isValid());
+    EXPECT_FALSE (vtwrapper::BinaryTreeFormat::readFromData(nullptr, 0).isValid());
+}
+
+TEST(binary_tree_format, too_deep_data)
+{
+    // ヘッダ, Identifierテーブル("a"のみ), 深さnumLevels - 1まで子をひとつずつ持つノードの並び
+    auto createNestedData = [](int numLevels)
+    {
+        juce::MemoryOutputStream mo;
+        mo.write("VTWB\x01\x01\x01" "a", 8);
+        for (int i = 0; i < numLevels; ++i)
+        {
+            const char node[] = { 0x00, 0x00, (char)(i + 1 < numLevels ? 1 : 0) };
+            mo.write(node, sizeof(node));
+        }
+        return mo.getMemoryBlock();
+    };
+
+    // 最大の深さまでは読み込めるはず
+    auto allowed = createNestedData(vtwrapper::BinaryDecoder::maxTreeDepth + 1);
+    EXPECT_TRUE (vtwrapper::BinaryTreeFormat::readFromData(allowed.getData(), allowed.getSize()).isValid());
+
+    // 超えた場合は途切れたデータと同様に読み込みに失敗するはず
+    auto tooDeep = createNestedData(vtwrapper::BinaryDecoder::maxTreeDepth + 2);
+    EXPECT_FALSE (vtwrapper::BinaryTreeFormat::readFromData(tooDeep.getData(), tooDeep.getSize()).isValid());
+}
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <vtwrapper/vtwrapper.h>
+
+using Instrumentation = vtwrapper::Instrumentation;
+
+namespace
+{
+class TrackTree
+: public vtwrapper::WrappedTree
+{
+public:
+    void wrapPropertiesAndChildren() override
+    {
+        gain.referTo(valueTree, "gain", undoManager, 1.0f);
+        pan.referTo(valueTree, "pan", undoManager, 0.0f);
+    }
+
+    vtwrapper::WrappedProperty<float> gain, pan;
+};
+
+juce::int64 getCount(Instrumentation::Event event, const char* source, const juce::Identifier& typeId, const juce::Identifier& propertyId = {})
+{
+    for (const auto& c : Instrumentation::getCounters())
+        if (c.event == event && juce::String(c.source) == source && c.typeId == typeId && c.propertyId == propertyId)
+            return c.count;
+    return 0;
+}
+}
+
+TEST(instrumentation, scoped_measurement)
+{
+    Instrumentation::reset();
+    Instrumentation::setTraceEnabled(true);
+
+    for (int i = 0; i < 3; ++i)
+        Instrumentation::ScopedMeasurement m(Instrumentation::Event::propertyChanged, "test", "track", "gain");
+    Instrumentation::ScopedMeasurement(Instrumentation::Event::wrap, "test", "track");
+
+    // 回数の多い順
+    const auto counters = Instrumentation::getCounters();
+    ASSERT_EQ (counters.size(), 2);
+    EXPECT_EQ (counters[0].event, Instrumentation::Event::propertyChanged);
+    EXPECT_EQ (counters[0].propertyId, juce::Identifier("gain"));
+    EXPECT_EQ (counters[0].count, 3);
+    EXPECT_GE (counters[0].totalSeconds, counters[0].maxSeconds);
+    EXPECT_EQ (counters[1].event, Instrumentation::Event::wrap);
+    EXPECT_EQ (counters[1].count, 1);
+
+    const auto json = Instrumentation::createTraceJson();
+    EXPECT_TRUE (json.startsWith("{\"traceEvents\":["));
+    EXPECT_TRUE (json.contains("\"name\":\"test propertyChanged\""));
+    EXPECT_TRUE (json.contains("\"property\":\"gain\""));
+
+    // 実行時に止めた場合は計測しない
+    Instrumentation::setEnabled(false);
+    Instrumentation::ScopedMeasurement(Instrumentation::Event::wrap, "test", "track");
+    Instrumentation::setEnabled(true);
+    EXPECT_EQ (getCount(Instrumentation::Event::wrap, "test", "track"), 1);
+
+    Instrumentation::setTraceEnabled(false);
+    Instrumentation::reset();
+    EXPECT_TRUE (Instrumentation::getCounters().isEmpty());
+    EXPECT_FALSE (Instrumentation::createTraceJson().contains("test"));
+}
+
+#if VTWRAPPER_ENABLE_INSTRUMENTATION
+TEST(instrumentation, wrapper_callbacks)
+{
+    juce::ValueTree vt("tracks");
+    vtwrapper::WrappedTreeList<TrackTree> list;
+    list.wrap(vt, "tracks", "track", nullptr);
+
+    Instrumentation::reset();
+    for (int i = 0; i < 4; ++i)
+        list.add(new TrackTree());
+
+    EXPECT_EQ (getCount(Instrumentation::Event::wrap, "WrappedTree", "track"), 4);
+    EXPECT_EQ (getCount(Instrumentation::Event::allocation, "WrappedTreeList", "track"), 0); // add()は呼び出し側で確保する
+
+    Instrumentation::reset();
+    for (int i = 0; i < 10; ++i)
+        list[0]->gain.set((float)i / 10.0f);
+    list[1]->pan.set(0.5f);
+
+    // 対象の要素のWrappedProperty(PropertyDispatcher経由)と、親を監視するWrappedTreeListに通知される
+    EXPECT_EQ (getCount(Instrumentation::Event::propertyChanged, "WrappedProperty", "track", "gain"), 10);
+    EXPECT_EQ (getCount(Instrumentation::Event::propertyChanged, "WrappedTreeList", "track", "gain"), 10);
+    EXPECT_EQ (getCount(Instrumentation::Event::propertyChanged, "PropertyDispatcher", "track", "pan"), 1);
+    EXPECT_TRUE (Instrumentation::createReport(1).contains("gain"));
+
+    Instrumentation::reset();
+    list.wrap(vt, "tracks", "track", nullptr, false, false);
+    vt.removeChild(0, nullptr);
+    EXPECT_EQ (getCount(Instrumentation::Event::allocation, "WrappedTreeList", "track"), 4);
+    EXPECT_EQ (getCount(Instrumentation::Event::childRemoved, "WrappedTreeList", "tracks"), 1);
+}
+#else
+TEST(instrumentation, disabled_at_compile_time)
+{
+    juce::ValueTree vt("tracks");
+    vtwrapper::WrappedTreeList<TrackTree> list;
+    list.wrap(vt, "tracks", "track", nullptr);
+
+    Instrumentation::reset();
+    list.add(new TrackTree());
+    list[0]->gain.set(0.5f);
+
+    EXPECT_FALSE (Instrumentation::isEnabled());
+    EXPECT_TRUE (Instrumentation::getCounters().isEmpty());
+    EXPECT_TRUE (Instrumentation::createReport().contains("disabled"));
+}
+#endif
@@ -0,0 +1,336 @@
+#include <gtest/gtest.h>
+#include <vtwrapper/vtwrapper.h>
+
+namespace
+{
+class TrackTree
+: public vtwrapper::WrappedTree
+{
+public:
+    void wrapPropertiesAndChildren() override
+    {
+        gain.referTo(valueTree, "gain", undoManager, 1.0f);
+    }
+
+    vtwrapper::WrappedProperty<float> gain;
+};
+
+juce::ValueTree createSession(int numTracks)
+{
+    juce::ValueTree vt("session");
+    vt.setProperty("name", "test", nullptr);
+
+    for (int i = 0; i < numTracks; ++i)
+    {
+        juce::ValueTree track("track");
+        track.setProperty("id", i, nullptr).setProperty("gain", i * 0.5, nullptr);
+        track.appendChild(juce::ValueTree("clip").setProperty("length", i, nullptr), nullptr);
+        vt.appendChild(track, nullptr);
+    }
+    return vt;
+}
+
+//! テスト終了時に削除される一時ファイル
+struct ScopedSessionFile
+{
+    explicit ScopedSessionFile(const juce::ValueTree& vt)
+    {
+        auto output = file.createOutputStream();
+        vtwrapper::MappedSession::writeToStream(vt, *output);
+    }
+    ~ScopedSessionFile() { file.deleteFile(); }
+
+    juce::MemoryBlock load() const
+    {
+        juce::MemoryMappedFile mapped(file, juce::MemoryMappedFile::readOnly);
+        return juce::MemoryBlock(mapped.getData(), mapped.getSize());
+    }
+
+    juce::File file = juce::File::createTempFile(".vtws");
+};
+}
+
+TEST(mapped_session, round_trip)
+{
+    auto vt = createSession(10);
+    ScopedSessionFile sessionFile(vt);
+
+    vtwrapper::MappedSession session(sessionFile.file);
+    ASSERT_TRUE (session.isOpen());
+
+    auto root = session.getRoot();
+    vtwrapper::MappedSession::ensureLoadedRecursively(root);
+    EXPECT_TRUE (root.isEquivalentTo(vt));
+}
+
+TEST(mapped_session, load_only_accessed_nodes)
+{
+    ScopedSessionFile sessionFile(createSession(100));
+    vtwrapper::MappedSession session(sessionFile.file);
+
+    // ルートのみが読み込まれ、子はTypeのみを持つはず
+    auto root = session.getRoot();
+    EXPECT_EQ (session.getNumLoadedNodes(), 1);
+    EXPECT_EQ (root.getNumChildren(), 100);
+    EXPECT_EQ (root["name"].toString(), "test");
+    EXPECT_TRUE (root.getChild(0).hasType("track"));
+    EXPECT_TRUE (vtwrapper::MappedSession::isPlaceholder(root.getChild(0)));
+
+    vtwrapper::WrappedTreeList<TrackTree> tracks;
+    tracks.setLazyWrapping(true);
+    tracks.wrap(root, "session", "track", nullptr);
+    EXPECT_EQ (session.getNumLoadedNodes(), 1);
+
+    // アクセスした要素のみ読み込まれるはず
+    EXPECT_FLOAT_EQ (tracks[42]->gain.get(), 21.0f);
+    EXPECT_EQ (session.getNumLoadedNodes(), 2);
+    EXPECT_FALSE (vtwrapper::MappedSession::isPlaceholder(root.getChild(42)));
+    EXPECT_TRUE (vtwrapper::MappedSession::isPlaceholder(root.getChild(42).getChild(0)));
+    EXPECT_FALSE (session.hasChanges());
+}
+
+TEST(mapped_session, unique_ptr_loads_target)
+{
+    ScopedSessionFile sessionFile(createSession(3));
+    vtwrapper::MappedSession session(sessionFile.file);
+
+    auto track = session.getRoot().getChild(1);
+    vtwrapper::UniquePtr<TrackTree> ptr;
+    ptr.referTo(track, "track", nullptr);
+
+    ASSERT_TRUE (ptr);
+    EXPECT_FLOAT_EQ (ptr->gain.get(), 0.5f);
+}
+
+TEST(mapped_session, write_back_changes)
+{
+    auto vt = createSession(20);
+    ScopedSessionFile sessionFile(vt);
+    ScopedSessionFile savedFile(juce::ValueTree("empty"));
+
+    {
+        vtwrapper::MappedSession session(sessionFile.file);
+
+        // 変更が無ければ元のファイルと同じ内容になるはず
+        EXPECT_TRUE (session.save(savedFile.file));
+        EXPECT_EQ (savedFile.load(), sessionFile.load());
+
+        vtwrapper::WrappedTreeList<TrackTree> tracks;
+        tracks.setLazyWrapping(true);
+        tracks.wrap(session.getRoot(), "session", "track", nullptr);
+
+        tracks[3]->gain.set(0.25f);
+        tracks.removeRange(5, 1);
+        tracks.add(new TrackTree());
+        EXPECT_TRUE (session.hasChanges());
+
+        // 読み込んでいない要素は元のファイルから複製される
+        EXPECT_LT (session.getNumLoadedNodes(), 5);
+        EXPECT_TRUE (session.save(savedFile.file));
+    }
+
+    vt.getChild(3).setProperty("gain", 0.25f, nullptr);
+    vt.removeChild(5, nullptr);
+    vt.appendChild(juce::ValueTree("track"), nullptr);
+
+    vtwrapper::MappedSession saved(savedFile.file);
+    ASSERT_TRUE (saved.isOpen());
+
+    auto root = saved.getRoot();
+    vtwrapper::MappedSession::ensureLoadedRecursively(root);
+    EXPECT_TRUE (root.isEquivalentTo(vt));
+}
+
+TEST(mapped_session, write_back_repeated_changes)
+{
+    auto vt = createSession(5);
+    ScopedSessionFile sessionFile(vt);
+    ScopedSessionFile savedFile(juce::ValueTree("empty"));
+
+    {
+        vtwrapper::MappedSession session(sessionFile.file);
+        auto root = session.getRoot();
+        auto track = root.getChild(3);
+        vtwrapper::MappedSession::ensureLoaded(track);
+
+        // 同じノードへの連続した変更と、移動後の変更がいずれも書き込まれるはず
+        track.setProperty("gain", 0.1, nullptr);
+        track.setProperty("gain", 0.2, nullptr);
+        root.moveChild(3, 0, nullptr);
+        track.setProperty("gain", 0.3, nullptr);
+
+        auto other = root.getChild(4);
+        vtwrapper::MappedSession::ensureLoaded(other);
+        other.setProperty("gain", 0.4, nullptr);
+        track.setProperty("gain", 0.5, nullptr);
+
+        EXPECT_TRUE (session.save(savedFile.file));
+    }
+
+    vt.moveChild(3, 0, nullptr);
+    vt.getChild(0).setProperty("gain", 0.5, nullptr);
+    vt.getChild(4).setProperty("gain", 0.4, nullptr);
+
+    vtwrapper::MappedSession saved(savedFile.file);
+    auto root = saved.getRoot();
+    vtwrapper::MappedSession::ensureLoadedRecursively(root);
+    EXPECT_TRUE (root.isEquivalentTo(vt));
+}
+
+TEST(mapped_session, save_to_opened_file)
+{
+    auto vt = createSession(5);
+    ScopedSessionFile sessionFile(vt);
+
+    vtwrapper::MappedSession session(sessionFile.file);
+    auto root = session.getRoot();
+    vtwrapper::MappedSession::ensureLoaded(root.getChild(2));
+    root.getChild(2).setProperty("gain", 0.75, nullptr);
+
+    // 開いているファイル自体を置き換えられるはず
+    EXPECT_TRUE (session.save(sessionFile.file));
+    vt.getChild(2).setProperty("gain", 0.75, nullptr);
+
+    // 読み込まれていなかったプレースホルダも、保存前のデータから読み込めるはず
+    vtwrapper::MappedSession::ensureLoadedRecursively(root);
+    EXPECT_TRUE (root.isEquivalentTo(vt));
+
+    vtwrapper::MappedSession saved(sessionFile.file);
+    auto savedRoot = saved.getRoot();
+    vtwrapper::MappedSession::ensureLoadedRecursively(savedRoot);
+    EXPECT_TRUE (savedRoot.isEquivalentTo(vt));
+}
+
+TEST(mapped_session, placeholder_outlives_session)
+{
+    ScopedSessionFile sessionFile(createSession(3));
+
+    juce::ValueTree track;
+    {
+        vtwrapper::MappedSession session(sessionFile.file);
+        track = session.getRoot().getChild(2);
+    }
+
+    // 元のファイルのデータを保持しているため、セッションの破棄後も読み込めるはず
+    vtwrapper::MappedSession::ensureLoaded(track);
+    EXPECT_EQ ((int)track["id"], 2);
+    EXPECT_EQ (track.getNumChildren(), 1);
+}
+
+TEST(mapped_session, write_unloaded_nodes_as_binary)
+{
+    auto vt = createSession(10);
+    ScopedSessionFile sessionFile(vt);
+    vtwrapper::MappedSession session(sessionFile.file);
+
+    // 一部の要素のみ読み込んだ状態で書き込む
+    auto root = session.getRoot();
+    vtwrapper::MappedSession::ensureLoaded(root.getChild(4));
+    ASSERT_TRUE (vtwrapper::MappedSession::isPlaceholder(root.getChild(0)));
+
+    juce::MemoryOutputStream output;
+    ASSERT_TRUE (vtwrapper::BinaryTreeFormat::writeToStream(root, output));
+
+    // プレースホルダではなく元のノードの内容が書き込まれるはず
+    auto restored = vtwrapper::BinaryTreeFormat::readFromData(output.getData(), output.getDataSize());
+    EXPECT_TRUE (restored.isEquivalentTo(vt));
+}
+
+TEST(mapped_session, snapshot_of_unloaded_nodes)
+{
+    auto vt = createSession(5);
+    ScopedSessionFile sessionFile(vt);
+    vtwrapper::MappedSession session(sessionFile.file);
+
+    auto root = session.getRoot();
+    vtwrapper::SnapshotBuilder builder(root);
+    auto snapshot = builder.publish();
+
+    ASSERT_EQ (snapshot->getNumChildren(), 5);
+    EXPECT_EQ ((int)(*snapshot->getChild(3))["id"], 3);
+    EXPECT_FALSE (snapshot->getChild(3)->hasProperty("vtwrapper_mappedSessionPlaceholder"));
+    EXPECT_EQ (snapshot->getChild(3)->getNumChildren(), 1);
+
+    // 後から追加されたプレースホルダも読み込まれた内容で反映されるはず
+    ScopedSessionFile otherFile(createSession(2));
+    vtwrapper::MappedSession other(otherFile.file);
+    auto track = other.getRoot().getChild(1);
+    auto otherRoot = other.getRoot();
+    otherRoot.removeChild(track, nullptr);
+    root.appendChild(track, nullptr);
+
+    snapshot = builder.publish();
+    ASSERT_EQ (snapshot->getNumChildren(), 6);
+    EXPECT_EQ ((int)(*snapshot->getChild(5))["id"], 1);
+    EXPECT_EQ ((int)(*snapshot->getChild(5)->getChild(0))["length"], 1);
+    EXPECT_FALSE (builder.hasPendingChanges());
+}
+
+TEST(mapped_session, tree_index_of_unloaded_nodes)
+{
+    ScopedSessionFile sessionFile(createSession(3));
+    vtwrapper::MappedSession session(sessionFile.file);
+
+    auto root = session.getRoot();
+    vtwrapper::TreeIndex index(root, "id");
+
+    // 読み込まれていないノードはキー無しとして登録されるはず
+    EXPECT_FALSE (index.find({ { "track", 1 } }).isValid());
+    EXPECT_EQ (index.find({ { "track" } }), root.getChild(0));
+
+    // 読み込まれた時点でキーと子が反映されるはず
+    vtwrapper::MappedSession::ensureLoaded(root.getChild(1));
+    EXPECT_EQ (index.find({ { "track", 1 } }), root.getChild(1));
+    EXPECT_TRUE (index.find({ { "track", 1 }, { "clip" } }).isValid());
+}
+
+TEST(mapped_session, too_deep_file)
+{
+    const int maxDepth = vtwrapper::BinaryDecoder::maxTreeDepth;
+
+    juce::ValueTree vt("node");
+    auto deepest = vt;
+    for (int i = 0; i < maxDepth + 4; ++i)
+    {
+        juce::ValueTree child("node");
+        deepest.appendChild(child, nullptr);
+        deepest = child;
+    }
+    ScopedSessionFile sessionFile(vt);
+
+    vtwrapper::MappedSession session(sessionFile.file);
+    ASSERT_TRUE (session.isOpen());
+
+    // 最大の深さのノードの子は、破損したデータと同様に読み込まれないはず
+    auto root = session.getRoot();
+    vtwrapper::MappedSession::ensureLoadedRecursively(root);
+
+    int depth = 0;
+    for (auto node = root; node.getNumChildren() > 0; node = node.getChild(0))
+        ++depth;
+    EXPECT_EQ (depth, maxDepth);
+}
+
+TEST(mapped_session, invalid_file)
+{
+    auto writeFile = [](const void* data, size_t numBytes)
+    {
+        auto file = juce::File::createTempFile(".vtws");
+        file.createOutputStream()->write(data, numBytes);
+        return file;
+    };
+
+    vtwrapper::MappedSession session;
+
+    auto text = writeFile("not a session", 13);
+    EXPECT_FALSE (session.open(text));
+    EXPECT_FALSE (session.isOpen());
+    text.deleteFile();
+
+    // BinaryTreeFormatの形式も読み込まない
+    juce::MemoryOutputStream mo;
+    vtwrapper::BinaryTreeFormat::writeToStream(createSession(1), mo);
+    auto binary = writeFile(mo.getData(), mo.getDataSize());
+    EXPECT_FALSE (session.open(binary));
+    binary.deleteFile();
+}
@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+#include <vtwrapper/vtwrapper.h>
+
+namespace
+{
+struct Counted
+{
+    Counted() { ++numAlive; }
+    ~Counted() { --numAlive; }
+    static inline int numAlive = 0;
+    double payload[4] {};
+};
+
+class PooledWrappedTree
+: public vtwrapper::WrappedTree
+{
+public:
+    void wrapPropertiesAndChildren() override {}
+};
+}
+
+TEST(object_pool, reuse_slots)
+{
+    {
+        vtwrapper::SlabPool<Counted, 4> pool;
+
+        auto* a = pool.create();
+        auto* b = pool.create();
+        EXPECT_EQ (Counted::numAlive, 2);
+        EXPECT_EQ (pool.getNumAllocated(), 2);
+        EXPECT_EQ (pool.getNumSlabs(), 1);
+        EXPECT_TRUE (pool.owns(a));
+
+        // 続けて作成したオブジェクトは隣接しているはず
+        EXPECT_EQ (reinterpret_cast<char*>(b) - reinterpret_cast<char*>(a), (std::ptrdiff_t)sizeof(Counted));
+
+        // 破棄したスロットは再利用されるはず
+        pool.destroy(a);
+        EXPECT_EQ (Counted::numAlive, 1);
+        auto* c = pool.create();
+        EXPECT_EQ (c, a);
+
+        // スラブが足りなくなった場合のみ追加されるはず
+        auto* d = pool.create();
+        auto* e = pool.create();
+        EXPECT_EQ (pool.getNumSlabs(), 1);
+        auto* f = pool.create();
+        EXPECT_EQ (pool.getNumSlabs(), 2);
+        EXPECT_TRUE (pool.owns(f));
+
+        for (auto* t : { b, c, d, e, f })
+            pool.destroy(t);
+        EXPECT_EQ (pool.getNumAllocated(), 0);
+    }
+    EXPECT_EQ (Counted::numAlive, 0);
+}
+
+TEST(object_pool, destroy_heap_object)
+{
+    vtwrapper::SlabPool<Counted> pool;
+
+    // プール外で確保されたオブジェクトはdeleteで破棄されるはず
+    auto* heapObject = new Counted();
+    EXPECT_FALSE (pool.owns(heapObject));
+    pool.destroy(heapObject);
+    EXPECT_EQ (Counted::numAlive, 0);
+    EXPECT_EQ (pool.getNumAllocated(), 0);
+}
+
+TEST(object_pool, wrapped_tree_list_uses_pool)
+{
+    auto& pool = vtwrapper::SlabPool<PooledWrappedTree>::getSharedInstance();
+    const int numAllocatedBefore = pool.getNumAllocated();
+
+    juce::ValueTree vt("root");
+    {
+        vtwrapper::WrappedTreeList<PooledWrappedTree> wtl;
+        wtl.wrap(vt, "root", "child", nullptr);
+
+        for (int i = 0; i < 3; ++i)
+            vt.appendChild(juce::ValueTree("child"), nullptr);
+        EXPECT_EQ (pool.getNumAllocated(), numAllocatedBefore + 3);
+
+        // newで確保したオブジェクトも追加できるはず
+        wtl.add(new PooledWrappedTree());
+        EXPECT_EQ (wtl.size(), 4);
+
+        vt.removeChild(0, nullptr);
+        EXPECT_EQ (pool.getNumAllocated(), numAllocatedBefore + 2);
+    }
+    EXPECT_EQ (pool.getNumAllocated(), numAllocatedBefore);
+}
+
+TEST(object_pool, chunked_allocator)
+{
+    {
+        vtwrapper::ChunkedAllocator<Counted, 64> allocator;
+
+        std::vector<Counted*> objects;
+        for (int i = 0; i < 100; ++i)
+            objects.push_back(allocator.create());
+        EXPECT_EQ (allocator.getNumAllocated(), 100);
+        EXPECT_EQ (allocator.getNumChunks(), 2);
+
+        // 作成順に隣接しているはず
+        EXPECT_EQ (reinterpret_cast<char*>(objects[1]) - reinterpret_cast<char*>(objects[0]), (std::ptrdiff_t)sizeof(Counted));
+
+        // 破棄した後は先頭に近い空きスロットから再利用されるはず
+        auto* first = objects[3];
+        auto* second = objects[70];
+        allocator.destroy(second);
+        allocator.destroy(first);
+        EXPECT_EQ (allocator.create(), first);
+        EXPECT_EQ (allocator.create(), second);
+        EXPECT_EQ (allocator.getNumChunks(), 2);
+
+        // メモリ上の順に走査されるはず
+        int index = 0;
+        bool inOrder = true;
+        allocator.forEach([&](Counted& c) { inOrder &= (&c == objects[(size_t)index++]); });
+        EXPECT_EQ (index, 100);
+        EXPECT_TRUE (inOrder);
+
+        // チャンク外のオブジェクトはdeleteで破棄されるはず
+        auto* heapObject = new Counted();
+        EXPECT_FALSE (allocator.owns(heapObject));
+        allocator.destroy(heapObject);
+        EXPECT_EQ (Counted::numAlive, 100);
+
+        for (auto* c : objects)
+            allocator.destroy(c);
+        EXPECT_EQ (allocator.getNumAllocated(), 0);
+    }
+    EXPECT_EQ (Counted::numAlive, 0);
+}
+
+TEST(object_pool, wrapped_tree_list_storage_order)
+{
+    juce::ValueTree vt("root");
+    for (int i = 0; i < 5; ++i)
+        vt.appendChild(juce::ValueTree("child"), nullptr);
+
+    vtwrapper::WrappedTreeList<PooledWrappedTree, vtwrapper::ChunkedAllocator<PooledWrappedTree>> wtl;
+    wtl.wrap(vt, "root", "child", nullptr);
+
+    // 子要素のアドレスはリストの変更で変わらないはず
+    auto* last = wtl[4];
+    vt.moveChild(4, 0, nullptr);
+    vt.removeChild(2, nullptr);
+    EXPECT_EQ (wtl[0], last);
+
+    wtl.add(new PooledWrappedTree());
+    wtl.add(wtl.getAllocator().create());
+    EXPECT_EQ (wtl.size(), 6);
+    EXPECT_EQ (wtl.getAllocator().getNumAllocated(), 5);
+
+    // Allocator外で確保した要素も含めて、全ての要素が一度ずつ呼ばれるはず
+    juce::Array<PooledWrappedTree*> visited;
+    wtl.forEachInStorageOrder([&](PooledWrappedTree& t) { visited.add(&t); });
+    EXPECT_EQ (visited.size(), 6);
+    for (auto* t : wtl)
+        EXPECT_TRUE (visited.contains(t));
+
+    // 新しい要素は空いたスロットに配置されるはず
+    EXPECT_EQ (visited.getLast(), wtl[4]);
+    EXPECT_LT (visited.indexOf(wtl[5]), visited.indexOf(wtl[0]));
+}
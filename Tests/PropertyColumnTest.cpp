@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+#include <vtwrapper/vtwrapper.h>
+
+namespace
+{
+class TrackTree
+: public vtwrapper::WrappedTree
+{
+public:
+    TrackTree() = default;
+    explicit TrackTree(float initialGain) : initialGain(initialGain) {}
+
+    void wrapPropertiesAndChildren() override
+    {
+        gain.referTo(valueTree, "gain", undoManager, initialGain);
+        gain.setSyncPropertyWhenDefault(true);
+    }
+
+    vtwrapper::WrappedProperty<float> gain;
+    float initialGain = 1.0f;
+};
+
+using TrackList = vtwrapper::WrappedTreeList<TrackTree>;
+
+std::vector<float> getGains(TrackList& list)
+{
+    std::vector<float> gains;
+    for (auto* t : list)
+        gains.push_back(t->gain.get());
+    return gains;
+}
+}
+
+TEST(property_column, follows_membership)
+{
+    juce::UndoManager um;
+    juce::ValueTree vt("tracks");
+    TrackList list;
+    list.wrap(vt, "tracks", "track", &um);
+
+    vtwrapper::PropertyColumn<float> gains(list, "gain", 1.0f);
+    EXPECT_TRUE (gains.isEmpty());
+
+    for (float g : { 0.5f, 2.0f, 0.25f, 1.5f })
+        list.add(new TrackTree(g));
+    EXPECT_EQ (gains.getValues(), getGains(list));
+
+    list.insertAt(1, { new TrackTree(3.0f) });
+    EXPECT_EQ (gains.getValues(), getGains(list));
+
+    list.remove(list[2]);
+    EXPECT_EQ (gains.getValues(), getGains(list));
+
+    vt.moveChild(0, 3, &um);
+    EXPECT_EQ (gains.getValues(), getGains(list));
+    vt.moveChild(3, 1, &um);
+    EXPECT_EQ (gains.getValues(), getGains(list));
+
+    // undoでの復元にも追従する
+    um.beginNewTransaction();
+    list.remove(list[0]);
+    list.remove(list[0]);
+    EXPECT_EQ (gains.getValues(), getGains(list));
+    um.undo();
+    EXPECT_EQ (gains.getValues(), getGains(list));
+    EXPECT_EQ (gains.size(), 4);
+}
+
+TEST(property_column, follows_property_changes)
+{
+    juce::ValueTree vt("tracks");
+    for (int i = 0; i < 3; ++i)
+        vt.appendChild(juce::ValueTree("track"), nullptr);
+    vt.getChild(1).setProperty("gain", 0.5f, nullptr);
+
+    // プロパティを持たない要素はdefaultValueとなる
+    vtwrapper::PropertyColumn<float> gains(vt, "gain", 1.0f);
+    EXPECT_EQ (gains.getValues(), std::vector<float>({ 1.0f, 0.5f, 1.0f }));
+
+    TrackList list;
+    list.wrap(vt, "tracks", "track", nullptr);
+    list[2]->gain.set(0.75f);
+    EXPECT_FLOAT_EQ (gains[2], 0.75f);
+
+    // WrappedTreeListを介さない変更
+    vt.getChild(0).setProperty("gain", 2.0f, nullptr);
+    EXPECT_FLOAT_EQ (gains[0], 2.0f);
+    vt.getChild(0).removeProperty("gain", nullptr);
+    EXPECT_FLOAT_EQ (gains[0], 1.0f);
+
+    // 孫や別のプロパティの変更は無視する
+    vt.getChild(1).appendChild(juce::ValueTree("clip").setProperty("gain", 9.0f, nullptr), nullptr);
+    vt.getChild(1).setProperty("pan", 9.0f, nullptr);
+    EXPECT_EQ (gains.getValues(), std::vector<float>({ 1.0f, 0.5f, 0.75f }));
+
+    // 対象の変更
+    juce::ValueTree other("tracks");
+    other.appendChild(juce::ValueTree("track").setProperty("gain", 4.0f, nullptr), nullptr);
+    gains.attachTo(other, "gain", 1.0f);
+    EXPECT_EQ (gains.getValues(), std::vector<float>({ 4.0f }));
+    vt.getChild(0).setProperty("gain", 8.0f, nullptr);
+    EXPECT_EQ (gains.getValues(), std::vector<float>({ 4.0f }));
+
+    gains.detach();
+    EXPECT_TRUE (gains.isEmpty());
+}
+
+TEST(property_column, reductions)
+{
+    juce::ValueTree vt("tracks");
+    TrackList list;
+    list.wrap(vt, "tracks", "track", nullptr);
+
+    vtwrapper::PropertyColumn<float> gains(list, "gain", 1.0f);
+    EXPECT_FLOAT_EQ (gains.getSum(), 0.0f);
+    EXPECT_FLOAT_EQ (gains.getMax(), 1.0f);
+
+    // 4つずつの処理の端数も含める
+    float expectedSum = 0.0f;
+    for (int i = 0; i < 11; ++i)
+    {
+        const float g = (float)((i * 7) % 11) * 0.5f - 2.0f;
+        list.add(new TrackTree(g));
+        expectedSum += g;
+    }
+
+    EXPECT_FLOAT_EQ (gains.getMin(), -2.0f);
+    EXPECT_FLOAT_EQ (gains.getMax(), 3.0f);
+    EXPECT_FLOAT_EQ (gains.getSum(), expectedSum);
+
+    list[10]->gain.set(-8.0f);
+    EXPECT_FLOAT_EQ (gains.getMin(), -8.0f);
+
+    juce::ValueTree counts("items");
+    for (int c : { 4, 1, 3 })
+        counts.appendChild(juce::ValueTree("item").setProperty("count", c, nullptr), nullptr);
+
+    vtwrapper::PropertyColumn<int> column(counts, "count");
+    EXPECT_EQ (column.getSum(), 8);
+    EXPECT_EQ (column.findMinAndMax().getStart(), 1);
+    EXPECT_EQ (column.findMinAndMax().getEnd(), 4);
+}
+
+TEST(property_column, realtime_read)
+{
+    juce::ValueTree vt("tracks");
+    TrackList list;
+    list.wrap(vt, "tracks", "track", nullptr);
+    list.add(new TrackTree(0.5f));
+
+    vtwrapper::PropertyColumn<float> gains(list, "gain");
+    gains.setRealtimeReadEnabled(true);
+    EXPECT_EQ (gains.getRealtime(), std::vector<float>({ 0.5f }));
+
+    list.add(new TrackTree(0.25f));
+    list[0]->gain.set(2.0f);
+    EXPECT_EQ (gains.getRealtime(), std::vector<float>({ 2.0f, 0.25f }));
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include <vtwrapper/vtwrapper.h>
+
+namespace
+{
+class MultiPropertyTree
+: public vtwrapper::WrappedTree
+{
+public:
+    MultiPropertyTree() = default;
+    ~MultiPropertyTree() override = default;
+
+    void wrapPropertiesAndChildren() override
+    {
+        a.referTo(valueTree, "a", undoManager, 0);
+        b.referTo(valueTree, "b", undoManager, 0);
+        c.referTo(valueTree, "c", undoManager, 0);
+    }
+
+    vtwrapper::WrappedProperty<int> a, b, c;
+};
+
+struct CountingClient
+: public vtwrapper::PropertyDispatcher::Client
+{
+    void dispatchedPropertyChanged() override { ++numChanged; }
+    void dispatcherDetached() override { ++numDetached; }
+
+    int numChanged = 0;
+    int numDetached = 0;
+};
+}
+
+TEST(property_dispatcher, dispatch_only_to_changed_property)
+{
+    CountingClient clientA, clientB;
+
+    juce::ValueTree vt("root");
+    vtwrapper::PropertyDispatcher dispatcher;
+    dispatcher.attachTo(vt);
+
+    dispatcher.addClient("a", &clientA);
+    dispatcher.addClient("b", &clientB);
+    EXPECT_EQ (dispatcher.getNumClients(), 2);
+
+    vt.setProperty("a", 1, nullptr);
+    EXPECT_EQ (clientA.numChanged, 1);
+    EXPECT_EQ (clientB.numChanged, 0);
+
+    // 子のプロパティ変更は通知されないはず
+    juce::ValueTree child("a");
+    vt.appendChild(child, nullptr);
+    child.setProperty("a", 1, nullptr);
+    EXPECT_EQ (clientA.numChanged, 1);
+
+    dispatcher.removeClient("a", &clientA);
+    vt.setProperty("a", 2, nullptr);
+    EXPECT_EQ (clientA.numChanged, 1);
+    EXPECT_EQ (dispatcher.getNumClients(), 1);
+}
+
+TEST(property_dispatcher, detach_on_redirect)
+{
+    CountingClient client;
+
+    juce::ValueTree vt("root");
+    vtwrapper::PropertyDispatcher dispatcher;
+    dispatcher.attachTo(vt);
+
+    dispatcher.addClient("a", &client);
+
+    // 別のValueTreeに紐付けると登録済みのClientは切り離される
+    dispatcher.attachTo(juce::ValueTree("other"));
+    EXPECT_EQ (client.numDetached, 1);
+    EXPECT_EQ (dispatcher.getNumClients(), 0);
+
+    vt.setProperty("a", 1, nullptr);
+    EXPECT_EQ (client.numChanged, 0);
+}
+
+TEST(property_dispatcher, shared_by_wrapped_tree)
+{
+    juce::ValueTree vt("root");
+    MultiPropertyTree wt;
+    wt.wrap(vt, "root", nullptr);
+
+    int numChangedA = 0, numChangedB = 0;
+    wt.a.onChange = [&numChangedA]() { ++numChangedA; };
+    wt.b.onChange = [&numChangedB]() { ++numChangedB; };
+
+    vt.setProperty("a", 10, nullptr);
+    EXPECT_EQ (wt.a.get(), 10);
+    EXPECT_EQ (numChangedA, 1);
+    EXPECT_EQ (numChangedB, 0);
+
+    wt.b = 5;
+    EXPECT_EQ ((int)vt["b"], 5);
+    EXPECT_EQ (numChangedB, 1);
+
+    // 再wrap後も通知されるはず
+    juce::ValueTree other("root");
+    wt.wrap(other, "root", nullptr);
+    other.setProperty("c", 3, nullptr);
+    EXPECT_EQ (wt.c.get(), 3);
+    vt.setProperty("c", 4, nullptr);
+    EXPECT_EQ (wt.c.get(), 3);
+}
+
+TEST(property_dispatcher, property_outside_wrap)
+{
+    juce::ValueTree vt("root");
+    MultiPropertyTree wt;
+    wt.wrap(vt, "root", nullptr);
+
+    // wrap()外でreferTo()したWrappedPropertyは自身でリッスンする
+    vtwrapper::WrappedProperty<int> standalone(vt, "a", nullptr);
+    vt.setProperty("a", 7, nullptr);
+    EXPECT_EQ (standalone.get(), 7);
+    EXPECT_EQ (wt.a.get(), 7);
+}
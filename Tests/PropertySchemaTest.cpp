@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include <vtwrapper/vtwrapper.h>
+
+namespace
+{
+class TrackTree
+: public vtwrapper::WrappedTree
+{
+public:
+    using Schema = vtwrapper::PropertySchema<vtwrapper::PropertyDef<float, vtwrapper::RangeConstrainer<float>>,
+                                             vtwrapper::PropertyDef<int>,
+                                             vtwrapper::PropertyDef<juce::String, vtwrapper::MaxLengthConstrainer>>;
+    enum { gain, channels, name };
+
+    static const Schema& getSchema()
+    {
+        static const Schema schema { { "gain", 4.0f, { 0.0f, 2.0f } },
+                                     { "channels", 2 },
+                                     { "name", "untitled", vtwrapper::MaxLengthConstrainer(4) } };
+        return schema;
+    }
+
+    void wrapPropertiesAndChildren() override { getSchema().bind(properties, valueTree, undoManager); }
+
+    Schema::Properties properties;
+};
+}
+
+TEST(property_schema, bind)
+{
+    const auto& schema = TrackTree::getSchema();
+    EXPECT_EQ (schema.getID<TrackTree::gain>(), juce::Identifier("gain"));
+    EXPECT_EQ (schema.indexOf("name"), TrackTree::name);
+    EXPECT_EQ (schema.indexOf("pan"), -1);
+
+    // デフォルト値も制限される
+    EXPECT_FLOAT_EQ (schema.getDefinition<TrackTree::gain>().defaultValue, 2.0f);
+    EXPECT_EQ (schema.getDefinition<TrackTree::name>().defaultValue, juce::String("unti"));
+
+    juce::ValueTree vt("track");
+    vt.setProperty("gain", 5.0f, nullptr);
+    vt.setProperty("channels", 1, nullptr);
+
+    TrackTree track;
+    track.wrap(vt, "track", nullptr);
+
+    // 紐付け時に既存の値にも制限が適用される
+    auto& gain = track.properties.get<TrackTree::gain>();
+    EXPECT_FLOAT_EQ (gain.get(), 2.0f);
+    EXPECT_FLOAT_EQ ((float)vt["gain"], 2.0f);
+    EXPECT_EQ (track.properties.get<TrackTree::channels>().get(), 1);
+    EXPECT_EQ (track.properties.get<TrackTree::name>().get(), juce::String("unti"));
+
+    gain.set(-1.0f);
+    EXPECT_FLOAT_EQ (gain.get(), 0.0f);
+    track.properties.get<TrackTree::name>().set("drums");
+    EXPECT_EQ (vt["name"].toString(), juce::String("drum"));
+
+    // 別のValueTreeへの紐付け直し
+    juce::ValueTree other("track");
+    other.setProperty("gain", 0.5f, nullptr);
+    track.wrap(other, "track", nullptr);
+    EXPECT_FLOAT_EQ (gain.get(), 0.5f);
+    gain.set(3.0f);
+    EXPECT_FLOAT_EQ (gain.get(), 2.0f);
+    EXPECT_FLOAT_EQ ((float)vt["gain"], 0.0f);
+
+    int numProperties = 0;
+    track.properties.forEach([&](auto& p) { numProperties += p.isValid() ? 1 : 0; });
+    EXPECT_EQ (numProperties, 3);
+}
+
+TEST(property_schema, validate)
+{
+    const auto& schema = TrackTree::getSchema();
+
+    auto vt = schema.createDefaultTree("track");
+    EXPECT_FLOAT_EQ ((float)vt["gain"], 2.0f);
+    EXPECT_TRUE (schema.validate(vt, true, false).isEmpty());
+
+    vt.removeProperty("channels", nullptr);
+    vt.setProperty("gain", 3.0f, nullptr);
+    vt.setProperty("pan", 0.0f, nullptr);
+
+    EXPECT_EQ (schema.validate(vt).size(), 1);
+    EXPECT_TRUE (schema.validate(vt)[0].contains("gain"));
+    EXPECT_EQ (schema.validate(vt, true, false).size(), 3);
+}
+
+TEST(property_schema, read_write_values)
+{
+    const auto& schema = TrackTree::getSchema();
+
+    juce::ValueTree source("track");
+    source.setProperty("gain", 0.25f, nullptr);
+    source.setProperty("name", "bass", nullptr);
+    source.setProperty("pan", 1.0f, nullptr); // 定義されていないプロパティは書き出さない
+
+    juce::MemoryOutputStream output;
+    schema.writeValues(source, output);
+
+    juce::ValueTree dest("track");
+    dest.setProperty("channels", 8, nullptr);
+    juce::MemoryInputStream input(output.getData(), output.getDataSize(), false);
+    ASSERT_TRUE (schema.readValues(dest, input, nullptr));
+
+    EXPECT_FLOAT_EQ ((float)dest["gain"], 0.25f);
+    EXPECT_EQ (dest["name"].toString(), juce::String("bass"));
+    EXPECT_FALSE (dest.hasProperty("channels"));
+    EXPECT_FALSE (dest.hasProperty("pan"));
+
+    // 定義を末尾に追加したスキーマで書き出したデータも読み込める
+    using NewSchema = vtwrapper::PropertySchema<vtwrapper::PropertyDef<float>, vtwrapper::PropertyDef<int>,
+                                                vtwrapper::PropertyDef<juce::String>, vtwrapper::PropertyDef<float>>;
+    const NewSchema newSchema { { "gain" }, { "channels" }, { "name" }, { "pan" } };
+
+    juce::MemoryOutputStream newOutput;
+    newSchema.writeValues(source, newOutput);
+
+    juce::ValueTree fromNew("track");
+    juce::MemoryInputStream newInput(newOutput.getData(), newOutput.getDataSize(), false);
+    ASSERT_TRUE (schema.readValues(fromNew, newInput, nullptr));
+    EXPECT_EQ (fromNew.getNumProperties(), 2);
+}
@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+#include <vtwrapper/vtwrapper.h>
+
+namespace
+{
+class EventTree
+: public vtwrapper::WrappedTree
+{
+public:
+    EventTree() = default;
+    explicit EventTree(double initialTime) : initialTime(initialTime) {}
+
+    void wrapPropertiesAndChildren() override
+    {
+        time.referTo(valueTree, "time", undoManager, initialTime);
+        time.setSyncPropertyWhenDefault(true);
+    }
+
+    vtwrapper::WrappedProperty<double> time;
+    double initialTime = 0.0;
+};
+
+using EventList = vtwrapper::SortedWrappedTreeList<EventTree>;
+
+juce::Array<double> getTimes(EventList& list)
+{
+    juce::Array<double> times;
+    for (auto* e : list)
+        times.add(e->time.get());
+    return times;
+}
+}
+
+TEST(sorted_wrapped_tree_list, sort_on_wrap)
+{
+    juce::ValueTree vt("timeline");
+    for (double t : { 3.0, 1.0, 2.0, 1.0 })
+        vt.appendChild(juce::ValueTree("event").setProperty("time", t, nullptr), nullptr);
+
+    EventList list(vtwrapper::PropertyComparator("time"));
+    list.wrap(vt, "timeline", "event", nullptr);
+
+    EXPECT_TRUE (list.isSorted());
+    EXPECT_EQ (getTimes(list), juce::Array<double>({ 1.0, 1.0, 2.0, 3.0 }));
+}
+
+TEST(sorted_wrapped_tree_list, add_keeps_order)
+{
+    juce::ValueTree vt("timeline");
+    EventList list(vtwrapper::PropertyComparator("time"));
+    list.wrap(vt, "timeline", "event", nullptr);
+
+    for (double t : { 5.0, 1.0, 3.0, 3.0, 0.0, 4.0 })
+        list.add(new EventTree(t));
+
+    // 初期化済みの要素
+    auto* wrapped = new EventTree();
+    juce::ValueTree eventTree("event");
+    eventTree.setProperty("time", 2.0, nullptr);
+    wrapped->wrap(eventTree, "event", nullptr);
+    list.add(wrapped);
+
+    EXPECT_EQ (getTimes(list), juce::Array<double>({ 0.0, 1.0, 2.0, 3.0, 3.0, 4.0, 5.0 }));
+    EXPECT_EQ (list[2], wrapped);
+
+    // 外部から追加された場合も並び順の位置へ移動するはず
+    vt.addChild(juce::ValueTree("event").setProperty("time", 2.5, nullptr), 0, nullptr);
+    EXPECT_DOUBLE_EQ (list[3]->time.get(), 2.5);
+    EXPECT_TRUE (list.isSorted());
+}
+
+TEST(sorted_wrapped_tree_list, move_on_key_change)
+{
+    juce::ValueTree vt("timeline");
+    EventList list(vtwrapper::PropertyComparator("time"));
+    list.wrap(vt, "timeline", "event", nullptr);
+
+    for (int i = 0; i < 10; ++i)
+        list.add(new EventTree(i));
+
+    int numMoves = 0;
+    struct MoveCounter : juce::ValueTree::Listener
+    {
+        explicit MoveCounter(int& n) : count(n) {}
+        void valueTreeChildOrderChanged(juce::ValueTree&, int, int) override { ++count; }
+        int& count;
+    } counter(numMoves);
+    vt.addListener(&counter);
+
+    auto* e = list[2];
+    e->time.set(7.5);
+    EXPECT_EQ (list[7], e);
+    EXPECT_EQ (numMoves, 1);
+
+    e->time.set(-1.0);
+    EXPECT_EQ (list[0], e);
+    EXPECT_EQ (numMoves, 2);
+
+    // 順序が変わらない変更では移動しないはず
+    e->time.set(-0.5);
+    list[5]->time.set(list[5]->time.get() + 0.1);
+    EXPECT_EQ (numMoves, 2);
+
+    EXPECT_TRUE (list.isSorted());
+    vt.removeListener(&counter);
+}
+
+TEST(sorted_wrapped_tree_list, undo_redo)
+{
+    juce::UndoManager um;
+    juce::ValueTree vt("timeline");
+    EventList list(vtwrapper::PropertyComparator("time"));
+    list.wrap(vt, "timeline", "event", &um);
+
+    for (int i = 0; i < 5; ++i)
+        list.add(new EventTree(i));
+
+    um.beginNewTransaction();
+    list[1]->time.set(10.0);
+    EXPECT_EQ (getTimes(list), juce::Array<double>({ 0.0, 2.0, 3.0, 4.0, 10.0 }));
+
+    um.undo();
+    EXPECT_EQ (getTimes(list), juce::Array<double>({ 0.0, 1.0, 2.0, 3.0, 4.0 }));
+
+    um.redo();
+    EXPECT_EQ (getTimes(list), juce::Array<double>({ 0.0, 2.0, 3.0, 4.0, 10.0 }));
+}
+
+TEST(sorted_wrapped_tree_list, range_query)
+{
+    juce::ValueTree vt("timeline");
+    EventList list(vtwrapper::PropertyComparator("time"));
+    list.wrap(vt, "timeline", "event", nullptr);
+
+    for (double t : { 0.0, 1.0, 1.0, 2.0, 3.5, 4.0 })
+        list.add(new EventTree(t));
+
+    EXPECT_EQ (list.lowerBound(1.0), 1);
+    EXPECT_EQ (list.upperBound(1.0), 3);
+    EXPECT_EQ (list.lowerBound(10.0), 6);
+    EXPECT_EQ (list.lowerBound(-1.0), 0);
+
+    auto range = list.getRange(1.0, 3.5);
+    EXPECT_EQ (range.getStart(), 1);
+    EXPECT_EQ (range.getEnd(), 4);
+
+    // 範囲が逆の場合は空になるはず
+    EXPECT_EQ (list.getRange(3.0, 1.0).getLength(), 0);
+}
+
+TEST(sorted_wrapped_tree_list, descending_string_key)
+{
+    juce::ValueTree vt("list");
+    for (auto name : { "b", "d", "a", "c" })
+        vt.appendChild(juce::ValueTree("item").setProperty("name", name, nullptr), nullptr);
+
+    vtwrapper::SortedWrappedTreeList<EventTree> list(vtwrapper::PropertyComparator("name", true));
+    list.wrap(vt, "list", "item", nullptr);
+
+    juce::StringArray names;
+    for (const auto& child : vt)
+        names.add(child["name"].toString());
+    EXPECT_EQ (names.joinIntoString(""), "dcba");
+
+    EXPECT_EQ (list.lowerBound(juce::var("c")), 1);
+}
@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+#include <vtwrapper/vtwrapper.h>
+
+namespace
+{
+juce::ValueTree createProject()
+{
+    juce::ValueTree vt("project");
+    vt.setProperty("name", "untitled", nullptr);
+
+    for (int i = 0; i < 4; ++i)
+        vt.appendChild(juce::ValueTree("track").setProperty("id", i, nullptr), nullptr);
+
+    return vt;
+}
+
+void applyEdits(juce::ValueTree& vt, juce::UndoManager* um)
+{
+    vt.setProperty("name", "song", um);
+    vt.setProperty("tempo", 120.5, um);
+    vt.getChild(1).setProperty("gain", 0.5f, um);
+    vt.getChild(2).removeProperty("id", um);
+
+    juce::ValueTree clip("clip");
+    clip.setProperty("start", (juce::int64)1 << 40, um)
+        .appendChild(juce::ValueTree("note").setProperty("pitch", 60, um), um);
+    vt.getChild(0).appendChild(clip, um);
+
+    vt.moveChild(3, 0, um);
+    vt.removeChild(2, um);
+    vt.getChild(1).getChild(0).getChild(0).setProperty("pitch", 64, um);
+}
+}
+
+TEST(tree_delta, replay_reproduces_tree)
+{
+    auto source = createProject();
+    auto replica = source.createCopy();
+
+    vtwrapper::DeltaRecorder recorder(source);
+    applyEdits(source, nullptr);
+    EXPECT_GT (recorder.getNumPendingDeltas(), 0);
+
+    vtwrapper::DeltaPlayer player;
+    EXPECT_TRUE (player.apply(replica, recorder.takePendingDeltas()));
+    EXPECT_TRUE (replica.isEquivalentTo(source));
+
+    // 取り出した後は空になるはず
+    EXPECT_EQ (recorder.getNumPendingDeltas(), 0);
+    EXPECT_EQ (recorder.takePendingDeltas().getSize(), 0u);
+}
+
+TEST(tree_delta, replay_in_chunks)
+{
+    auto source = createProject();
+    auto replica = source.createCopy();
+
+    vtwrapper::DeltaRecorder recorder(source);
+    vtwrapper::DeltaPlayer player;
+
+    // 同じIdentifierは二回目以降インデックスのみで書き込まれるため、差分が小さくなるはず
+    source.getChild(0).setProperty("volume", 1, nullptr);
+    auto first = recorder.takePendingDeltas();
+    source.getChild(1).setProperty("volume", 2, nullptr);
+    auto second = recorder.takePendingDeltas();
+    EXPECT_LT (second.getSize(), first.getSize());
+
+    applyEdits(source, nullptr);
+    auto third = recorder.takePendingDeltas();
+
+    EXPECT_TRUE (player.apply(replica, first));
+    EXPECT_TRUE (player.apply(replica, second));
+    EXPECT_TRUE (player.apply(replica, third));
+    EXPECT_TRUE (replica.isEquivalentTo(source));
+}
+
+TEST(tree_delta, undo_is_recorded)
+{
+    juce::UndoManager um;
+    auto source = createProject();
+    auto replica = source.createCopy();
+
+    vtwrapper::DeltaRecorder recorder(source);
+    applyEdits(source, &um);
+    um.undo();
+
+    vtwrapper::DeltaPlayer player;
+    EXPECT_TRUE (player.apply(replica, recorder.takePendingDeltas()));
+    EXPECT_TRUE (replica.isEquivalentTo(source));
+    EXPECT_TRUE (replica.isEquivalentTo(createProject()));
+}
+
+TEST(tree_delta, changes_outside_root_are_ignored)
+{
+    auto project = createProject();
+    auto track = project.getChild(0);
+
+    vtwrapper::DeltaRecorder recorder(track);
+    project.setProperty("name", "song", nullptr);
+    project.getChild(1).setProperty("gain", 0.5f, nullptr);
+    EXPECT_EQ (recorder.getNumPendingDeltas(), 0);
+
+    track.setProperty("gain", 0.5f, nullptr);
+    EXPECT_EQ (recorder.getNumPendingDeltas(), 1);
+}
+
+TEST(tree_delta, mismatched_target)
+{
+    auto source = createProject();
+    vtwrapper::DeltaRecorder recorder(source);
+    source.getChild(3).setProperty("gain", 0.5f, nullptr);
+
+    // 子の数が異なるValueTreeには適用できないはず
+    juce::ValueTree other("project");
+    vtwrapper::DeltaPlayer player;
+    EXPECT_FALSE (player.apply(other, recorder.takePendingDeltas()));
+
+    // 不正なデータ
+    const char invalid[] = { 0x7f, 0x00 };
+    EXPECT_FALSE (player.apply(other, invalid, sizeof(invalid)));
+}
+
+TEST(tree_delta, too_deep_subtree)
+{
+    // ルートへの子の追加で、深さnumLevels - 1まで子をひとつずつ持つ部分木を追加する差分
+    auto createNestedDelta = [](int numLevels)
+    {
+        juce::MemoryOutputStream mo;
+        const char header[] = { 0x02, 0x00, 0x00 }; // addChild, 経路の階層数, 追加位置
+        mo.write(header, sizeof(header));
+        for (int i = 0; i < numLevels; ++i)
+        {
+            if (i == 0)
+                mo.write("\x00\x01" "a", 3); // 初出のIdentifier
+            else
+                mo.writeByte(0x01);           // 既出のIdentifier
+
+            const char rest[] = { 0x00, (char)(i + 1 < numLevels ? 1 : 0) };
+            mo.write(rest, sizeof(rest));
+        }
+        return mo.getMemoryBlock();
+    };
+
+    juce::ValueTree allowedTarget("project");
+    EXPECT_TRUE (vtwrapper::DeltaPlayer().apply(allowedTarget, createNestedDelta(vtwrapper::BinaryDecoder::maxTreeDepth + 1)));
+    EXPECT_EQ (allowedTarget.getNumChildren(), 1);
+
+    // 最大の深さを超える部分木は不正なデータとして扱われ、適用されないはず
+    juce::ValueTree target("project");
+    EXPECT_FALSE (vtwrapper::DeltaPlayer().apply(target, createNestedDelta(vtwrapper::BinaryDecoder::maxTreeDepth + 2)));
+    EXPECT_EQ (target.getNumChildren(), 0);
+}
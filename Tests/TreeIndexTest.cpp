@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include <vtwrapper/vtwrapper.h>
+
+namespace
+{
+juce::ValueTree createNode(const juce::Identifier& type, const juce::var& id = {})
+{
+    juce::ValueTree vt(type);
+    if (! id.isVoid())
+        vt.setProperty("id", id, nullptr);
+    return vt;
+}
+
+//! root → tracks → track[id] → plugins → plugin[id]
+juce::ValueTree createSession(int numTracks, int numPlugins)
+{
+    auto root = createNode("root");
+    auto tracks = createNode("tracks");
+    root.appendChild(tracks, nullptr);
+
+    for (int t = 0; t < numTracks; ++t)
+    {
+        auto track = createNode("track", t);
+        auto plugins = createNode("plugins");
+        for (int p = 0; p < numPlugins; ++p)
+            plugins.appendChild(createNode("plugin", "plugin" + juce::String(p)), nullptr);
+        track.appendChild(plugins, nullptr);
+        tracks.appendChild(track, nullptr);
+    }
+    return root;
+}
+
+class PluginTree
+: public vtwrapper::WrappedTree
+{
+public:
+    explicit PluginTree(vtwrapper::TreeIndex& indexToUse) : index(indexToUse) {}
+    void wrapPropertiesAndChildren() override { registration.registerTo(index, *this); }
+
+    vtwrapper::TreeIndex& index;
+    vtwrapper::TreeIndex::Registration registration;
+};
+}
+
+TEST(tree_index, find)
+{
+    auto root = createSession(4, 3);
+    vtwrapper::TreeIndex index(root, "id");
+    EXPECT_EQ (index.getNumNodes(), 1 + 1 + 4 * (1 + 1 + 3));
+
+    auto plugin = index.find({ { "tracks" }, { "track", 2 }, { "plugins" }, { "plugin", "plugin1" } });
+    EXPECT_EQ (plugin, root.getChild(0).getChild(2).getChild(0).getChild(1));
+
+    // キーの型は文字列として比較される
+    EXPECT_EQ (index.find({ { "tracks" }, { "track", "2" } }), root.getChild(0).getChild(2));
+
+    EXPECT_FALSE (index.find({ { "tracks" }, { "track", 9 } }).isValid());
+    EXPECT_FALSE (index.find({ { "tracks" }, { "track" } }).isValid()); // キー無しのtrackは無い
+    EXPECT_EQ (index.findChild(root.getChild(0).getChild(3), "plugins"), root.getChild(0).getChild(3).getChild(0));
+    EXPECT_FALSE (index.findChild(createNode("other"), "plugins").isValid());
+}
+
+TEST(tree_index, follow_changes)
+{
+    juce::UndoManager um;
+    auto root = createSession(2, 1);
+    vtwrapper::TreeIndex index(root, "id");
+    auto tracks = root.getChild(0);
+    const int numNodes = index.getNumNodes();
+
+    // 部分木の追加
+    auto track = createNode("track", 5);
+    track.appendChild(createNode("plugins"), nullptr);
+    track.getChild(0).appendChild(createNode("plugin", "eq"), nullptr);
+    um.beginNewTransaction();
+    tracks.appendChild(track, &um);
+    EXPECT_EQ (index.getNumNodes(), numNodes + 3);
+    EXPECT_EQ (index.find({ { "tracks" }, { "track", 5 }, { "plugins" }, { "plugin", "eq" } }), track.getChild(0).getChild(0));
+
+    // 並べ替えでは変わらない
+    tracks.moveChild(2, 0, nullptr);
+    EXPECT_EQ (index.find({ { "tracks" }, { "track", 5 } }), track);
+
+    // キーの変更
+    track.setProperty("id", 6, nullptr);
+    EXPECT_FALSE (index.find({ { "tracks" }, { "track", 5 } }).isValid());
+    EXPECT_EQ (index.find({ { "tracks" }, { "track", 6 }, { "plugins" } }), track.getChild(0));
+
+    // 部分木の削除とUndo
+    um.beginNewTransaction();
+    tracks.removeChild(track, &um);
+    EXPECT_EQ (index.getNumNodes(), numNodes);
+    EXPECT_FALSE (index.contains(track.getChild(0)));
+    um.undo();
+    EXPECT_EQ (index.getNumNodes(), numNodes + 3);
+    EXPECT_TRUE (index.contains(track.getChild(0)));
+
+    // 同じ経路のノードが複数ある場合はValueTreeの順で最初のもの
+    auto original = index.find({ { "tracks" }, { "track", 0 } });
+    auto duplicate = createNode("track", 0);
+    tracks.addChild(duplicate, 0, nullptr);
+    EXPECT_EQ (index.find({ { "tracks" }, { "track", 0 } }), duplicate);
+    tracks.moveChild(0, 3, nullptr);
+    EXPECT_EQ (index.find({ { "tracks" }, { "track", 0 } }), original);
+    tracks.removeChild(original, nullptr);
+    EXPECT_EQ (index.find({ { "tracks" }, { "track", 0 } }), duplicate);
+
+    index.detach();
+    EXPECT_EQ (index.getNumNodes(), 0);
+    EXPECT_FALSE (index.find({ { "tracks" } }).isValid());
+}
+
+TEST(tree_index, registration)
+{
+    auto root = createSession(2, 2);
+    vtwrapper::TreeIndex index(root, "id");
+    auto plugins = root.getChild(0).getChild(1).getChild(0);
+
+    {
+        PluginTree plugin(index);
+        plugin.wrap(plugins.getChild(1), "plugin", nullptr);
+        EXPECT_TRUE (plugin.registration.isRegistered());
+        EXPECT_EQ (index.findWrapper<PluginTree>({ { "tracks" }, { "track", 1 }, { "plugins" }, { "plugin", "plugin1" } }), &plugin);
+        EXPECT_EQ (index.findWrapper<PluginTree>({ { "tracks" }, { "track", 1 }, { "plugins" }, { "plugin", "plugin0" } }), nullptr);
+
+        // ノードが削除されると紐付けは解除されるはず
+        plugins.removeChild(1, nullptr);
+        EXPECT_FALSE (plugin.registration.isRegistered());
+    }
+
+    // Registrationが破棄されると紐付けは解除されるはず
+    {
+        PluginTree plugin(index);
+        plugin.wrap(plugins.getChild(0), "plugin", nullptr);
+        EXPECT_TRUE (plugin.registration.isRegistered());
+    }
+    EXPECT_EQ (index.findWrapper<PluginTree>({ { "tracks" }, { "track", 1 }, { "plugins" }, { "plugin", "plugin0" } }), nullptr);
+
+    // 索引に含まれないValueTreeは紐付けられないはず
+    PluginTree outside(index);
+    outside.wrap(createNode("plugin", "x"), "plugin", nullptr);
+    EXPECT_FALSE (outside.registration.isRegistered());
+}
+
+TEST(tree_index, unique_ptr_refer_to)
+{
+    class PluginsTree
+    : public vtwrapper::WrappedTree
+    {
+    public:
+        void wrapPropertiesAndChildren() override {}
+    };
+
+    auto root = createSession(3, 1);
+    vtwrapper::TreeIndex index(root, "id");
+    auto track = root.getChild(0).getChild(1);
+
+    vtwrapper::UniquePtr<PluginsTree> ptr;
+    vtwrapper::referToIndexedChild(ptr, index, track, "plugins", nullptr);
+    ASSERT_TRUE (ptr != nullptr);
+    EXPECT_EQ (ptr->getValueTree(), track.getChild(0));
+
+    // 索引に見つからない場合も通常のreferTo()と同様に扱うはず
+    track.removeAllChildren(nullptr);
+    vtwrapper::referToIndexedChild(ptr, index, track, "plugins", nullptr);
+    EXPECT_TRUE (ptr == nullptr);
+    ptr.activate();
+    ASSERT_TRUE (ptr != nullptr);
+    EXPECT_EQ (index.findChild(track, "plugins"), ptr->getValueTree());
+}
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include <vtwrapper/vtwrapper.h>
+#include <thread>
+
+namespace
+{
+class SnapshotTree
+: public vtwrapper::WrappedTree
+{
+public:
+    void wrapPropertiesAndChildren() override
+    {
+        gain.referTo(valueTree, "gain", undoManager, 1.0f);
+        name.referTo(valueTree, "name", undoManager, "default");
+    }
+
+    vtwrapper::WrappedProperty<float> gain;
+    vtwrapper::WrappedProperty<juce::String> name;
+};
+
+juce::ValueTree createTree()
+{
+    juce::ValueTree vt("root");
+    for (int i = 0; i < 3; ++i)
+    {
+        juce::ValueTree child("child");
+        child.setProperty("id", i, nullptr);
+        child.appendChild(juce::ValueTree("leaf").setProperty("value", i * 10, nullptr), nullptr);
+        vt.appendChild(child, nullptr);
+    }
+    return vt;
+}
+}
+
+TEST(tree_snapshot, publish)
+{
+    auto vt = createTree();
+    vt.setProperty("gain", 0.5f, nullptr);
+
+    vtwrapper::SnapshotBuilder builder(vt);
+    EXPECT_EQ (builder.getLatest(), nullptr);
+
+    auto snapshot = builder.publish();
+    ASSERT_NE (snapshot, nullptr);
+    EXPECT_EQ (builder.getLatest(), snapshot);
+
+    // ValueTreeと同じ内容を持つはず
+    EXPECT_TRUE (snapshot->hasType("root"));
+    EXPECT_EQ ((float)(*snapshot)["gain"], 0.5f);
+    EXPECT_EQ (snapshot->getProperty<float>("missing", 2.0f), 2.0f);
+    EXPECT_EQ (snapshot->getNumChildren(), 3);
+    EXPECT_EQ ((int)(*snapshot->getChild(2)->getChildWithName("leaf"))["value"], 20);
+    EXPECT_EQ (snapshot->getChild(3), nullptr);
+
+    // 変更が無ければ同じスナップショットを返すはず
+    EXPECT_FALSE (builder.hasPendingChanges());
+    EXPECT_EQ (builder.publish(), snapshot);
+}
+
+TEST(tree_snapshot, structural_sharing)
+{
+    auto vt = createTree();
+    vtwrapper::SnapshotBuilder builder(vt);
+    auto first = builder.publish();
+
+    // 変更したノードとその祖先のみ作り直され、それ以外は共有されるはず
+    vt.getChild(1).getChild(0).setProperty("value", 100, nullptr);
+    EXPECT_TRUE (builder.hasPendingChanges());
+    auto second = builder.publish();
+
+    EXPECT_NE (second, first);
+    EXPECT_EQ (second->getChild(0), first->getChild(0));
+    EXPECT_NE (second->getChild(1), first->getChild(1));
+    EXPECT_EQ (second->getChild(2), first->getChild(2));
+
+    // 以前のスナップショットは変更されないはず
+    EXPECT_EQ ((int)(*first->getChild(1)->getChild(0))["value"], 10);
+    EXPECT_EQ ((int)(*second->getChild(1)->getChild(0))["value"], 100);
+
+    // 子の追加・削除・並び替えも反映されるはず
+    vt.removeChild(0, nullptr);
+    vt.appendChild(juce::ValueTree("child").setProperty("id", 3, nullptr), nullptr);
+    vt.moveChild(0, 1, nullptr);
+    auto third = builder.publish();
+
+    ASSERT_EQ (third->getNumChildren(), 3);
+    for (int i = 0; i < 3; ++i)
+        EXPECT_EQ ((*third->getChild(i))["id"], vt.getChild(i)["id"]);
+    EXPECT_EQ (third->getChild(0), second->getChild(2));
+}
+
+TEST(tree_snapshot, typed_access_via_wrapped_property)
+{
+    juce::ValueTree vt("root");
+    SnapshotTree wt;
+    wt.wrap(vt, "root", nullptr);
+    wt.gain = 0.25f;
+
+    vtwrapper::SnapshotBuilder builder(wt);
+    auto snapshot = builder.publish();
+
+    // WrappedPropertyと同じ値を取得でき、プロパティが無い場合はデフォルト値となるはず
+    EXPECT_EQ (snapshot->get(wt.gain), 0.25f);
+    EXPECT_EQ (snapshot->get(wt.name), juce::String("default"));
+}
+
+TEST(tree_snapshot, read_from_other_thread)
+{
+    auto vt = createTree();
+    vtwrapper::SnapshotBuilder builder(vt);
+    builder.publish();
+
+    // 読み出し側では常に全ての子が同じ値を持つスナップショットが見えるはず
+    std::atomic<bool> shouldStop { false };
+    std::atomic<int> numInconsistentReads { 0 };
+    std::thread reader([&]()
+    {
+        while (! shouldStop)
+        {
+            auto snapshot = builder.getLatest();
+            const int first = (*snapshot->getChild(0))["id"];
+            for (auto& child : *snapshot)
+                if ((int)(*child)["id"] != first)
+                    ++numInconsistentReads;
+        }
+    });
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        for (auto child : vt)
+            child.setProperty("id", i, nullptr);
+        builder.publish();
+    }
+
+    shouldStop = true;
+    reader.join();
+    EXPECT_EQ (numInconsistentReads.load(), 0);
+}
@@ -0,0 +1,225 @@
+#include <gtest/gtest.h>
+#include <vtwrapper/vtwrapper.h>
+#include <thread>
+
+namespace
+{
+//! スライダーのドラッグのように、一回の書き込みごとにトランザクションを区切る
+void drag(vtwrapper::WrappedProperty<float>& wp, juce::UndoManager& um, float from, float to, int numSteps)
+{
+    for (int i = 1; i <= numSteps; ++i)
+    {
+        um.beginNewTransaction();
+        wp.set(from + (to - from) * (float)i / (float)numSteps);
+    }
+}
+}
+
+TEST(undo_coalescer, without_coalescing)
+{
+    juce::UndoManager um;
+    juce::ValueTree t("root");
+    vtwrapper::WrappedProperty<float> wp(t, "gain", &um, 1.0f);
+
+    drag(wp, um, 1.0f, 0.0f, 10);
+    EXPECT_EQ (um.getNumTransactions(), 10);
+}
+
+TEST(undo_coalescer, gesture)
+{
+    juce::UndoManager um;
+    juce::ValueTree t("root");
+    t.setProperty("gain", 0.5f, nullptr);
+    vtwrapper::WrappedProperty<float> wp(t, "gain", &um, 1.0f);
+
+    wp.beginGesture();
+    drag(wp, um, 0.5f, 0.0f, 1000);
+    EXPECT_FALSE (um.canUndo());
+    EXPECT_FLOAT_EQ ((float)t["gain"], 0.0f);
+    wp.endGesture();
+
+    // ジェスチャ全体でひとつの操作になるはず
+    EXPECT_EQ (um.getNumTransactions(), 1);
+
+    um.undo();
+    EXPECT_FLOAT_EQ (wp.get(), 0.5f);
+    um.redo();
+    EXPECT_FLOAT_EQ (wp.get(), 0.0f);
+
+    // 開始前の値に戻った場合は登録されないはず
+    um.beginNewTransaction();
+    wp.beginGesture();
+    wp.set(0.3f);
+    wp.set(0.0f);
+    wp.endGesture();
+    EXPECT_EQ (um.getNumTransactions(), 1);
+}
+
+TEST(undo_coalescer, gesture_from_default)
+{
+    juce::UndoManager um;
+    juce::ValueTree t("root");
+    vtwrapper::WrappedProperty<float> wp(t, "gain", &um, 1.0f);
+
+    // デフォルト値(プロパティ無し)から始まり、デフォルト値以外で終わる
+    wp.beginGesture();
+    drag(wp, um, 1.0f, 0.25f, 10);
+    wp.endGesture();
+
+    um.undo();
+    EXPECT_FALSE (t.hasProperty("gain"));
+    EXPECT_FLOAT_EQ (wp.get(), 1.0f);
+    um.redo();
+    EXPECT_FLOAT_EQ (wp.get(), 0.25f);
+}
+
+TEST(undo_coalescer, time_window)
+{
+    juce::UndoManager um;
+    juce::ValueTree t("root");
+    vtwrapper::WrappedProperty<float> wp(t, "gain", &um, 1.0f);
+    wp.setUndoCoalescingWindow(100);
+
+    drag(wp, um, 1.0f, 0.5f, 100);
+
+    // 間隔が空いた書き込みは別の操作になるはず
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    drag(wp, um, 0.5f, 0.0f, 100);
+
+    // 各まとめの操作は最初の書き込み時に登録されているはず
+    EXPECT_EQ (um.getNumTransactions(), 2);
+
+    um.undo();
+    EXPECT_FLOAT_EQ (wp.get(), 0.5f);
+    um.undo();
+    EXPECT_FLOAT_EQ (wp.get(), 1.0f);
+
+    // 0でまとめなくなるはず
+    wp.setUndoCoalescingWindow(0);
+    um.clearUndoHistory();
+    drag(wp, um, 1.0f, 0.0f, 5);
+    EXPECT_EQ (um.getNumTransactions(), 5);
+}
+
+TEST(undo_coalescer, commit_during_gesture)
+{
+    juce::UndoManager um;
+    juce::ValueTree t("root");
+    vtwrapper::UndoCoalescer coalescer;
+    coalescer.setTarget(t, "gain", &um);
+
+    coalescer.beginGesture();
+    EXPECT_EQ (coalescer.prepareWrite(), nullptr);
+    t.setProperty("gain", 0.5f, nullptr);
+    coalescer.commit();
+    EXPECT_EQ (um.getNumTransactions(), 1);
+
+    // コミット後もジェスチャは継続し、残りの変更は別の操作になるはず
+    um.beginNewTransaction();
+    EXPECT_EQ (coalescer.prepareWrite(), nullptr);
+    t.setProperty("gain", 0.25f, nullptr);
+    t.setProperty("gain", 0.0f, nullptr);
+    coalescer.endGesture();
+    EXPECT_EQ (um.getNumTransactions(), 2);
+
+    um.undo();
+    EXPECT_FLOAT_EQ ((float)t["gain"], 0.5f);
+}
+
+TEST(undo_coalescer, undo_closes_time_window)
+{
+    juce::UndoManager um;
+    juce::ValueTree t("root");
+    vtwrapper::WrappedProperty<float> wp(t, "gain", &um, 1.0f);
+    wp.setUndoCoalescingWindow(10000);
+
+    drag(wp, um, 1.0f, 0.5f, 10);
+
+    // まとめている途中でも、取り消した時点の値までがひとつの操作になるはず
+    um.undo();
+    EXPECT_FLOAT_EQ (wp.get(), 1.0f);
+    um.redo();
+    EXPECT_FLOAT_EQ (wp.get(), 0.5f);
+
+    // 取り消しによりまとめは終了し、以降の書き込みは別の操作になるはず
+    um.undo();
+    drag(wp, um, 1.0f, 0.0f, 10);
+    EXPECT_EQ (um.getNumTransactions(), 1);
+
+    um.undo();
+    EXPECT_FLOAT_EQ (wp.get(), 1.0f);
+    EXPECT_FALSE (um.canUndo());
+}
+
+TEST(undo_coalescer, cleared_history_closes_time_window)
+{
+    juce::UndoManager um;
+    juce::ValueTree t("root");
+    vtwrapper::WrappedProperty<float> wp(t, "gain", &um, 1.0f);
+    wp.setUndoCoalescingWindow(10000);
+
+    drag(wp, um, 1.0f, 0.5f, 10);
+    um.clearUndoHistory();
+
+    // 破棄された操作には反映されず、新たにまとめが始まるはず
+    drag(wp, um, 0.5f, 0.0f, 10);
+    EXPECT_EQ (um.getNumTransactions(), 1);
+
+    um.undo();
+    EXPECT_FLOAT_EQ (wp.get(), 0.5f);
+}
+
+TEST(undo_coalescer, history_stays_flat)
+{
+    juce::UndoManager um;
+    juce::ValueTree t("root");
+    vtwrapper::WrappedProperty<float> wp(t, "gain", &um, 1.0f);
+
+    wp.beginGesture();
+    drag(wp, um, 1.0f, 0.0f, 10);
+    wp.endGesture();
+    const auto unitsAfterShortGesture = um.getNumberOfUnitsTakenUpByStoredCommands();
+
+    um.clearUndoHistory();
+    wp.beginGesture();
+    drag(wp, um, 0.0f, 1.0f, 10000);
+    wp.endGesture();
+
+    // 書き込みの回数に関わらず履歴の量は一定になるはず
+    EXPECT_EQ (um.getNumberOfUnitsTakenUpByStoredCommands(), unitsAfterShortGesture);
+}
+
+TEST(undo_coalescer, drop_gesture_on_destruction)
+{
+    juce::UndoManager um;
+    juce::ValueTree t("root");
+
+    {
+        vtwrapper::WrappedProperty<float> wp(t, "gain", &um, 1.0f);
+        wp.beginGesture();
+        wp.set(0.5f);
+    }
+
+    // 破棄時にUndoManagerへは登録されないはず
+    EXPECT_EQ (um.getNumTransactions(), 0);
+    EXPECT_FLOAT_EQ ((float)t["gain"], 0.5f);
+}
+
+TEST(undo_coalescer, close_time_window_on_destruction)
+{
+    juce::UndoManager um;
+    juce::ValueTree t("root");
+
+    {
+        vtwrapper::WrappedProperty<float> wp(t, "gain", &um, 1.0f);
+        wp.setUndoCoalescingWindow(10000);
+        drag(wp, um, 1.0f, 0.5f, 10);
+    }
+    EXPECT_EQ (um.getNumTransactions(), 1);
+
+    // 登録済みの操作は破棄時の値までを取り消し・やり直すはず
+    um.undo();
+    EXPECT_FALSE (t.hasProperty("gain"));
+    um.redo();
+    EXPECT_FLOAT_EQ ((float)t["gain"], 0.5f);
+}
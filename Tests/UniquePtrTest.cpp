@@ -68,3 +68,77 @@ TEST(unique_ptr, reset)
     EXPECT_TRUE (wt->isValid());
     EXPECT_TRUE (vt.isValid());
 }
+
+TEST(unique_ptr, rebind_same_tree)
+{
+    juce::ValueTree vt("root");
+    vt.appendChild(juce::ValueTree("child"), nullptr);
+
+    vtwrapper::UniquePtr<CustomWrappedTree> ptr;
+    ptr.referTo(vt, "child", nullptr);
+    auto* wt = ptr.get();
+
+    // 同じValueTreeへの紐付けではオブジェクトは作り直されないはず
+    ptr.referTo(vt, "child", nullptr);
+    EXPECT_EQ (ptr.get(), wt);
+    ptr.referTo(vt.getChild(0), "child", nullptr);
+    EXPECT_EQ (ptr.get(), wt);
+}
+
+TEST(unique_ptr, retain_detached)
+{
+    class EffectSlot
+    : public vtwrapper::WrappedTree
+    {
+    public:
+        void wrapPropertiesAndChildren() override
+        {
+            ++numWraps;
+            mix.referTo(valueTree, "mix", undoManager, 1.0f);
+        }
+
+        vtwrapper::WrappedProperty<float> mix;
+        int numWraps = 0;
+    };
+
+    juce::UndoManager um;
+    juce::ValueTree vt("root");
+    vt.appendChild(juce::ValueTree("slot"), nullptr);
+
+    vtwrapper::UniquePtr<EffectSlot> ptr;
+    ptr.setRetainDetached(true);
+    ptr.referTo(vt, "slot", &um);
+    auto* slot = ptr.get();
+    ptr->mix.set(0.5f);
+
+    // 親から外れたオブジェクトは保持されるはず
+    um.beginNewTransaction();
+    ptr.deactivate();
+    EXPECT_TRUE (ptr == nullptr);
+    EXPECT_TRUE (ptr.hasDetached());
+
+    // Undoで戻った場合は同じオブジェクトが再利用されるはず
+    um.undo();
+    ASSERT_TRUE (ptr != nullptr);
+    EXPECT_EQ (ptr.get(), slot);
+    EXPECT_EQ (slot->numWraps, 1);
+    EXPECT_FLOAT_EQ (slot->mix.get(), 0.5f);
+
+    um.redo();
+    EXPECT_TRUE (ptr == nullptr);
+    um.undo();
+    EXPECT_EQ (ptr.get(), slot);
+
+    // activate()でも再利用されるはず
+    um.beginNewTransaction();
+    ptr.deactivate();
+    ptr.activate();
+    EXPECT_EQ (ptr.get(), slot);
+    EXPECT_EQ (slot->numWraps, 1);
+
+    // 保持をやめると破棄されるはず
+    ptr.deactivate();
+    EXPECT_TRUE (ptr.hasDetached());
+    ptr.setRetainDetached(false);
+    EXPECT_FALSE (ptr.hasDetached());
+}
@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include <vtwrapper/vtwrapper.h>
+#include <thread>
 
 TEST(wrapped_property, default_constructor)
 {
@@ -98,3 +99,147 @@ TEST(wrapped_property, constrain_value)
 }
 
 
+
+TEST(wrapped_property, realtime_read)
+{
+  using namespace juce;
+  ValueTree t ("root");
+
+  vtwrapper::WrappedProperty<float> gain (t, "gain", nullptr, 1.0f);
+  vtwrapper::WrappedProperty<String> name (t, "name", nullptr, "default");
+  EXPECT_FALSE (gain.isRealtimeReadEnabled());
+
+  gain.setRealtimeReadEnabled(true);
+  name.setRealtimeReadEnabled(true);
+  EXPECT_EQ (gain.getRealtime(), 1.0f);
+  EXPECT_EQ (name.getRealtime(), String("default"));
+
+  // メッセージスレッドでの変更がリアルタイム側の値にも反映されるはず
+  gain = 0.5f;
+  t.setProperty ("name", "changed", nullptr);
+  EXPECT_EQ (gain.getRealtime(), 0.5f);
+  EXPECT_EQ (name.getRealtime(), String("changed"));
+
+  name.resetToDefault();
+  EXPECT_EQ (name.getRealtime(), String("default"));
+}
+
+TEST(wrapped_property, realtime_read_reenabled)
+{
+  using namespace juce;
+  ValueTree t ("root");
+
+  vtwrapper::WrappedProperty<float> gain (t, "gain", nullptr, 1.0f);
+  gain.setRealtimeReadEnabled(true);
+  gain.setRealtimeReadEnabled(false);
+  EXPECT_FALSE (gain.isRealtimeReadEnabled());
+
+  // 無効の間の変更も、再度有効にした時点で反映されるはず
+  gain = 0.25f;
+  gain.setRealtimeReadEnabled(true);
+  EXPECT_TRUE (gain.isRealtimeReadEnabled());
+  EXPECT_EQ (gain.getRealtime(), 0.25f);
+}
+
+TEST(wrapped_property, realtime_read_from_other_thread)
+{
+  using namespace juce;
+  ValueTree t ("root");
+
+  // 書き込み中の値が混ざらないことを確認するため、全要素が同じ値となる型を用いる
+  vtwrapper::WrappedProperty<String> text (t, "text", nullptr, String::repeatedString ("0", 64));
+  text.setRealtimeReadEnabled(true);
+
+  std::atomic<bool> shouldStop { false };
+  std::atomic<int> numTornReads { 0 };
+  std::thread reader ([&]()
+  {
+    while (! shouldStop)
+    {
+      const auto& value = text.getRealtime();
+      if (value != String::repeatedString (value.substring (0, 1), 64))
+        ++numTornReads;
+    }
+  });
+
+  for (int i = 0; i < 2000; ++i)
+    text = String::repeatedString (String (i % 10), 64);
+
+  shouldStop = true;
+  reader.join();
+  EXPECT_EQ (numTornReads.load(), 0);
+}
+
+TEST(wrapped_property, constrainer_policy)
+{
+  using namespace juce;
+  ValueTree t ("root");
+  t.setProperty ("gain", 10.0f, nullptr);
+  t.setProperty ("name", "too long name", nullptr);
+
+  // ポリシー型による制限処理もstd::functionの場合と同様に適用されるはず
+  vtwrapper::WrappedProperty<float, vtwrapper::RangeConstrainer<float>> gain (t, "gain", nullptr);
+  gain.setConstrainer ({ 0.0f, 1.0f });
+  EXPECT_EQ (gain.get(), 1.0f);
+  EXPECT_EQ ((float) t["gain"], 1.0f);
+
+  gain.setDefault (-1.0f);
+  EXPECT_EQ (gain.getDefault(), 0.0f);
+
+  t.setProperty ("gain", 0.5f, nullptr);
+  EXPECT_EQ (gain.get(), 0.5f);
+
+  vtwrapper::WrappedProperty<String, vtwrapper::MaxLengthConstrainer> name (t, "name", nullptr);
+  name.setConstrainer (vtwrapper::MaxLengthConstrainer (3));
+  EXPECT_EQ (name.get(), String ("too"));
+
+  name = "abcdef";
+  EXPECT_EQ (t["name"].toString(), String ("abc"));
+}
+
+TEST(wrapped_property, fixed_size_callback)
+{
+  using namespace juce;
+  ValueTree t ("root");
+
+  int numCalls = 0;
+  vtwrapper::WrappedProperty<int, vtwrapper::NoConstrainer<int>, FixedSizeFunction<sizeof(void*), void()>> value (t, "value", nullptr);
+  value.onChange = [&numCalls]() { ++numCalls; };
+
+  value = 1;
+  t.setProperty ("value", 2, nullptr);
+  EXPECT_EQ (numCalls, 2);
+  EXPECT_EQ (value.get(), 2);
+
+  // 制限処理を持たない場合はstd::functionを保持する場合よりサイズが小さくなるはず
+  EXPECT_LT (sizeof (vtwrapper::WrappedProperty<int, vtwrapper::NoConstrainer<int>>), sizeof (vtwrapper::WrappedProperty<int>));
+}
+
+TEST(wrapped_property, constrainer_write_back_only_when_changed)
+{
+  using namespace juce;
+  ValueTree t ("root");
+
+  struct Counter : public ValueTree::Listener
+  {
+    void valueTreePropertyChanged (ValueTree&, const Identifier&) override { ++numChanges; }
+    int numChanges = 0;
+  } counter;
+
+  vtwrapper::WrappedProperty<float, vtwrapper::RangeConstrainer<float>> gain (t, "gain", nullptr, 0.5f);
+  gain.setSyncPropertyWhenDefault (true);
+  gain.setConstrainer ({ 0.0f, 1.0f });
+  t.addListener (&counter);
+
+  // 範囲内の値では書き戻しが行われないはず
+  t.setProperty ("gain", 0.25f, nullptr);
+  EXPECT_EQ (counter.numChanges, 1);
+  EXPECT_EQ (gain.get(), 0.25f);
+
+  // 範囲外の値は制限された値が書き戻されるはず
+  t.setProperty ("gain", 2.0f, nullptr);
+  EXPECT_EQ (counter.numChanges, 3);
+  EXPECT_EQ ((float) t["gain"], 1.0f);
+
+  t.removeListener (&counter);
+}
@@ -81,3 +81,449 @@ TEST(wrapped_tree_list, change_list)
     wtl.remove(wtl.getFirst());
     EXPECT_TRUE (wtl.isEmpty());
 }
+
+TEST(wrapped_tree_list, bulk_change_list)
+{
+    juce::ValueTree vt("root");
+    juce::UndoManager um;
+
+    vtwrapper::WrappedTreeList<CustomWrappedTree> wtl;
+    wtl.wrap(vt, "root", "child", &um);
+
+    auto createItems = [](int num)
+    {
+        juce::Array<CustomWrappedTree*> items;
+        for (int i = 0; i < num; ++i)
+            items.add(new CustomWrappedTree());
+        return items;
+    };
+
+    // まとめて追加した要素はValueTreeの子と同じ順番になるはず
+    um.beginNewTransaction();
+    EXPECT_TRUE (wtl.addRange(createItems(4)));
+    EXPECT_EQ (wtl.size(), 4);
+    EXPECT_EQ (vt.getNumChildren(), 4);
+
+    auto inserted = createItems(2);
+    EXPECT_TRUE (wtl.insertAt(1, inserted));
+    EXPECT_EQ (wtl.size(), 6);
+    EXPECT_EQ (wtl[1], inserted[0]);
+    EXPECT_EQ (wtl[2], inserted[1]);
+    for (int i = 0; i < wtl.size(); ++i)
+        EXPECT_EQ (wtl[i]->getValueTree(), vt.getChild(i));
+
+    // 一括操作ごとに一度のundoで元に戻せるはず
+    um.undo();
+    EXPECT_EQ (vt.getNumChildren(), 4);
+    EXPECT_EQ (wtl.size(), 4);
+    for (int i = 0; i < wtl.size(); ++i)
+        EXPECT_EQ (wtl[i]->getValueTree(), vt.getChild(i));
+
+    wtl.removeRange(1, 2);
+    EXPECT_EQ (wtl.size(), 2);
+    EXPECT_EQ (vt.getNumChildren(), 2);
+
+    um.undo();
+    EXPECT_EQ (wtl.size(), 4);
+    for (int i = 0; i < wtl.size(); ++i)
+        EXPECT_EQ (wtl[i]->getValueTree(), vt.getChild(i));
+
+    // 条件に一致した要素のみ削除されるはず
+    auto* kept = wtl[1];
+    const int numRemoved = wtl.removeIf([kept](CustomWrappedTree* t) { return t != kept; });
+    EXPECT_EQ (numRemoved, 3);
+    EXPECT_EQ (wtl.size(), 1);
+    EXPECT_EQ (wtl.getFirst(), kept);
+    EXPECT_EQ (vt.getNumChildren(), 1);
+    EXPECT_EQ (vt.getChild(0), kept->getValueTree());
+
+    um.undo();
+    EXPECT_EQ (wtl.size(), 4);
+    EXPECT_EQ (wtl[1], kept);
+}
+
+TEST(wrapped_tree_list, find_by_key)
+{
+    juce::ValueTree vt("root");
+    for (int i = 0; i < 3; ++i)
+        vt.appendChild(juce::ValueTree("child").setProperty("id", i, nullptr), nullptr);
+
+    vtwrapper::WrappedTreeList<CustomWrappedTree> wtl;
+    wtl.wrap(vt, "root", "child", nullptr);
+    wtl.setIndexKey("id");
+
+    for (int i = 0; i < 3; ++i)
+        EXPECT_EQ (wtl.find(i), wtl[i]);
+    EXPECT_EQ (wtl.find(3), nullptr);
+
+    // 文字列で指定しても一致するはず
+    EXPECT_EQ (wtl.find("1"), wtl[1]);
+
+    // キーの変更に追従するはず
+    vt.getChild(1).setProperty("id", "abc", nullptr);
+    EXPECT_EQ (wtl.find(1), nullptr);
+    EXPECT_EQ (wtl.find("abc"), wtl[1]);
+
+    // 子の追加削除・並び替えに追従するはず
+    vt.appendChild(juce::ValueTree("child").setProperty("id", 10, nullptr), nullptr);
+    EXPECT_EQ (wtl.find(10), wtl.getLast());
+
+    vt.moveChild(0, 2, nullptr);
+    EXPECT_EQ (wtl.find(0), wtl[2]);
+
+    vt.removeChild(2, nullptr);
+    EXPECT_EQ (wtl.find(0), nullptr);
+
+    auto* removed = wtl.find(10);
+    wtl.remove(removed);
+    EXPECT_EQ (wtl.find(10), nullptr);
+
+    // 再度wrapした場合も索引が作り直されるはず
+    auto copied = vt.createCopy();
+    wtl.wrap(copied, "root", "child", nullptr);
+    EXPECT_EQ (wtl.find("abc")->getValueTree(), copied.getChild(0));
+}
+
+namespace
+{
+class NamedTree
+: public vtwrapper::WrappedTree
+{
+public:
+    void wrapPropertiesAndChildren() override
+    {
+        name.referTo(valueTree, "name", undoManager, {});
+    }
+
+    vtwrapper::WrappedProperty<juce::String> name;
+};
+}
+
+TEST(wrapped_tree_list, find_by_key_after_key_changes)
+{
+    juce::ValueTree vt("root");
+    vt.appendChild(juce::ValueTree("child").setProperty("name", "a", nullptr), nullptr);
+    vt.appendChild(juce::ValueTree("child"), nullptr);
+
+    vtwrapper::WrappedTreeList<NamedTree> wtl;
+    wtl.wrap(vt, "root", "child", nullptr);
+    wtl.setIndexKey("name");
+    EXPECT_EQ (wtl.find("a"), wtl[0]);
+
+    // WrappedPropertyと同じプロパティをキーにした場合も、書き込みに追従するはず
+    wtl[0]->name = "b";
+    EXPECT_EQ (wtl.find("a"), nullptr);
+    EXPECT_EQ (wtl.find("b"), wtl[0]);
+
+    // キーを持たなかった子に後からキーが設定された場合も索引に含まれるはず
+    vt.getChild(1).setProperty("name", "c", nullptr);
+    EXPECT_EQ (wtl.find("c"), wtl[1]);
+
+    // キーの削除で索引から外れるはず
+    vt.getChild(1).removeProperty("name", nullptr);
+    EXPECT_EQ (wtl.find("c"), nullptr);
+
+    // キーを変更した後は以前のキーの変更に追従しないはず
+    wtl.setIndexKey("id");
+    vt.getChild(0).setProperty("id", 5, nullptr);
+    EXPECT_EQ (wtl.find(5), wtl[0]);
+    wtl[0]->name = "d";
+    EXPECT_EQ (wtl.find("d"), nullptr);
+}
+
+TEST(wrapped_tree_list, lazy_wrapping)
+{
+    juce::ValueTree vt("root");
+    for (int i = 0; i < 5; ++i)
+        vt.appendChild(juce::ValueTree("child").setProperty("id", i, nullptr), nullptr);
+
+    vtwrapper::WrappedTreeList<CustomWrappedTree> wtl;
+    wtl.setLazyWrapping(true);
+    wtl.wrap(vt, "root", "child", nullptr);
+
+    // wrap()時点では子要素は作成されないはず
+    EXPECT_EQ (wtl.size(), 5);
+    EXPECT_EQ (wtl.getNumMaterialisedChildren(), 0);
+
+    // アクセスした要素のみ作成されるはず
+    auto* third = wtl[2];
+    ASSERT_NE (third, nullptr);
+    EXPECT_EQ (third->getValueTree(), vt.getChild(2));
+    EXPECT_EQ (wtl[2], third);
+    EXPECT_EQ (wtl.getNumMaterialisedChildren(), 1);
+
+    // 追加・削除・並び替えは未作成のまま反映されるはず
+    vt.appendChild(juce::ValueTree("child").setProperty("id", 5, nullptr), nullptr);
+    vt.removeChild(0, nullptr);
+    vt.moveChild(1, 0, nullptr);
+    EXPECT_EQ (wtl.size(), 5);
+    EXPECT_EQ (wtl.getNumMaterialisedChildren(), 1);
+    EXPECT_EQ (wtl[0], third);
+
+    // 索引による検索では未作成の要素も見つかるはず
+    wtl.setIndexKey("id");
+    EXPECT_EQ (wtl.find(5)->getValueTree(), vt.getChild(4));
+    EXPECT_EQ (wtl.getNumMaterialisedChildren(), 2);
+
+    // 走査では全ての要素が作成されるはず
+    int numChildren = 0;
+    for (auto* child : wtl)
+    {
+        EXPECT_EQ (child->getValueTree(), vt.getChild(numChildren));
+        ++numChildren;
+    }
+    EXPECT_EQ (numChildren, 5);
+    EXPECT_EQ (wtl.getNumMaterialisedChildren(), 5);
+}
+
+TEST(wrapped_tree_list, lazy_wrapping_remove_if)
+{
+    juce::ValueTree vt("root");
+    for (int i = 0; i < 6; ++i)
+        vt.appendChild(juce::ValueTree("child").setProperty("id", i, nullptr), nullptr);
+
+    vtwrapper::WrappedTreeList<CustomWrappedTree> wtl;
+    wtl.setLazyWrapping(true);
+    wtl.wrap(vt, "root", "child", nullptr);
+    wtl.setIndexKey("id");
+
+    // 削除の途中で作成される要素も、元の順のValueTreeに紐付くはず
+    juce::Array<int> visited;
+    const int numRemoved = wtl.removeIf([&visited](CustomWrappedTree* t)
+    {
+        const int id = t->getValueTree()["id"];
+        visited.add(id);
+        return id % 2 == 0;
+    });
+    EXPECT_EQ (numRemoved, 3);
+    EXPECT_EQ (visited, juce::Array<int>({ 0, 1, 2, 3, 4, 5 }));
+
+    ASSERT_EQ (wtl.size(), 3);
+    for (int i = 0; i < wtl.size(); ++i)
+        EXPECT_EQ (wtl[i]->getValueTree(), vt.getChild(i));
+
+    EXPECT_EQ (wtl.find(3)->getValueTree(), vt.getChild(1));
+    EXPECT_EQ (wtl.find(2), nullptr);
+}
+TEST(wrapped_tree_list, reuse_children_on_wrap)
+{
+    juce::ValueTree vt("root");
+    for (int i = 0; i < 3; ++i)
+        vt.appendChild(juce::ValueTree("child"), nullptr);
+
+    vtwrapper::WrappedTreeList<CustomWrappedTree> wtl;
+    wtl.setReuseChildrenOnWrap(true);
+    wtl.wrap(vt, "root", "child", nullptr);
+
+    juce::Array<CustomWrappedTree*> before;
+    for (auto* child : wtl)
+        before.add(child);
+
+    // 同じValueTreeを再wrapした場合は全ての要素が再利用されるはず
+    wtl.wrap(vt, "root", "child", nullptr);
+    EXPECT_EQ (wtl.size(), 3);
+    for (int i = 0; i < wtl.size(); ++i)
+        EXPECT_EQ (wtl[i], before[i]);
+}
+
+namespace
+{
+class CountedTree
+: public vtwrapper::WrappedTree
+{
+public:
+    CountedTree() { ++numInstances; }
+    ~CountedTree() override { --numInstances; }
+    void wrapPropertiesAndChildren() override {}
+
+    static inline int numInstances = 0;
+};
+
+//! 子の削除の反映を止められるリスト。再wrap時に子要素の数がValueTreeより多い状態を作る
+class SuspendableList
+: public vtwrapper::WrappedTreeList<CountedTree>
+{
+public:
+    bool suspended = false;
+
+protected:
+    void valueTreeChildRemoved(juce::ValueTree& parent, juce::ValueTree& child, int index) override
+    {
+        if (! suspended)
+            WrappedTreeList::valueTreeChildRemoved(parent, child, index);
+    }
+};
+}
+
+TEST(wrapped_tree_list, reuse_children_on_wrap_to_fewer_children)
+{
+    juce::ValueTree vt("root");
+    for (int i = 0; i < 3; ++i)
+        vt.appendChild(juce::ValueTree("child"), nullptr);
+
+    {
+        SuspendableList wtl;
+        wtl.setReuseChildrenOnWrap(true);
+        wtl.wrap(vt, "root", "child", nullptr);
+        EXPECT_EQ (CountedTree::numInstances, 3);
+
+        wtl.suspended = true;
+        vt.removeChild(2, nullptr);
+        wtl.suspended = false;
+
+        // 残りの要素が全て一致した場合も、余った末尾の要素は破棄されるはず
+        auto* first = wtl[0];
+        wtl.wrap(vt, "root", "child", nullptr);
+        EXPECT_EQ (wtl.size(), 2);
+        EXPECT_EQ (wtl[0], first);
+        EXPECT_EQ (CountedTree::numInstances, 2);
+    }
+    EXPECT_EQ (CountedTree::numInstances, 0);
+}
+
+TEST(wrapped_tree_list, reuse_moved_children_on_wrap)
+{
+    juce::ValueTree vt("root");
+    for (int i = 0; i < 3; ++i)
+        vt.appendChild(juce::ValueTree("child"), nullptr);
+
+    {
+        SuspendableList wtl;
+        wtl.setReuseChildrenOnWrap(true);
+        wtl.wrap(vt, "root", "child", nullptr);
+
+        wtl.suspended = true;
+        vt.removeChild(0, nullptr);
+        wtl.suspended = false;
+
+        // 位置がずれた要素もValueTreeの同一性で再利用され、親から外れた要素のみ破棄されるはず
+        auto* second = wtl[1];
+        auto* third = wtl[2];
+        wtl.wrap(vt, "root", "child", nullptr);
+        EXPECT_EQ (wtl.size(), 2);
+        EXPECT_EQ (wtl[0], second);
+        EXPECT_EQ (wtl[1], third);
+        EXPECT_EQ (CountedTree::numInstances, 2);
+
+        // 子が全て別のValueTreeに置き換えられた場合は、全て作り直されるはず
+        juce::ValueTree other("root");
+        for (int i = 0; i < 2; ++i)
+            other.appendChild(juce::ValueTree("child"), nullptr);
+
+        wtl.wrap(other, "root", "child", nullptr);
+        EXPECT_EQ (wtl.size(), 2);
+        EXPECT_EQ (wtl[0]->getValueTree(), other.getChild(0));
+        EXPECT_EQ (wtl[1]->getValueTree(), other.getChild(1));
+        EXPECT_EQ (CountedTree::numInstances, 2);
+    }
+    EXPECT_EQ (CountedTree::numInstances, 0);
+}
+
+TEST(wrapped_tree_list, reuse_children_by_key)
+{
+    juce::ValueTree vt("root");
+    for (int i = 0; i < 3; ++i)
+        vt.appendChild(juce::ValueTree("child").setProperty("id", i, nullptr), nullptr);
+
+    vtwrapper::WrappedTreeList<CustomWrappedTree> wtl;
+    wtl.setReuseChildrenOnWrap(true, "id");
+    wtl.wrap(vt, "root", "child", nullptr);
+
+    auto* first = wtl[0];
+    auto* last = wtl[2];
+
+    // プリセット読み込みなどで内容が複製された場合もキーで一致した要素は再利用され、新しいValueTreeに紐付くはず
+    // 並び替え・削除・追加があった場合も、一致しなかった子ValueTreeに対してのみ新たに作成されるはず
+    auto copied = vt.createCopy();
+    copied.removeChild(1, nullptr);
+    copied.moveChild(1, 0, nullptr);
+    copied.appendChild(juce::ValueTree("child").setProperty("id", 3, nullptr), nullptr);
+    wtl.wrap(copied, "root", "child", nullptr);
+
+    EXPECT_EQ (wtl.size(), 3);
+    EXPECT_EQ (wtl[0], last);
+    EXPECT_EQ (wtl[1], first);
+    EXPECT_NE (wtl[2], first);
+    EXPECT_NE (wtl[2], last);
+    for (int i = 0; i < wtl.size(); ++i)
+        EXPECT_TRUE (wtl[i]->getValueTree() == copied.getChild(i));
+}
+
+namespace
+{
+class ClipTree
+: public vtwrapper::WrappedTree
+{
+public:
+    void wrapPropertiesAndChildren() override
+    {
+        length.referTo(valueTree, "length", undoManager, 1.0f);
+    }
+
+    vtwrapper::WrappedProperty<float> length;
+};
+
+class TrackTree
+: public vtwrapper::WrappedTree
+{
+public:
+    void wrapPropertiesAndChildren() override
+    {
+        // 二度目のreferTo()で保留中のリスナー登録が取り消されるはず
+        gain.referTo(valueTree, "volume", undoManager, 0.0f);
+        gain.referTo(valueTree, "gain", undoManager, 0.0f);
+        clips.wrap(valueTree, "track", "clip", undoManager);
+    }
+
+    vtwrapper::WrappedProperty<float> gain;
+    vtwrapper::WrappedTreeList<ClipTree> clips;
+};
+}
+
+TEST(wrapped_tree_list, parallel_wrapping)
+{
+    constexpr int numTracks = 2000;
+
+    juce::ValueTree vt("root");
+    for (int i = 0; i < numTracks; ++i)
+    {
+        juce::ValueTree track("track");
+        track.setProperty("gain", (float)i, nullptr);
+        for (int c = 0; c < 3; ++c)
+            track.appendChild(juce::ValueTree("clip").setProperty("length", (float)c, nullptr), nullptr);
+        vt.appendChild(track, nullptr);
+    }
+
+    juce::ThreadPool pool(4);
+    vtwrapper::WrappedTreeList<TrackTree> wtl;
+    wtl.setParallelWrapping(&pool, 64);
+    wtl.wrap(vt, "root", "track", nullptr);
+
+    ASSERT_EQ (wtl.size(), numTracks);
+    for (int i = 0; i < numTracks; ++i)
+    {
+        EXPECT_TRUE (wtl[i]->getValueTree() == vt.getChild(i));
+        EXPECT_FLOAT_EQ (wtl[i]->gain.get(), (float)i);
+        EXPECT_EQ (wtl[i]->clips.size(), 3);
+    }
+
+    // 保留されたリスナー登録が行われ、変更が反映されるはず
+    vt.getChild(10).setProperty("gain", -1.0f, nullptr);
+    vt.getChild(10).setProperty("volume", -2.0f, nullptr);
+    EXPECT_FLOAT_EQ (wtl[10]->gain.get(), -1.0f);
+
+    vt.getChild(20).getChild(1).setProperty("length", 5.0f, nullptr);
+    vt.getChild(20).appendChild(juce::ValueTree("clip"), nullptr);
+    EXPECT_FLOAT_EQ (wtl[20]->clips[1]->length.get(), 5.0f);
+    EXPECT_EQ (wtl[20]->clips.size(), 4);
+
+    vt.removeChild(0, nullptr);
+    EXPECT_EQ (wtl.size(), numTracks - 1);
+
+    // 要素数が少ない場合は呼び出し元のスレッドのみで作成されるはず
+    juce::ValueTree small("root");
+    small.appendChild(juce::ValueTree("track").setProperty("gain", 2.0f, nullptr), nullptr);
+    wtl.wrap(small, "root", "track", nullptr);
+    EXPECT_EQ (wtl.size(), 1);
+    EXPECT_FLOAT_EQ (wtl[0]->gain.get(), 2.0f);
+}
@@ -152,4 +152,142 @@ TEST(wrapped_tree, invalid_copy)
     wt.copyPropertiesAndChildrenFrom(wt2);
     EXPECT_TRUE (wt.isValid());
     EXPECT_TRUE (wt.getTypeID() == juce::Identifier("root"));
-}
\ No newline at end of file
+}
+namespace
+{
+class TransactionTree
+: public vtwrapper::WrappedTree
+{
+public:
+    void wrapPropertiesAndChildren() override
+    {
+        a.referTo(valueTree, "a", undoManager, 0);
+        b.referTo(valueTree, "b", undoManager, 0);
+    }
+
+    vtwrapper::WrappedProperty<int> a, b;
+};
+}
+
+TEST(wrapped_tree, scoped_transaction)
+{
+    juce::UndoManager um;
+    juce::ValueTree vt("root");
+    TransactionTree wt;
+    wt.wrap(vt, "root", &um);
+
+    int numChangedA = 0, numChangedB = 0;
+    int bWhenANotified = -1;
+    wt.a.onChange = [&]() { ++numChangedA; bWhenANotified = vt["b"]; };
+    wt.b.onChange = [&]() { ++numChangedB; };
+
+    um.beginNewTransaction();
+    {
+        vtwrapper::WrappedTree::ScopedTransaction transaction(wt);
+        wt.a = 1;
+        wt.a = 2;
+        wt.a = 3;
+        wt.b = 20;
+
+        // スコープ中は書き込みおよび通知が保留されるが、値は取得できる
+        EXPECT_FALSE (vt.hasProperty("a"));
+        EXPECT_EQ (wt.a.get(), 3);
+        EXPECT_EQ (numChangedA, 0);
+        EXPECT_EQ (numChangedB, 0);
+    }
+    EXPECT_EQ ((int)vt["a"], 3);
+    EXPECT_EQ ((int)vt["b"], 20);
+    EXPECT_EQ (numChangedA, 1);
+    EXPECT_EQ (numChangedB, 1);
+    EXPECT_EQ (bWhenANotified, 20); // 通知時には全ての書き込みが反映済みのはず
+
+    // ひとつのUndoトランザクションとして記録されているはず
+    um.undo();
+    EXPECT_EQ (wt.a.get(), 0);
+    EXPECT_EQ (wt.b.get(), 0);
+    EXPECT_FALSE (um.canUndo());
+}
+
+TEST(wrapped_tree, scoped_transaction_without_change)
+{
+    juce::ValueTree vt("root");
+    TransactionTree wt;
+    wt.wrap(vt, "root", nullptr);
+
+    int numChanged = 0;
+    wt.a.onChange = [&]() { ++numChanged; };
+
+    // 元の値に戻った場合は通知されないはず
+    {
+        vtwrapper::WrappedTree::ScopedTransaction transaction(wt);
+        wt.a = 5;
+        wt.a = 0;
+    }
+    EXPECT_EQ (numChanged, 0);
+    EXPECT_FALSE (vt.hasProperty("a"));
+
+    // 入れ子の場合は最も外側のスコープ終了時に反映されるはず
+    {
+        vtwrapper::WrappedTree::ScopedTransaction outer(wt);
+        {
+            vtwrapper::WrappedTree::ScopedTransaction inner(wt);
+            wt.a = 7;
+        }
+        EXPECT_EQ (numChanged, 0);
+        vt.setProperty("b", 1, nullptr); // 直接の書き込みも通知が保留されるはず
+        EXPECT_EQ (wt.b.get(), 1);
+    }
+    EXPECT_EQ (numChanged, 1);
+    EXPECT_EQ ((int)vt["a"], 7);
+}
+
+TEST(wrapped_tree, wrap_deferred)
+{
+    juce::ValueTree vt("root");
+    vt.setProperty("a", 5, nullptr);
+
+    TransactionTree wt;
+    wt.wrapDeferred(vt, "root", nullptr);
+
+    // 紐付けは行われるが、プロパティはまだ紐付けられないはず
+    EXPECT_TRUE (wt.isValid());
+    EXPECT_FALSE (wt.isBound());
+    EXPECT_FALSE (wt.a.isValid());
+
+    wt.ensureWrapped();
+    EXPECT_TRUE (wt.isBound());
+    EXPECT_EQ (wt.a.get(), 5);
+
+    // 再度呼び出しても何も行わないはず
+    wt.a = 6;
+    wt.ensureWrapped();
+    EXPECT_EQ ((int)vt["a"], 6);
+}
+
+TEST(wrapped_tree, tree_loader)
+{
+    // "pending"を持つValueTreeを、読み込み時にプロパティを構築する遅延ノードとして扱う
+    vtwrapper::WrappedTree::setTreeLoader([](const juce::ValueTree& tree)
+    {
+        if (tree.hasProperty("pending"))
+        {
+            auto vt = tree;
+            vt.removeProperty("pending", nullptr);
+            vt.setProperty("a", 7, nullptr);
+        }
+    });
+
+    juce::ValueTree vt("root");
+    vt.setProperty("pending", true, nullptr);
+
+    // 紐付けの前に読み込まれるはず
+    TransactionTree wt;
+    wt.wrapDeferred(vt, "root", nullptr);
+    EXPECT_TRUE (vt.hasProperty("pending"));
+
+    wt.ensureWrapped();
+    EXPECT_FALSE (vt.hasProperty("pending"));
+    EXPECT_EQ (wt.a.get(), 7);
+
+    vtwrapper::WrappedTree::setTreeLoader(&vtwrapper::MappedSession::ensureLoaded);
+}
@@ -0,0 +1,129 @@
+/*
+  ==============================================================================
+
+    AsyncChangeQueue.cpp
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#include "AsyncChangeQueue.h"
+
+namespace vtwrapper
+{
+
+//==============================================================================
+AsyncChangeQueue::Client::~Client()
+{
+    if (queue != nullptr)
+        queue->remove(this);
+}
+
+//==============================================================================
+AsyncChangeQueue::~AsyncChangeQueue()
+{
+    while (head != nullptr)
+        remove(head);
+}
+
+AsyncChangeQueue& AsyncChangeQueue::getSharedInstance() // static
+{
+    static AsyncChangeQueue instance;
+    return instance;
+}
+
+void AsyncChangeQueue::enqueue(Client* client)
+{
+    jassert(client != nullptr);
+    if (client->queue == this) return;
+    
+    if (client->queue != nullptr)
+        client->queue->remove(client);
+    
+    client->queue = this;
+    client->generation = currentGeneration;
+    client->previous = tail;
+    client->next = nullptr;
+    
+    if (tail != nullptr)
+        tail->next = client;
+    else
+        head = client;
+    
+    tail = client;
+    ++numQueued;
+    
+    scheduleDelivery();
+}
+
+void AsyncChangeQueue::remove(Client* client) noexcept
+{
+    if (client == nullptr || client->queue != this) return;
+    
+    if (client->previous != nullptr)
+        client->previous->next = client->next;
+    else
+        head = client->next;
+    
+    if (client->next != nullptr)
+        client->next->previous = client->previous;
+    else
+        tail = client->previous;
+    
+    client->queue = nullptr;
+    client->previous = client->next = nullptr;
+    --numQueued;
+}
+
+void AsyncChangeQueue::flush()
+{
+    cancelPendingUpdate();
+    
+    // 配信中に登録されたClientは世代が異なるため、次の配信まで残す。
+    // 通知中に他のClientが削除・破棄される可能性があるため、先頭から一つずつ取り出す
+    const auto generationToDeliver = currentGeneration++;
+    
+    while (head != nullptr && head->generation == generationToDeliver)
+    {
+        auto* client = head;
+        remove(client);
+        client->handleQueuedChange();
+    }
+}
+
+void AsyncChangeQueue::setMaxRate(int hz)
+{
+    jassert(hz >= 0);
+    if (maxRateHz == hz) return;
+    
+    maxRateHz = hz;
+    cancelPendingUpdate();
+    stopTimer();
+    
+    if (head != nullptr)
+        scheduleDelivery();
+}
+
+//==============================================================================
+void AsyncChangeQueue::timerCallback()
+{
+    flush();
+    
+    if (head == nullptr)
+        stopTimer();
+}
+
+void AsyncChangeQueue::scheduleDelivery()
+{
+    if (maxRateHz > 0)
+    {
+        if (! isTimerRunning())
+            startTimerHz(maxRateHz);
+    }
+    else
+    {
+        triggerAsyncUpdate();
+    }
+}
+
+} // namespace vtwrapper
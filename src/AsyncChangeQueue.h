@@ -0,0 +1,86 @@
+/*
+  ==============================================================================
+
+    AsyncChangeQueue.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+
+namespace vtwrapper
+{
+
+//==============================================================================
+/**
+ @brief 変更通知をメッセージスレッドで非同期にまとめて配信するためのキュー
+ - 変更のあったClientをenqueue()で登録し、メッセージループの次の周回(もしくはsetMaxRate()で指定した頻度)でまとめて通知する。 @n
+ 同じClientは何度登録しても、一度の配信につき一度だけ通知される。
+ - Clientは自身にリンクを持つ侵入型リストとして保持するため、登録・削除はO(1)でメモリ確保を行わない。
+ - 配信中に登録されたClientは次の配信で通知される。
+ - Clientは破棄時に自動的にキューから削除される。
+ - WrappedProperty::setAsyncChangeNotification()から使用される。メッセージスレッドでの使用を想定している
+ */
+class AsyncChangeQueue
+: private juce::AsyncUpdater
+, private juce::Timer
+{
+public:
+    //! @brief キューから通知を受け取る側のインターフェース
+    class Client
+    {
+    public:
+        virtual ~Client();
+
+        //! 登録後の配信時に一度だけ呼ばれる
+        virtual void handleQueuedChange() = 0;
+
+        bool isQueued() const noexcept { return queue != nullptr; }
+
+    private:
+        friend class AsyncChangeQueue;
+        AsyncChangeQueue* queue = nullptr;
+        Client* previous = nullptr;
+        Client* next = nullptr;
+        juce::uint32 generation = 0;
+    };
+
+    //==============================================================================
+    AsyncChangeQueue() = default;
+    ~AsyncChangeQueue() override;
+
+    //! @brief 全てのWrappedPropertyで共有されるデフォルトのキュー
+    static AsyncChangeQueue& getSharedInstance();
+
+    //! @brief clientを次の配信の対象として登録する。登録済みの場合は何もしない
+    void enqueue(Client* client);
+
+    //! @brief clientを配信の対象から外す
+    void remove(Client* client) noexcept;
+
+    //! @brief 登録されているClientに今すぐ通知する。保存の直前など、配信を待たずに反映させたい場合に用いる
+    void flush();
+
+    //! @brief 配信の最大頻度を設定する。0の場合はメッセージループの周回ごとに配信する
+    void setMaxRate(int hz);
+    int getMaxRate() const noexcept { return maxRateHz; }
+
+    int getNumQueued() const noexcept { return numQueued; }
+
+private:
+    void handleAsyncUpdate() override { flush(); }
+    void timerCallback() override;
+    void scheduleDelivery();
+
+    Client* head = nullptr;
+    Client* tail = nullptr;
+    int numQueued = 0;
+    int maxRateHz = 0;
+    juce::uint32 currentGeneration = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(AsyncChangeQueue)
+};
+
+} // namespace vtwrapper
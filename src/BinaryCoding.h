@@ -0,0 +1,278 @@
+/*
+  ==============================================================================
+
+    BinaryCoding.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+#include <cstring>
+#include <vector>
+
+namespace vtwrapper
+{
+
+/*
+ BinaryTreeFormatおよびMappedSessionで共有する値の符号化。
+ - 整数は可変長(7bitごと, 下位から)で、符号付き整数はzigzag符号化した上で書き込む。
+ - 小数および固定長の整数はエンディアンに依存しないようリトルエンディアンで書き込む。
+ - プロパティの値は型ごとのタグと値を書き込む。配列などタグに無い型のみjuce::var::writeToStream()を用いる。
+ */
+
+//==============================================================================
+//! @brief 値を内部のバッファへ符号化するクラス
+class BinaryEncoder
+{
+public:
+    enum ValueTag : juce::uint8
+    {
+        voidTag = 0,
+        falseTag,
+        trueTag,
+        intTag,
+        int64Tag,
+        doubleTag,
+        stringTag,
+        binaryTag,
+        varTag // 上記以外の型。juce::var::writeToStream()で書き込む
+    };
+
+    static juce::uint64 zigzagEncode(juce::int64 v) noexcept { return ((juce::uint64)v << 1) ^ (juce::uint64)(v >> 63); }
+    static juce::int64 zigzagDecode(juce::uint64 v) noexcept { return (juce::int64)(v >> 1) ^ -(juce::int64)(v & 1); }
+
+    void writeValue(const juce::var& value)
+    {
+        if (value.isVoid())
+        {
+            writeByte(voidTag);
+        }
+        else if (value.isBool())
+        {
+            writeByte((bool)value ? trueTag : falseTag);
+        }
+        else if (value.isInt())
+        {
+            writeByte(intTag);
+            writeVarint(zigzagEncode((int)value));
+        }
+        else if (value.isInt64())
+        {
+            writeByte(int64Tag);
+            writeVarint(zigzagEncode((juce::int64)value));
+        }
+        else if (value.isDouble())
+        {
+            writeByte(doubleTag);
+            writeDouble((double)value);
+        }
+        else if (value.isString())
+        {
+            writeByte(stringTag);
+            writeString(value.toString());
+        }
+        else if (value.isBinaryData())
+        {
+            writeByte(binaryTag);
+            auto* block = value.getBinaryData();
+            writeVarint((juce::uint64)block->getSize());
+            writeBytes(block->getData(), block->getSize());
+        }
+        else
+        {
+            writeByte(varTag);
+            juce::MemoryOutputStream mo;
+            value.writeToStream(mo);
+            writeVarint((juce::uint64)mo.getDataSize());
+            writeBytes(mo.getData(), mo.getDataSize());
+        }
+    }
+
+    void writeString(const juce::String& s)
+    {
+        const auto numBytes = s.getNumBytesAsUTF8();
+        writeVarint((juce::uint64)numBytes);
+        writeBytes(s.toRawUTF8(), numBytes);
+    }
+
+    void writeDouble(double v)
+    {
+        juce::uint64 bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+
+        for (int i = 0; i < 8; ++i)
+            writeByte((juce::uint8)(bits >> (8 * i)));
+    }
+
+    void writeVarint(juce::uint64 v)
+    {
+        while (v >= 0x80)
+        {
+            writeByte((juce::uint8)(v | 0x80));
+            v >>= 7;
+        }
+        writeByte((juce::uint8)v);
+    }
+
+    //! @brief 4バイトの固定長で書き込む。後からsetUInt32()で書き換える場合に用いる
+    void writeUInt32(juce::uint32 v)
+    {
+        for (int i = 0; i < 4; ++i)
+            writeByte((juce::uint8)(v >> (8 * i)));
+    }
+
+    void setUInt32(size_t position, juce::uint32 v) noexcept
+    {
+        jassert(position + 4 <= buffer.size());
+        for (int i = 0; i < 4; ++i)
+            buffer[position + (size_t)i] = (juce::uint8)(v >> (8 * i));
+    }
+
+    void writeByte(juce::uint8 b) { buffer.push_back(b); }
+
+    void writeBytes(const void* data, size_t numBytes)
+    {
+        auto* bytes = static_cast<const juce::uint8*>(data);
+        buffer.insert(buffer.end(), bytes, bytes + numBytes);
+    }
+
+    size_t getSize() const noexcept { return buffer.size(); }
+    const juce::uint8* getData() const noexcept { return buffer.data(); }
+    void reserve(size_t numBytes) { buffer.reserve(numBytes); }
+    void clear() noexcept { buffer.clear(); }
+
+private:
+    std::vector<juce::uint8> buffer;
+};
+
+//==============================================================================
+//! @brief メモリ上のデータから値を復号するクラス
+//! @n 範囲外の読み込みや不正なデータを検出した場合はhasFailed()がtrueとなり、以降の読み込みは全て失敗する
+class BinaryDecoder
+{
+public:
+    //! @brief 入れ子のノードを読み込める最大の深さ(ルートが0)。破損・改竄されたデータの再帰的な読み込みによるスタックオーバーフローを防ぐ
+    //! @n 超えた場合は途中で途切れたデータと同様に読み込み失敗として扱う
+    static constexpr int maxTreeDepth = 1024;
+
+    BinaryDecoder(const void* sourceData, size_t sourceSize, size_t startPosition = 0) noexcept
+    : data(static_cast<const juce::uint8*>(sourceData)), size(sourceSize), position(startPosition)
+    {
+        if (position > size)
+            fail();
+    }
+
+    juce::var readValue()
+    {
+        switch (readByte())
+        {
+            case BinaryEncoder::voidTag:   return {};
+            case BinaryEncoder::falseTag:  return false;
+            case BinaryEncoder::trueTag:   return true;
+            case BinaryEncoder::intTag:    return (int)BinaryEncoder::zigzagDecode(readVarint());
+            case BinaryEncoder::int64Tag:  return (juce::int64)BinaryEncoder::zigzagDecode(readVarint());
+            case BinaryEncoder::doubleTag: return readDouble();
+            case BinaryEncoder::stringTag: return readString();
+            case BinaryEncoder::binaryTag:
+            {
+                const auto numBytes = readVarint();
+                auto* bytes = readBytes(numBytes);
+                return bytes != nullptr ? juce::var(juce::MemoryBlock(bytes, (size_t)numBytes)) : juce::var();
+            }
+            case BinaryEncoder::varTag:
+            {
+                const auto numBytes = readVarint();
+                auto* bytes = readBytes(numBytes);
+                if (bytes == nullptr) return {};
+                juce::MemoryInputStream mi(bytes, (size_t)numBytes, false);
+                return juce::var::readFromStream(mi);
+            }
+            default:
+                fail();
+                return {};
+        }
+    }
+
+    juce::String readString()
+    {
+        const auto numBytes = readVarint();
+        auto* bytes = readBytes(numBytes);
+        return bytes != nullptr ? juce::String::fromUTF8((const char*)bytes, (int)numBytes) : juce::String();
+    }
+
+    double readDouble()
+    {
+        auto* bytes = readBytes(8);
+        if (bytes == nullptr) return 0.0;
+
+        juce::uint64 bits = 0;
+        for (int i = 0; i < 8; ++i)
+            bits |= (juce::uint64)bytes[i] << (8 * i);
+
+        double v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    juce::uint64 readVarint()
+    {
+        juce::uint64 v = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            const auto b = readByte();
+            v |= (juce::uint64)(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) return v;
+        }
+        fail();
+        return 0;
+    }
+
+    juce::uint32 readUInt32()
+    {
+        auto* bytes = readBytes(4);
+        if (bytes == nullptr) return 0;
+
+        juce::uint32 v = 0;
+        for (int i = 0; i < 4; ++i)
+            v |= (juce::uint32)bytes[i] << (8 * i);
+        return v;
+    }
+
+    juce::uint8 readByte()
+    {
+        if (failed || position >= size)
+        {
+            fail();
+            return 0;
+        }
+        return data[position++];
+    }
+
+    //! @brief numBytes分読み進め、その先頭へのポインタを返す。範囲外の場合はnullptr
+    const juce::uint8* readBytes(juce::uint64 numBytes)
+    {
+        if (failed || numBytes > size - position)
+        {
+            fail();
+            return nullptr;
+        }
+        auto* bytes = data + position;
+        position += (size_t)numBytes;
+        return bytes;
+    }
+
+    size_t getPosition() const noexcept { return position; }
+    size_t getNumBytesRemaining() const noexcept { return position < size ? size - position : 0; }
+    bool hasFailed() const noexcept { return failed; }
+    void fail() noexcept { failed = true; }
+
+private:
+    const juce::uint8* data;
+    size_t size;
+    size_t position;
+    bool failed = false;
+};
+
+} // namespace vtwrapper
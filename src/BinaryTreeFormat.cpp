@@ -0,0 +1,236 @@
+/*
+  ==============================================================================
+
+    BinaryTreeFormat.cpp
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#include "BinaryTreeFormat.h"
+#include "BinaryCoding.h"
+#include "Hash.h"
+#include "MappedSession.h"
+
+namespace vtwrapper
+{
+
+namespace
+{
+const char formatMagic[] = { 'V', 'T', 'W', 'B' };
+}
+
+//==============================================================================
+class BinaryTreeFormat::Writer
+{
+public:
+    explicit Writer(juce::OutputStream& outputStream) : output(outputStream) { encoder.reserve(bufferSize + 1024); }
+
+    bool write(const juce::ValueTree& tree)
+    {
+        // プレースホルダを通常のノードとして書き込まないよう、先に部分木全体を読み込む
+        MappedSession::ensureLoadedRecursively(tree);
+        collectIdentifiers(tree);
+
+        encoder.writeBytes(formatMagic, sizeof(formatMagic));
+        encoder.writeByte((juce::uint8)formatVersion);
+
+        encoder.writeVarint((juce::uint64)identifiers.size());
+        for (auto& id : identifiers)
+            encoder.writeString(id.toString());
+
+        writeNode(tree);
+        return flush();
+    }
+
+private:
+    void collectIdentifiers(const juce::ValueTree& tree)
+    {
+        addIdentifier(tree.getType());
+
+        for (int i = 0; i < tree.getNumProperties(); ++i)
+            addIdentifier(tree.getPropertyName(i));
+
+        for (const auto& child : tree)
+            collectIdentifiers(child);
+    }
+
+    void addIdentifier(const juce::Identifier& id)
+    {
+        if (indices.emplace(id, identifiers.size()).second)
+            identifiers.add(id);
+    }
+
+    void writeNode(const juce::ValueTree& tree)
+    {
+        writeIdentifier(tree.getType());
+
+        const int numProperties = tree.getNumProperties();
+        encoder.writeVarint((juce::uint64)numProperties);
+        for (int i = 0; i < numProperties; ++i)
+        {
+            const auto name = tree.getPropertyName(i);
+            writeIdentifier(name);
+            encoder.writeValue(tree[name]);
+            flushIfNeeded();
+        }
+
+        encoder.writeVarint((juce::uint64)tree.getNumChildren());
+        for (const auto& child : tree)
+            writeNode(child);
+    }
+
+    void writeIdentifier(const juce::Identifier& id)
+    {
+        auto it = indices.find(id);
+        jassert(it != indices.end());
+        encoder.writeVarint((juce::uint64)it->second);
+    }
+
+    //! 細かな書き込みによるOutputStreamの呼び出しを避けるため、バッファが一定量を超えた時のみ書き出す
+    void flushIfNeeded()
+    {
+        if (encoder.getSize() >= bufferSize)
+            flush();
+    }
+
+    bool flush()
+    {
+        if (encoder.getSize() > 0)
+        {
+            ok = output.write(encoder.getData(), encoder.getSize()) && ok;
+            encoder.clear();
+        }
+        return ok;
+    }
+
+    static constexpr size_t bufferSize = 32768;
+
+    juce::OutputStream& output;
+    BinaryEncoder encoder;
+    std::unordered_map<juce::Identifier, size_t, IdentifierHash> indices;
+    juce::Array<juce::Identifier> identifiers;
+    bool ok = true;
+};
+
+//==============================================================================
+class BinaryTreeFormat::Reader
+{
+public:
+    Reader(const void* sourceData, size_t sourceSize) : data(static_cast<const juce::uint8*>(sourceData)), size(sourceSize), decoder(sourceData, sourceSize) {}
+
+    juce::ValueTree read()
+    {
+        if (size < sizeof(formatMagic) + 1 || std::memcmp(data, formatMagic, sizeof(formatMagic)) != 0)
+            return {};
+        decoder.readBytes(sizeof(formatMagic));
+
+        // 新しいバージョンのデータは読み込まない
+        if (decoder.readByte() > formatVersion)
+            return {};
+
+        const auto numIdentifiers = decoder.readVarint();
+        if (decoder.hasFailed() || numIdentifiers > size) return {};
+
+        identifiers.ensureStorageAllocated((int)numIdentifiers);
+        for (juce::uint64 i = 0; i < numIdentifiers && ! decoder.hasFailed(); ++i)
+        {
+            auto name = decoder.readString();
+            if (name.isEmpty())
+            {
+                decoder.fail();
+                break;
+            }
+            identifiers.add(juce::Identifier(name));
+        }
+
+        auto tree = readNode(0);
+        return decoder.hasFailed() ? juce::ValueTree() : tree;
+    }
+
+    size_t getPosition() const noexcept { return decoder.getPosition(); }
+
+private:
+    juce::ValueTree readNode(int depth)
+    {
+        if (depth > BinaryDecoder::maxTreeDepth)
+        {
+            decoder.fail();
+            return {};
+        }
+
+        const auto type = readIdentifier();
+        if (decoder.hasFailed()) return {};
+
+        juce::ValueTree tree(type);
+
+        const auto numProperties = decoder.readVarint();
+        for (juce::uint64 i = 0; i < numProperties && ! decoder.hasFailed(); ++i)
+        {
+            const auto name = readIdentifier();
+            auto value = decoder.readValue();
+            if (! decoder.hasFailed())
+                tree.setProperty(name, std::move(value), nullptr);
+        }
+
+        const auto numChildren = decoder.readVarint();
+        for (juce::uint64 i = 0; i < numChildren && ! decoder.hasFailed(); ++i)
+        {
+            auto child = readNode(depth + 1);
+            if (! decoder.hasFailed())
+                tree.appendChild(child, nullptr);
+        }
+        return tree;
+    }
+
+    juce::Identifier readIdentifier()
+    {
+        const auto index = decoder.readVarint();
+        if (decoder.hasFailed() || index >= (juce::uint64)identifiers.size())
+        {
+            decoder.fail();
+            return {};
+        }
+        return identifiers.getReference((int)index);
+    }
+
+    const juce::uint8* data;
+    size_t size;
+    BinaryDecoder decoder;
+    juce::Array<juce::Identifier> identifiers;
+};
+
+//==============================================================================
+bool BinaryTreeFormat::writeToStream(const juce::ValueTree& tree, juce::OutputStream& output)
+{
+    if (! tree.isValid())
+    {
+        jassertfalse;
+        return false;
+    }
+    return Writer(output).write(tree);
+}
+
+juce::ValueTree BinaryTreeFormat::readFromStream(juce::InputStream& input)
+{
+    const auto startPosition = input.getPosition();
+
+    juce::MemoryBlock block;
+    input.readIntoMemoryBlock(block);
+
+    Reader reader(block.getData(), block.getSize());
+    auto tree = reader.read();
+
+    // 後続のデータを読めるよう、読み込んだデータの末尾に位置を戻す
+    if (tree.isValid())
+        input.setPosition(startPosition + (juce::int64)reader.getPosition());
+
+    return tree;
+}
+
+juce::ValueTree BinaryTreeFormat::readFromData(const void* data, size_t numBytes)
+{
+    return Reader(data, numBytes).read();
+}
+
+} // namespace vtwrapper
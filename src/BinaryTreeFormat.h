@@ -0,0 +1,56 @@
+/*
+  ==============================================================================
+
+    BinaryTreeFormat.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+#include "WrappedTree.h"
+
+namespace vtwrapper
+{
+
+//==============================================================================
+/**
+ @brief juce::ValueTreeおよびWrappedTreeをコンパクトなバイナリ形式で読み書きするクラス
+ - juce::ValueTree::writeToStream()では全てのノードでTypeおよびプロパティ名を文字列として書き込むが、 @n
+ この形式では出現するIdentifierを先頭のテーブルに一度だけ書き込み、各ノードではそのインデックスのみを書き込む。
+ - 値はjuce::var::writeToStream()を介さず、型ごとのタグと値を直接書き込む。整数は可変長で書き込む。 @n
+ 配列などそれ以外の型の値のみjuce::var::writeToStream()を用いる。
+ - 書き込みは内部のバッファにまとめてからOutputStreamに渡すため、細かな書き込みによる呼び出しコストがかからない。
+ - MappedSessionの読み込まれていないノードは、書き込みの前に読み込まれる。
+ - 読み込みに失敗した場合は無効なjuce::ValueTreeを返す。ルートからの深さがBinaryDecoder::maxTreeDepthを超えるデータも読み込みに失敗する。
+
+ [形式]
+ - ヘッダ: "VTWB"およびバージョン(1バイト)
+ - Identifierテーブル: 要素数, 各Identifierの(バイト数, UTF-8文字列)
+ - ノード: TypeのIdentifierインデックス, プロパティ数, 各プロパティの(Identifierインデックス, 型タグ, 値), 子の数, 各子ノード
+ */
+class BinaryTreeFormat
+{
+public:
+    //! @brief ValueTreeをバイナリ形式で書き込む
+    static bool writeToStream(const juce::ValueTree& tree, juce::OutputStream& output);
+    static bool writeToStream(const WrappedTree& tree, juce::OutputStream& output) { return writeToStream(tree.getValueTree(), output); }
+
+    //! @brief writeToStream()で書き込んだデータを読み込む。読み込みに失敗した場合は無効なValueTreeを返す
+    //! @n 位置を変更可能なストリームの場合、読み込み後の位置は書き込んだデータの末尾となる
+    static juce::ValueTree readFromStream(juce::InputStream& input);
+
+    //! @brief メモリ上のデータから読み込む。読み込みに失敗した場合は無効なValueTreeを返す
+    static juce::ValueTree readFromData(const void* data, size_t numBytes);
+
+    static constexpr int formatVersion = 1;
+
+private:
+    class Writer;
+    class Reader;
+
+    BinaryTreeFormat() = delete;
+};
+
+} // namespace vtwrapper
@@ -0,0 +1,93 @@
+/*
+  ==============================================================================
+
+    Constrainer.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+
+namespace vtwrapper
+{
+
+/*
+ WrappedPropertyのConstrainerテンプレート引数には以下を満たす型を指定する。
+ - void operator()(Type& newValue, bool isDefault) const ... 値を制限する。isDefaultはデフォルト値に対する呼び出しかどうか
+ - explicit operator bool() const ... 制限処理が有効かどうか。falseの場合はoperator()は呼ばれない
+
+ std::functionを介さないため、静的な制限処理はインライン展開される。
+ */
+
+//==============================================================================
+//! @brief 実行時に任意の関数を設定可能なConstrainer。WrappedPropertyのデフォルト
+template <typename Type>
+class DynamicConstrainer
+{
+public:
+    using FunctionType = std::function<void(Type& newValue, bool isDefault)>;
+
+    DynamicConstrainer() = default;
+
+    template <typename FunctionObject,
+              typename = std::enable_if_t<! std::is_same<std::decay_t<FunctionObject>, DynamicConstrainer>::value>>
+    DynamicConstrainer(FunctionObject&& f) : function(std::forward<FunctionObject>(f)) {}
+
+    void operator()(Type& newValue, bool isDefault) const { function(newValue, isDefault); }
+    explicit operator bool() const noexcept { return (bool)function; }
+
+private:
+    FunctionType function;
+};
+
+//==============================================================================
+//! @brief 値を制限しないConstrainer。WrappedPropertyのサイズが最小となる
+template <typename Type>
+struct NoConstrainer
+{
+    void operator()(Type&, bool) const noexcept {}
+    constexpr explicit operator bool() const noexcept { return false; }
+};
+
+//==============================================================================
+//! @brief 最小最大値の範囲に制限するConstrainer
+//! @n juce::Range<>::clipValue()とは異なり最大値も範囲に含む
+template <typename Type>
+class RangeConstrainer
+{
+public:
+    RangeConstrainer() = default;
+    RangeConstrainer(Type minValue, Type maxValue) : start(minValue), end(maxValue), isEnabled(true) { jassert(start <= end); }
+
+    void operator()(Type& newValue, bool) const noexcept { newValue = juce::jlimit(start, end, newValue); }
+    explicit operator bool() const noexcept { return isEnabled; }
+
+    Type getStart() const noexcept { return start; }
+    Type getEnd() const noexcept { return end; }
+
+private:
+    Type start {};
+    Type end {};
+    bool isEnabled = false;
+};
+
+//==============================================================================
+//! @brief juce::Stringの文字数を制限するConstrainer
+class MaxLengthConstrainer
+{
+public:
+    MaxLengthConstrainer() = default;
+    explicit MaxLengthConstrainer(int maxNumChars) : maxLength(maxNumChars) { jassert(maxLength >= 0); }
+
+    void operator()(juce::String& newValue, bool) const { if (newValue.length() > maxLength) newValue = newValue.substring(0, maxLength); }
+    explicit operator bool() const noexcept { return maxLength >= 0; }
+
+    int getMaxLength() const noexcept { return maxLength; }
+
+private:
+    int maxLength = -1;
+};
+
+} // namespace vtwrapper
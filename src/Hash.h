@@ -0,0 +1,35 @@
+/*
+  ==============================================================================
+
+    Hash.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+
+namespace vtwrapper
+{
+
+//! @brief std::unordered_map等でjuce::Identifierをキーにするためのハッシュ関数オブジェクト
+//! juce::Identifierはプールされた文字列のポインタで同一性を比較するため、そのアドレスをハッシュ値として用いる
+struct IdentifierHash
+{
+    size_t operator()(const juce::Identifier& id) const noexcept
+    {
+        return std::hash<const void*>()(id.getCharPointer().getAddress());
+    }
+};
+
+//! @brief std::unordered_map等でjuce::Stringをキーにするためのハッシュ関数オブジェクト
+struct StringHash
+{
+    size_t operator()(const juce::String& s) const noexcept
+    {
+        return s.hash();
+    }
+};
+
+} // namespace vtwrapper
@@ -0,0 +1,258 @@
+/*
+  ==============================================================================
+
+    Instrumentation.cpp
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#include "Instrumentation.h"
+#include "Hash.h"
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
+namespace vtwrapper
+{
+
+//==============================================================================
+namespace
+{
+//! トレースイベントのtidとして用いる、スレッドごとの連番
+int getThreadIndex()
+{
+    static std::atomic<int> numThreads { 0 };
+    thread_local const int index = ++numThreads;
+    return index;
+}
+
+double ticksToSeconds(juce::int64 ticks)
+{
+    return (double)ticks / (double)juce::Time::getHighResolutionTicksPerSecond();
+}
+
+juce::String escapeJson(const juce::String& s)
+{
+    return s.replace("\\", "\\\\").replace("\"", "\\\"");
+}
+}
+
+//==============================================================================
+struct Instrumentation::State
+{
+    struct CounterKey
+    {
+        Instrumentation::Event event;
+        const char* source;
+        juce::Identifier typeId;
+        juce::Identifier propertyId;
+
+        bool operator==(const CounterKey& other) const noexcept
+        {
+            return event == other.event && source == other.source && typeId == other.typeId && propertyId == other.propertyId;
+        }
+    };
+
+    struct CounterKeyHash
+    {
+        size_t operator()(const CounterKey& key) const noexcept
+        {
+            IdentifierHash hash;
+            size_t h = std::hash<const void*>()(key.source) ^ (size_t)key.event;
+            h = h * 31 + hash(key.typeId);
+            return h * 31 + hash(key.propertyId);
+        }
+    };
+
+    struct CounterValue
+    {
+        juce::int64 count = 0;
+        juce::int64 totalTicks = 0;
+        juce::int64 maxTicks = 0;
+    };
+
+    struct TraceEvent
+    {
+        CounterKey key;
+        juce::int64 startTicks, endTicks;
+        int threadIndex;
+    };
+
+    std::atomic<bool> enabled { true };
+    std::atomic<bool> traceEnabled { false };
+
+    juce::SpinLock lock;
+    std::unordered_map<CounterKey, CounterValue, CounterKeyHash> counters;
+    std::vector<TraceEvent> traceEvents;
+    size_t maxNumTraceEvents = 0;
+    juce::int64 originTicks = juce::Time::getHighResolutionTicks();
+};
+
+Instrumentation::State& Instrumentation::getState()
+{
+    static State state;
+    return state;
+}
+
+//==============================================================================
+const char* Instrumentation::getEventName(Event event) noexcept
+{
+    switch (event)
+    {
+        case Event::propertyChanged: return "propertyChanged";
+        case Event::childAdded:      return "childAdded";
+        case Event::childRemoved:    return "childRemoved";
+        case Event::parentChanged:   return "parentChanged";
+        case Event::wrap:            return "wrap";
+        case Event::allocation:      return "allocation";
+    }
+    return "";
+}
+
+void Instrumentation::setEnabled(bool shouldBeEnabled) noexcept
+{
+    getState().enabled = shouldBeEnabled;
+}
+
+bool Instrumentation::isEnabled() noexcept
+{
+    return VTWRAPPER_ENABLE_INSTRUMENTATION && getState().enabled;
+}
+
+void Instrumentation::setTraceEnabled(bool shouldBeEnabled, int maxNumEvents)
+{
+    auto& state = getState();
+    const juce::SpinLock::ScopedLockType sl(state.lock);
+
+    state.maxNumTraceEvents = (size_t)juce::jmax(0, maxNumEvents);
+    state.traceEnabled = shouldBeEnabled;
+}
+
+bool Instrumentation::isTraceEnabled() noexcept
+{
+    return getState().traceEnabled;
+}
+
+void Instrumentation::reset()
+{
+    auto& state = getState();
+    const juce::SpinLock::ScopedLockType sl(state.lock);
+
+    state.counters.clear();
+    state.traceEvents.clear();
+    state.originTicks = juce::Time::getHighResolutionTicks();
+}
+
+juce::Array<Instrumentation::Counter> Instrumentation::getCounters()
+{
+    juce::Array<Counter> result;
+    {
+        auto& state = getState();
+        const juce::SpinLock::ScopedLockType sl(state.lock);
+
+        result.ensureStorageAllocated((int)state.counters.size());
+        for (const auto& c : state.counters)
+            result.add({ c.first.event, c.first.source, c.first.typeId, c.first.propertyId,
+                         c.second.count, ticksToSeconds(c.second.totalTicks), ticksToSeconds(c.second.maxTicks) });
+    }
+
+    std::sort(result.begin(), result.end(), [](const Counter& a, const Counter& b)
+    {
+        return a.count != b.count ? a.count > b.count : a.totalSeconds > b.totalSeconds;
+    });
+    return result;
+}
+
+juce::String Instrumentation::createReport(int maxNumRows)
+{
+    if (! VTWRAPPER_ENABLE_INSTRUMENTATION)
+        return "vtwrapper instrumentation is disabled (VTWRAPPER_ENABLE_INSTRUMENTATION=0)\n";
+
+    const auto counters = getCounters();
+
+    juce::int64 totalCount = 0;
+    for (const auto& c : counters)
+        totalCount += c.count;
+
+    juce::String report;
+    report << juce::String("event").paddedRight(' ', 16) << juce::String("source").paddedRight(' ', 20)
+           << juce::String("type").paddedRight(' ', 16) << juce::String("property").paddedRight(' ', 16)
+           << juce::String("count").paddedLeft(' ', 10) << juce::String("cum%").paddedLeft(' ', 8)
+           << juce::String("total ms").paddedLeft(' ', 12) << juce::String("max us").paddedLeft(' ', 10) << "\n";
+
+    juce::int64 cumulativeCount = 0;
+    const int numRows = maxNumRows > 0 ? juce::jmin(maxNumRows, counters.size()) : counters.size();
+    for (int i = 0; i < numRows; ++i)
+    {
+        const auto& c = counters.getReference(i);
+        cumulativeCount += c.count;
+
+        report << juce::String(getEventName(c.event)).paddedRight(' ', 16) << juce::String(c.source).paddedRight(' ', 20)
+               << c.typeId.toString().paddedRight(' ', 16) << c.propertyId.toString().paddedRight(' ', 16)
+               << juce::String(c.count).paddedLeft(' ', 10)
+               << juce::String(100.0 * (double)cumulativeCount / (double)totalCount, 1).paddedLeft(' ', 8)
+               << juce::String(c.totalSeconds * 1.0e3, 3).paddedLeft(' ', 12)
+               << juce::String(c.maxSeconds * 1.0e6, 1).paddedLeft(' ', 10) << "\n";
+    }
+    return report;
+}
+
+juce::String Instrumentation::createTraceJson()
+{
+    auto& state = getState();
+    const juce::SpinLock::ScopedLockType sl(state.lock);
+
+    juce::MemoryOutputStream out;
+    out << "{\"traceEvents\":[";
+
+    for (size_t i = 0; i < state.traceEvents.size(); ++i)
+    {
+        const auto& e = state.traceEvents[i];
+        if (i > 0) out << ",";
+
+        out << "\n{\"name\":\"" << escapeJson(e.key.source) << " " << getEventName(e.key.event)
+            << "\",\"cat\":\"vtwrapper\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.threadIndex
+            << ",\"ts\":" << ticksToSeconds(e.startTicks - state.originTicks) * 1.0e6
+            << ",\"dur\":" << ticksToSeconds(e.endTicks - e.startTicks) * 1.0e6
+            << ",\"args\":{\"type\":\"" << escapeJson(e.key.typeId.toString())
+            << "\",\"property\":\"" << escapeJson(e.key.propertyId.toString()) << "\"}}";
+    }
+
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return out.toString();
+}
+
+//==============================================================================
+Instrumentation::ScopedMeasurement::ScopedMeasurement(Event e, const char* s, const juce::Identifier& type, const juce::Identifier& property) noexcept
+: event(e), source(s), typeId(type), propertyId(property)
+{
+    if (getState().enabled.load(std::memory_order_relaxed))
+        startTicks = juce::Time::getHighResolutionTicks();
+}
+
+Instrumentation::ScopedMeasurement::~ScopedMeasurement()
+{
+    if (startTicks != 0)
+        record(event, source, typeId, propertyId, startTicks, juce::Time::getHighResolutionTicks());
+}
+
+void Instrumentation::record(Event event, const char* source, const juce::Identifier& typeId, const juce::Identifier& propertyId, juce::int64 startTicks, juce::int64 endTicks)
+{
+    auto& state = getState();
+    const auto elapsed = endTicks - startTicks;
+    State::CounterKey key { event, source, typeId, propertyId };
+
+    const juce::SpinLock::ScopedLockType sl(state.lock);
+
+    auto& value = state.counters[key];
+    ++value.count;
+    value.totalTicks += elapsed;
+    value.maxTicks = juce::jmax(value.maxTicks, elapsed);
+
+    if (state.traceEnabled.load(std::memory_order_relaxed) && state.traceEvents.size() < state.maxNumTraceEvents)
+        state.traceEvents.push_back({ std::move(key), startTicks, endTicks, getThreadIndex() });
+}
+
+} // namespace vtwrapper
@@ -0,0 +1,118 @@
+/*
+  ==============================================================================
+
+    Instrumentation.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+
+#ifndef VTWRAPPER_ENABLE_INSTRUMENTATION
+ #define VTWRAPPER_ENABLE_INSTRUMENTATION 0
+#endif
+
+namespace vtwrapper
+{
+
+//==============================================================================
+/**
+ @brief ラッパーのリスナーコールバック、wrap()、オブジェクトの確保の回数と時間を計測するクラス
+ - VTWRAPPER_ENABLE_INSTRUMENTATIONが1の場合のみ各ラッパーから計測される。0の場合は計測用のマクロは何も展開されない。
+ - 計測は イベントの種類・計測箇所(WrappedPropertyなど)・ValueTreeのType・プロパティ の組ごとに集計される。 @n
+ ValueTreeの通知は親方向へ伝わるため、リスナーのコールバックは対象外の変更で呼ばれたものも含めて計測する。 @n
+ (例えばルートを監視するWrappedTreeListには全ての子孫のプロパティ変更が通知される)
+ - 時間は入れ子になった処理を含む。(wrap()の時間には子要素のwrap()や確保の時間も含まれる)
+ - setTraceEnabled(true)の間は個々の計測をトレースイベントとして記録し、createTraceJson()で @n
+ Chrome Trace Event Format(chrome://tracing、Perfettoで表示可能)として書き出せる。
+ - 計測・集計はスレッドセーフである。(WrappedTreeList::setParallelWrapping()ではワーカースレッドでwrap()が行われる)
+
+ @code
+ vtwrapper::Instrumentation::reset();
+ // ... 操作 ...
+ DBG(vtwrapper::Instrumentation::createReport(10)); // 回数の多い順に10件
+ @endcode
+ */
+class Instrumentation
+{
+public:
+    enum class Event
+    {
+        propertyChanged,
+        childAdded,
+        childRemoved,
+        parentChanged,
+        wrap,
+        allocation
+    };
+    static const char* getEventName(Event event) noexcept;
+
+    //! @brief 集計結果
+    struct Counter
+    {
+        Event event;
+        const char* source;
+        juce::Identifier typeId;
+        juce::Identifier propertyId;
+        juce::int64 count;
+        double totalSeconds;
+        double maxSeconds;
+    };
+
+    //==============================================================================
+    //! @brief 実行時に計測を止める。コンパイル時に無効な場合は常に計測されない
+    static void setEnabled(bool shouldBeEnabled) noexcept;
+    static bool isEnabled() noexcept;
+
+    //! @brief 個々の計測をトレースイベントとして記録するかどうか。maxNumEventsを超えた分は記録しない
+    static void setTraceEnabled(bool shouldBeEnabled, int maxNumEvents = 100000);
+    static bool isTraceEnabled() noexcept;
+
+    //! @brief 集計とトレースイベントを破棄する
+    static void reset();
+
+    //! @brief 集計結果を回数の多い順に返す
+    static juce::Array<Counter> getCounters();
+
+    //! @brief 集計結果を回数の多い順に表形式で返す。累積の割合から、通知の大半を占めるプロパティを見つけられる
+    //! @param maxNumRows 0の場合は全て
+    static juce::String createReport(int maxNumRows = 0);
+
+    //! @brief 記録したトレースイベントをChrome Trace Event FormatのJSONとして返す
+    static juce::String createTraceJson();
+
+    //==============================================================================
+    //! @brief スコープの間の時間を計測する。sourceは文字列リテラルなどプログラムの終了まで有効なもの
+    class ScopedMeasurement
+    {
+    public:
+        ScopedMeasurement(Event event, const char* source, const juce::Identifier& typeId, const juce::Identifier& propertyId = {}) noexcept;
+        ~ScopedMeasurement();
+
+    private:
+        Event event;
+        const char* source;
+        juce::Identifier typeId, propertyId;
+        juce::int64 startTicks = 0;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedMeasurement)
+    };
+
+private:
+    struct State;
+    static State& getState();
+    static void record(Event event, const char* source, const juce::Identifier& typeId, const juce::Identifier& propertyId, juce::int64 startTicks, juce::int64 endTicks);
+};
+
+} // namespace vtwrapper
+
+//==============================================================================
+//! @brief スコープの間をInstrumentationで計測する。VTWRAPPER_ENABLE_INSTRUMENTATIONが0の場合は引数も評価されない
+#if VTWRAPPER_ENABLE_INSTRUMENTATION
+ #define VTWRAPPER_INSTRUMENT_SCOPE(event, source, typeId, propertyId) \
+    const vtwrapper::Instrumentation::ScopedMeasurement JUCE_JOIN_MACRO(vtwrapperMeasurement_, __LINE__) (vtwrapper::Instrumentation::Event::event, source, typeId, propertyId)
+#else
+ #define VTWRAPPER_INSTRUMENT_SCOPE(event, source, typeId, propertyId)
+#endif
@@ -0,0 +1,62 @@
+/*
+  ==============================================================================
+
+    ListenerRegistrar.cpp
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#include "ListenerRegistrar.h"
+
+namespace vtwrapper
+{
+
+thread_local ListenerRegistrar::Registrations* ListenerRegistrar::deferredRegistrations = nullptr;
+
+//==============================================================================
+ListenerRegistrar::ScopedDeferral::ScopedDeferral(Registrations& target)
+: previous(deferredRegistrations)
+{
+    deferredRegistrations = &target;
+}
+
+ListenerRegistrar::ScopedDeferral::~ScopedDeferral()
+{
+    deferredRegistrations = previous;
+}
+
+//==============================================================================
+void ListenerRegistrar::add(juce::ValueTree& tree, juce::ValueTree::Listener* listener)
+{
+    if (deferredRegistrations != nullptr)
+        deferredRegistrations->add({ &tree, listener });
+    else
+        tree.addListener(listener);
+}
+
+void ListenerRegistrar::remove(juce::ValueTree& tree, juce::ValueTree::Listener* listener)
+{
+    if (deferredRegistrations != nullptr)
+    {
+        // 直前に保留したものほど取り消されやすいため後ろから探す
+        for (int i = deferredRegistrations->size(); --i >= 0;)
+        {
+            const auto& r = deferredRegistrations->getReference(i);
+            if (r.tree == &tree && r.listener == listener)
+            {
+                deferredRegistrations->remove(i);
+                return;
+            }
+        }
+    }
+    tree.removeListener(listener);
+}
+
+void ListenerRegistrar::addAll(const Registrations& registrations)
+{
+    for (const auto& r : registrations)
+        r.tree->addListener(r.listener);
+}
+
+} // namespace vtwrapper
@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    ListenerRegistrar.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+
+namespace vtwrapper
+{
+
+//==============================================================================
+/**
+ @brief juce::ValueTree::Listenerの登録を、必要に応じて保留するためのクラス
+ - WrappedTreeList::setParallelWrapping()ではワーカースレッドで子要素のwrap()を行うため、 @n
+ その間にWrappedProperty、PropertyDispatcherなどが行うリスナー登録をスレッドごとに保留し、最後にメッセージスレッドでまとめて登録する。
+ - ScopedDeferralが無いスレッドではadd()、remove()は直ちにjuce::ValueTreeへの登録・解除を行う。
+ - 登録はValueTreeのインスタンスに対して行われるため、保留中のtreeは登録が行われるまで破棄されてはならない。 @n
+ 破棄される前にremove()を呼び出せば保留は取り消される。
+ */
+class ListenerRegistrar
+{
+public:
+    //! @brief 保留したリスナー登録
+    struct Registration
+    {
+        juce::ValueTree* tree;
+        juce::ValueTree::Listener* listener;
+    };
+    using Registrations = juce::Array<Registration>;
+
+    //==============================================================================
+    //! @brief スコープの間、現在のスレッドでのadd()をtargetに保留する
+    class ScopedDeferral
+    {
+    public:
+        explicit ScopedDeferral(Registrations& target);
+        ~ScopedDeferral();
+
+    private:
+        Registrations* previous;
+        JUCE_DECLARE_NON_COPYABLE(ScopedDeferral)
+    };
+
+    //==============================================================================
+    static void add(juce::ValueTree& tree, juce::ValueTree::Listener* listener);
+    static void remove(juce::ValueTree& tree, juce::ValueTree::Listener* listener);
+
+    //! @brief 保留した登録を全て行う
+    static void addAll(const Registrations& registrations);
+
+private:
+    static thread_local Registrations* deferredRegistrations;
+};
+
+} // namespace vtwrapper
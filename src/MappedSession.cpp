@@ -0,0 +1,582 @@
+/*
+  ==============================================================================
+
+    MappedSession.cpp
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#include "MappedSession.h"
+#include <limits>
+#include "BinaryCoding.h"
+#include "Hash.h"
+#include "WrappedTree.h"
+
+namespace vtwrapper
+{
+
+namespace
+{
+const char sessionMagic[] = { 'V', 'T', 'W', 'S' };
+constexpr size_t nodeSizeBytes = 4;
+
+//! プレースホルダの読み込み中に発生するValueTreeの変更は、変更として扱わない
+thread_local int loadingDepth = 0;
+
+struct ScopedLoading
+{
+    ScopedLoading() noexcept { ++loadingDepth; }
+    ~ScopedLoading() noexcept { --loadingDepth; }
+};
+}
+
+//==============================================================================
+//! メモリマップしたファイルとIdentifierテーブル。プレースホルダからも参照される
+struct MappedSession::Source : public juce::ReferenceCountedObject
+{
+    juce::Identifier readIdentifier(BinaryDecoder& decoder) const
+    {
+        const auto index = decoder.readVarint();
+        if (decoder.hasFailed() || index >= (juce::uint64)identifiers.size())
+        {
+            decoder.fail();
+            return {};
+        }
+        return identifiers.getReference((int)index);
+    }
+
+    //! decoderの位置のノードのTypeのみを読み込み、ノードの末尾まで読み飛ばす
+    NodePtr readNodeHeader(BinaryDecoder& decoder, juce::Identifier& type);
+
+    //! データをメモリ上に複製し、メモリマップを解放する。以降のプレースホルダの読み込みは複製から行う
+    void releaseMapping()
+    {
+        if (file == nullptr) return;
+
+        copiedData = juce::MemoryBlock(data, size);
+        data = static_cast<const juce::uint8*>(copiedData.getData());
+        file = nullptr;
+    }
+
+    juce::File sourceFile;
+    std::unique_ptr<juce::MemoryMappedFile> file;
+    juce::MemoryBlock copiedData; // releaseMapping()後のデータ
+    const juce::uint8* data = nullptr;
+    size_t size = 0;
+    juce::Array<juce::Identifier> identifiers;
+    int numLoadedNodes = 0;
+};
+
+//==============================================================================
+//! ファイル上のノードの位置と、読み込み後の変更の有無を保持する。
+//! プレースホルダの目印として保持され、読み込み後は親のNodeにより保持される。
+struct MappedSession::Node : public juce::ReferenceCountedObject
+{
+    static Node* fromPlaceholder(const juce::ValueTree& tree)
+    {
+        auto* value = tree.getPropertyPointer(getPlaceholderID());
+        return value != nullptr ? dynamic_cast<Node*>(value->getObject()) : nullptr;
+    }
+
+    //! プロパティと子のプレースホルダをtreeに追加する
+    //! @n shouldTrackChildrenがtrueの場合、作成した子のNodeをchildrenに保持しValueTreeの子と対応付ける
+    void load(juce::ValueTree& tree, bool shouldTrackChildren)
+    {
+        BinaryDecoder decoder(source->data, offset + numBytes, offset + nodeSizeBytes);
+        source->readIdentifier(decoder); // Typeはプレースホルダ作成時に読み込み済み
+
+        const auto numProperties = decoder.readVarint();
+        for (juce::uint64 i = 0; i < numProperties && ! decoder.hasFailed(); ++i)
+        {
+            const auto name = source->readIdentifier(decoder);
+            auto value = decoder.readValue();
+            if (! decoder.hasFailed())
+                tree.setProperty(name, std::move(value), nullptr);
+        }
+
+        const auto numChildren = decoder.readVarint();
+
+        // 深すぎる入れ子は途中で途切れたデータと同様に扱い、子を読み込まない
+        if (numChildren > 0 && depth >= BinaryDecoder::maxTreeDepth)
+            decoder.fail();
+
+        if (shouldTrackChildren && ! decoder.hasFailed() && numChildren <= decoder.getNumBytesRemaining())
+            children.reserve((size_t)numChildren);
+
+        for (juce::uint64 i = 0; i < numChildren && ! decoder.hasFailed(); ++i)
+        {
+            juce::Identifier type;
+            auto child = source->readNodeHeader(decoder, type);
+            if (child == nullptr) break;
+            child->depth = depth + 1;
+
+            juce::ValueTree placeholder(type);
+            placeholder.setProperty(getPlaceholderID(), child.get(), nullptr);
+            tree.appendChild(placeholder, nullptr);
+
+            if (shouldTrackChildren)
+            {
+                child->isInTree = true;
+                children.push_back(child);
+            }
+        }
+
+        // 破損したデータの場合は読み込めた部分までを反映する
+        jassert(! decoder.hasFailed());
+
+        if (shouldTrackChildren)
+            isLoaded = true;
+
+        ++source->numLoadedNodes;
+    }
+
+    //! childrenの対応付けをやめる。以降この部分木は書き込み時に全て書き込み直される
+    void untrack() noexcept
+    {
+        isLoaded = false;
+        children.clear();
+    }
+
+    SourcePtr source;               // 読み込み後に追加されたノードの場合はnullptr
+    size_t offset = 0;              // ノード先頭(バイト数)の位置
+    size_t numBytes = 0;            // バイト数自体を含むノード全体のバイト数
+    int depth = 0;                  // ファイル上のルートからの深さ
+    bool isLoaded = false;          // childrenがValueTreeの子と対応しているかどうか
+    bool isInTree = false;          // 親のNodeのchildrenに含まれているかどうか
+    bool hasChanges = false;        // 自身または子孫に変更があったかどうか
+    std::vector<NodePtr> children;
+};
+
+MappedSession::NodePtr MappedSession::Source::readNodeHeader(BinaryDecoder& decoder, juce::Identifier& type)
+{
+    const auto offset = decoder.getPosition();
+    const auto numBytes = decoder.readUInt32();
+    if (decoder.hasFailed() || numBytes > decoder.getNumBytesRemaining())
+    {
+        decoder.fail();
+        return nullptr;
+    }
+
+    BinaryDecoder header(data, offset + nodeSizeBytes + numBytes, offset + nodeSizeBytes);
+    type = readIdentifier(header);
+    if (header.hasFailed())
+    {
+        decoder.fail();
+        return nullptr;
+    }
+    decoder.readBytes(numBytes);
+
+    NodePtr node = new Node();
+    node->source = this;
+    node->offset = offset;
+    node->numBytes = nodeSizeBytes + numBytes;
+    return node;
+}
+
+//==============================================================================
+class MappedSession::Writer
+{
+public:
+    //! @param sourceToCopyFrom 変更の無かったノードの複製元。このIdentifierテーブルを先頭にそのまま引き継ぐ
+    explicit Writer(Source* sourceToCopyFrom = nullptr) : source(sourceToCopyFrom)
+    {
+        if (source != nullptr)
+            for (auto& id : source->identifiers)
+                addIdentifier(id);
+    }
+
+    bool write(const juce::ValueTree& tree, Node* node, juce::OutputStream& output)
+    {
+        // Identifierテーブルを先頭に書き込むため、ノードを全て書き込んだ後に出力する
+        writeNode(tree, node);
+        if (failed) return false;
+
+        BinaryEncoder header;
+        header.writeBytes(sessionMagic, sizeof(sessionMagic));
+        header.writeByte((juce::uint8)formatVersion);
+
+        header.writeVarint((juce::uint64)identifiers.size());
+        for (auto& id : identifiers)
+            header.writeString(id.toString());
+
+        return output.write(header.getData(), header.getSize())
+            && output.write(body.getData(), body.getSize());
+    }
+
+private:
+    void writeNode(const juce::ValueTree& tree, Node* node)
+    {
+        if (isPlaceholder(tree))
+        {
+            auto* placeholder = Node::fromPlaceholder(tree);
+            if (placeholder != nullptr && placeholder->source == source && source != nullptr)
+            {
+                copyNode(*placeholder);
+                return;
+            }
+            // 別のファイルのプレースホルダはIdentifierテーブルが異なるため読み込んでから書き込む
+            ensureLoaded(tree);
+            node = nullptr;
+        }
+
+        if (node != nullptr && node->source == source && source != nullptr && node->isLoaded && ! node->hasChanges)
+        {
+            copyNode(*node);
+            return;
+        }
+
+        const auto start = body.getSize();
+        body.writeUInt32(0);
+
+        writeIdentifier(tree.getType());
+
+        const int numProperties = tree.getNumProperties();
+        body.writeVarint((juce::uint64)numProperties);
+        for (int i = 0; i < numProperties; ++i)
+        {
+            const auto name = tree.getPropertyName(i);
+            writeIdentifier(name);
+            body.writeValue(tree[name]);
+        }
+
+        const int numChildren = tree.getNumChildren();
+        body.writeVarint((juce::uint64)numChildren);
+
+        const bool hasChildNodes = node != nullptr && node->isLoaded && (int)node->children.size() == numChildren;
+        for (int i = 0; i < numChildren; ++i)
+            writeNode(tree.getChild(i), hasChildNodes ? node->children[(size_t)i].get() : nullptr);
+
+        const auto numBytes = body.getSize() - start - nodeSizeBytes;
+        if (numBytes > std::numeric_limits<juce::uint32>::max())
+        {
+            // 4GBを超える部分木は書き込めない
+            jassertfalse;
+            failed = true;
+            return;
+        }
+        body.setUInt32(start, (juce::uint32)numBytes);
+    }
+
+    void copyNode(const Node& node)
+    {
+        jassert(node.offset + node.numBytes <= source->size);
+        body.writeBytes(source->data + node.offset, node.numBytes);
+    }
+
+    void addIdentifier(const juce::Identifier& id)
+    {
+        if (indices.emplace(id, identifiers.size()).second)
+            identifiers.add(id);
+    }
+
+    void writeIdentifier(const juce::Identifier& id)
+    {
+        addIdentifier(id);
+        body.writeVarint((juce::uint64)indices[id]);
+    }
+
+    Source* source;
+    BinaryEncoder body;
+    std::unordered_map<juce::Identifier, size_t, IdentifierHash> indices;
+    juce::Array<juce::Identifier> identifiers;
+    bool failed = false;
+};
+
+//==============================================================================
+MappedSession::MappedSession() = default;
+
+MappedSession::MappedSession(const juce::File& file)
+{
+    open(file);
+}
+
+MappedSession::~MappedSession()
+{
+    root.removeListener(this);
+}
+
+bool MappedSession::open(const juce::File& file)
+{
+    close();
+
+    SourcePtr newSource = new Source();
+    newSource->sourceFile = file;
+    newSource->file = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+    newSource->data = static_cast<const juce::uint8*>(newSource->file->getData());
+    newSource->size = newSource->file->getSize();
+
+    auto& s = *newSource;
+    if (s.data == nullptr || s.size < sizeof(sessionMagic) + 1 || std::memcmp(s.data, sessionMagic, sizeof(sessionMagic)) != 0)
+        return false;
+
+    BinaryDecoder decoder(s.data, s.size, sizeof(sessionMagic));
+
+    // 新しいバージョンのデータは読み込まない
+    if (decoder.readByte() > formatVersion)
+        return false;
+
+    const auto numIdentifiers = decoder.readVarint();
+    if (decoder.hasFailed() || numIdentifiers > s.size) return false;
+
+    s.identifiers.ensureStorageAllocated((int)numIdentifiers);
+    for (juce::uint64 i = 0; i < numIdentifiers; ++i)
+    {
+        auto name = decoder.readString();
+        if (decoder.hasFailed() || name.isEmpty()) return false;
+        s.identifiers.add(juce::Identifier(name));
+    }
+
+    juce::Identifier type;
+    auto node = s.readNodeHeader(decoder, type);
+    if (node == nullptr) return false;
+
+    source = newSource;
+    rootNode = node;
+    rootNode->isInTree = true;
+
+    // プレースホルダがWrappedTreeなどの紐付け時に読み込まれるよう、作成する前に読み込み関数を登録する
+    WrappedTree::setTreeLoader(&MappedSession::ensureLoaded);
+
+    root = juce::ValueTree(type);
+    root.setProperty(getPlaceholderID(), rootNode.get(), nullptr);
+
+    // ルートの子の追加は通知する必要が無いため、読み込み後にリッスンする
+    loadPlaceholder(root);
+    root.addListener(this);
+    return true;
+}
+
+void MappedSession::close()
+{
+    root.removeListener(this);
+    root = {};
+    lastChangedTree = {};
+    rootNode = nullptr;
+    source = nullptr;
+}
+
+bool MappedSession::hasChanges() const noexcept
+{
+    return rootNode != nullptr && rootNode->hasChanges;
+}
+
+bool MappedSession::writeToStream(juce::OutputStream& output)
+{
+    if (! isOpen())
+    {
+        jassertfalse;
+        return false;
+    }
+    return Writer(source.get()).write(root, rootNode.get(), output);
+}
+
+bool MappedSession::save(const juce::File& targetFile)
+{
+    juce::TemporaryFile temp(targetFile);
+
+    {
+        juce::FileOutputStream output(temp.getFile());
+        if (! output.openedOk() || ! writeToStream(output))
+            return false;
+
+        output.flush();
+    }
+
+    // メモリマップしたままのファイルは置き換えられない環境(Windows)があるため、開いているファイル自体に保存する場合は
+    // 先にデータをメモリ上に複製してマップを解放する。読み込まれていないプレースホルダは複製から読み込まれる
+    if (source != nullptr && targetFile == source->sourceFile)
+        source->releaseMapping();
+
+    return temp.overwriteTargetFileWithTemporary();
+}
+
+int MappedSession::getNumLoadedNodes() const noexcept
+{
+    return source != nullptr ? source->numLoadedNodes : 0;
+}
+
+//==============================================================================
+bool MappedSession::writeToStream(const juce::ValueTree& tree, juce::OutputStream& output) // static
+{
+    if (! tree.isValid())
+    {
+        jassertfalse;
+        return false;
+    }
+    return Writer().write(tree, nullptr, output);
+}
+
+bool MappedSession::writeToStream(const WrappedTree& tree, juce::OutputStream& output) // static
+{
+    return writeToStream(tree.getValueTree(), output);
+}
+
+void MappedSession::ensureLoadedRecursively(const juce::ValueTree& tree) // static
+{
+    ensureLoaded(tree);
+
+    for (const auto& child : tree)
+        ensureLoadedRecursively(child);
+}
+
+bool MappedSession::isLoading() noexcept // static
+{
+    return loadingDepth > 0;
+}
+
+const juce::Identifier& MappedSession::getPlaceholderID() // static
+{
+    static const juce::Identifier id("vtwrapper_mappedSessionPlaceholder");
+    return id;
+}
+
+void MappedSession::loadPlaceholder(const juce::ValueTree& placeholder) // static
+{
+    juce::ValueTree tree(placeholder);
+    NodePtr node = Node::fromPlaceholder(tree);
+
+    ScopedLoading loading;
+    tree.removeProperty(getPlaceholderID(), nullptr);
+
+    if (node == nullptr)
+    {
+        jassertfalse;
+        return;
+    }
+
+    // 複製されたプレースホルダが既に読み込まれている場合は、子との対応付けを行わない
+    node->load(tree, ! node->isLoaded);
+}
+
+//==============================================================================
+void MappedSession::valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged, const juce::Identifier&)
+{
+    if (loadingDepth > 0) return;
+
+    // 同じノードのプロパティが続けて変更された場合(スライダーの操作など)は、経路上のNodeが既に変更ありとなっているため辿り直さない
+    // 変更ありの状態は戻らず、ノードが移動する場合は構造の変更の通知で経路を辿り直すため、構造の変更時のみ破棄すれば良い
+    if (treeWhosePropertyHasChanged == lastChangedTree) return;
+
+    markPathTo(treeWhosePropertyHasChanged);
+    lastChangedTree = treeWhosePropertyHasChanged;
+}
+
+void MappedSession::valueTreeChildAdded(juce::ValueTree& parentTree, juce::ValueTree& childWhichHasBeenAdded)
+{
+    if (loadingDepth > 0) return;
+
+    lastChangedTree = {};
+
+    auto* node = markPathTo(parentTree);
+    if (node == nullptr || ! node->isLoaded) return;
+
+    if ((int)node->children.size() != parentTree.getNumChildren() - 1)
+    {
+        jassertfalse;
+        node->untrack();
+        return;
+    }
+
+    // 取り除かれたプレースホルダが再度追加された場合(Undoなど)は、元のNodeを引き継ぐ。
+    // 読み込み済みのノードは対応するNodeを辿れないため、新たに追加されたノードとして扱う
+    NodePtr child = Node::fromPlaceholder(childWhichHasBeenAdded);
+    if (child == nullptr || child->source != source || child->isInTree || ! isPlaceholder(childWhichHasBeenAdded))
+    {
+        child = new Node();
+        child->hasChanges = true;
+    }
+    child->isInTree = true;
+
+    const int index = parentTree.indexOf(childWhichHasBeenAdded);
+    node->children.insert(node->children.begin() + index, child);
+}
+
+void MappedSession::valueTreeChildRemoved(juce::ValueTree& parentTree, juce::ValueTree&, int indexFromWhichChildWasRemoved)
+{
+    if (loadingDepth > 0) return;
+
+    lastChangedTree = {};
+
+    auto* node = markPathTo(parentTree);
+    if (node == nullptr || ! node->isLoaded) return;
+
+    if (! juce::isPositiveAndBelow(indexFromWhichChildWasRemoved, (int)node->children.size()))
+    {
+        jassertfalse;
+        node->untrack();
+        return;
+    }
+
+    auto it = node->children.begin() + indexFromWhichChildWasRemoved;
+    (*it)->isInTree = false;
+    node->children.erase(it);
+}
+
+void MappedSession::valueTreeChildOrderChanged(juce::ValueTree& parentTreeWhoseChildrenHaveMoved, int oldIndex, int newIndex)
+{
+    if (loadingDepth > 0) return;
+
+    lastChangedTree = {};
+
+    auto* node = markPathTo(parentTreeWhoseChildrenHaveMoved);
+    if (node == nullptr || ! node->isLoaded) return;
+
+    auto& c = node->children;
+    if (! juce::isPositiveAndBelow(oldIndex, (int)c.size()) || ! juce::isPositiveAndBelow(newIndex, (int)c.size()))
+    {
+        jassertfalse;
+        node->untrack();
+        return;
+    }
+
+    auto moved = std::move(c[(size_t)oldIndex]);
+    c.erase(c.begin() + oldIndex);
+    c.insert(c.begin() + newIndex, std::move(moved));
+}
+
+void MappedSession::valueTreeRedirected(juce::ValueTree& treeWhichHasBeenChanged)
+{
+    lastChangedTree = {};
+
+    // 別のValueTreeに置き換えられた場合は全体を書き込み直す
+    if (treeWhichHasBeenChanged == root && rootNode != nullptr)
+    {
+        rootNode->untrack();
+        rootNode->hasChanges = true;
+    }
+}
+
+MappedSession::Node* MappedSession::markPathTo(const juce::ValueTree& tree)
+{
+    if (rootNode == nullptr) return nullptr;
+
+    // 対象からrootまでの各階層でのインデックスを求める
+    juce::Array<int> path;
+    for (auto t = tree; t != root; )
+    {
+        auto parent = t.getParent();
+        if (! parent.isValid()) return nullptr;
+
+        path.add(parent.indexOf(t));
+        t = parent;
+    }
+
+    auto* node = rootNode.get();
+    node->hasChanges = true;
+
+    for (int i = path.size(); --i >= 0;)
+    {
+        const auto index = (size_t)path.getUnchecked(i);
+
+        // 対応付けていない部分木の中の変更は、その部分木全体を書き込み直すことで反映する
+        if (! node->isLoaded || index >= node->children.size())
+            return nullptr;
+
+        node = node->children[index].get();
+        node->hasChanges = true;
+    }
+    return node;
+}
+
+} // namespace vtwrapper
@@ -0,0 +1,138 @@
+/*
+  ==============================================================================
+
+    MappedSession.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+#include <vector>
+
+namespace vtwrapper
+{
+
+class WrappedTree;
+
+//==============================================================================
+/**
+ @brief セッションファイルをメモリマップし、アクセスされたノードのみを読み込むクラス
+ - open()ではヘッダとIdentifierテーブル、ルートノードのみを読み込む。 @n
+ 読み込まれていないノードは、Typeのみを持つ仮のjuce::ValueTree(以下プレースホルダ)として親に追加される。
+ - プレースホルダはWrappedTree::wrap()、WrappedTreeList::wrap()およびUniquePtr::referTo()で紐付けられた時に読み込まれる。 @n
+ (open()時にWrappedTree::setTreeLoader()でensureLoaded()を登録し、紐付け時にWrappedTree::loadIfNeeded()から呼び出される) @n
+ WrappedTreeList::setLazyWrapping(true)と組み合わせることで、アクセスした要素とその親のみが読み込まれる。
+ - juce::ValueTreeを直接走査する場合は、先にensureLoaded()やensureLoadedRecursively()を呼び出す必要がある。 @n
+ BinaryTreeFormat、SnapshotBuilderおよびDeltaRecorderは、走査の前に自身で読み込む。
+ - 各ノードは自身のバイト数を先頭に持つため、読み込む必要の無い部分木は解析せずに読み飛ばす。 @n
+ ただし、あるノードを読み込むとその子の数だけプレースホルダを作成する。
+ - writeToStream()およびsave()では、読み込んでいない部分木と読み込み後に変更の無かった部分木は元のファイルからそのまま複製し、 @n
+ 変更のあった部分木のみを書き込み直す。
+ - プレースホルダは元のファイルのデータを参照カウントで保持するため、MappedSessionを破棄した後も読み込み可能。
+ - ファイル上のルートからの深さがBinaryDecoder::maxTreeDepthのノードの子は、破損したデータとして読み込まない。
+
+ [形式]
+ - ヘッダ: "VTWS"およびバージョン(1バイト)
+ - Identifierテーブル: 要素数, 各Identifierの(バイト数, UTF-8文字列)
+ - ノード: 以降のバイト数(4バイト), TypeのIdentifierインデックス, プロパティ数, 各プロパティの(Identifierインデックス, 型タグ, 値), 子の数, 各子ノード
+ - 値の形式はBinaryTreeFormatと同じ
+
+ @code
+ MappedSession::writeToStream(projectTree, output); // 新規に書き込む
+
+ MappedSession session(file);
+ tracks.setLazyWrapping(true);
+ tracks.wrap(session.getRoot(), IDs::tracks, IDs::track, &undoManager);
+ ...
+ session.save(file); // 変更のあった部分のみ書き込み直す
+ @endcode
+ */
+class MappedSession
+: private juce::ValueTree::Listener
+{
+public:
+    MappedSession();
+    explicit MappedSession(const juce::File& file);
+    ~MappedSession() override;
+
+    //! @brief ファイルをメモリマップしルートノードを読み込む。形式が異なる場合などはfalseを返す
+    bool open(const juce::File& file);
+    void close();
+    bool isOpen() const noexcept { return root.isValid(); }
+
+    //! @brief ルートノード。open()に失敗した場合は無効なValueTree
+    const juce::ValueTree& getRoot() const noexcept { return root; }
+
+    //! @brief open()以降にルート以下の読み込み済みのノードに変更があったかどうか
+    bool hasChanges() const noexcept;
+
+    //! @brief 開いているセッションを書き込む。変更の無かった部分木は元のファイルからそのまま複製する
+    bool writeToStream(juce::OutputStream& output);
+
+    //! @brief 一時ファイルへ書き込んだ後に置き換える。
+    //! @n 保存後もこのMappedSessionは元のファイルのデータを参照し続けるため、保存したファイルを読み込み直す場合は再度open()を呼び出す。
+    //! @n 開いているファイル自体に保存する場合は、置き換える前にファイル全体をメモリ上に複製してメモリマップを解放する。 @n
+    //! 読み込まれていないプレースホルダはその複製から読み込まれるため、ファイルの大きさ分のメモリを使用する。
+    bool save(const juce::File& targetFile);
+
+    //! @brief 開いているファイルから読み込んだノードの数
+    int getNumLoadedNodes() const noexcept;
+
+    //==============================================================================
+    //! @brief ValueTreeをセッションファイルの形式で書き込む
+    static bool writeToStream(const juce::ValueTree& tree, juce::OutputStream& output);
+    static bool writeToStream(const WrappedTree& tree, juce::OutputStream& output);
+
+    //! @brief treeがプレースホルダであれば、プロパティと子(のプレースホルダ)を読み込む
+    //! @n プレースホルダでない場合は何もしないため、任意のValueTreeに対して呼び出せる
+    static void ensureLoaded(const juce::ValueTree& tree)
+    {
+        if (isPlaceholder(tree))
+            loadPlaceholder(tree);
+    }
+
+    //! @brief 部分木全体を読み込む
+    static void ensureLoadedRecursively(const juce::ValueTree& tree);
+
+    //! @brief 読み込まれていないプレースホルダかどうか
+    static bool isPlaceholder(const juce::ValueTree& tree)
+    {
+        // プレースホルダは作成時に最初のプロパティとして目印を持つ
+        return tree.getNumProperties() > 0 && tree.getPropertyName(0) == getPlaceholderID();
+    }
+
+    //! @brief プレースホルダの読み込み中かどうか。読み込みによるValueTreeの変更を変更として扱わない場合に用いる
+    static bool isLoading() noexcept;
+
+    static constexpr int formatVersion = 1;
+
+private:
+    struct Source;
+    struct Node;
+    class Writer;
+    using SourcePtr = juce::ReferenceCountedObjectPtr<Source>;
+    using NodePtr = juce::ReferenceCountedObjectPtr<Node>;
+
+    static const juce::Identifier& getPlaceholderID();
+    static void loadPlaceholder(const juce::ValueTree& tree);
+
+    void valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged, const juce::Identifier& property) override;
+    void valueTreeChildAdded(juce::ValueTree& parentTree, juce::ValueTree& childWhichHasBeenAdded) override;
+    void valueTreeChildRemoved(juce::ValueTree& parentTree, juce::ValueTree& childWhichHasBeenRemoved, int indexFromWhichChildWasRemoved) override;
+    void valueTreeChildOrderChanged(juce::ValueTree& parentTreeWhoseChildrenHaveMoved, int oldIndex, int newIndex) override;
+    void valueTreeRedirected(juce::ValueTree& treeWhichHasBeenChanged) override;
+
+    //! treeに対応するNodeを探し、その経路上を変更ありとする。対応するNodeが無い場合はnullptr
+    Node* markPathTo(const juce::ValueTree& tree);
+
+    juce::ValueTree root;
+    SourcePtr source;
+    NodePtr rootNode;
+    juce::ValueTree lastChangedTree; // 直前にプロパティが変更され、経路を変更ありとしたノード
+
+    JUCE_DECLARE_NON_COPYABLE(MappedSession)
+};
+
+} // namespace vtwrapper
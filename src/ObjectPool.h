@@ -0,0 +1,361 @@
+/*
+  ==============================================================================
+
+    ObjectPool.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+#include <atomic>
+#include <new>
+
+namespace vtwrapper
+{
+
+/*
+ WrappedTreeListおよびUniquePtrのAllocatorテンプレート引数には以下を満たす型を指定する。
+ - ObjectType* create() ... デフォルトコンストラクタで構築したオブジェクトを返す
+ - void destroy(ObjectType* object) ... create()で作成したオブジェクト、もしくはnewで確保されたオブジェクトを破棄する
+ WrappedTreeList::forEachInStorageOrder()を使用する場合は以下も必要となる。(ChunkedAllocatorが満たす)
+ - void forEach(Function&& function) ... create()で作成し生存している全てのオブジェクトに対して、メモリ上の順にfunction(ObjectType&)を呼び出す
+ - bool owns(const ObjectType* object) const ... create()で作成したオブジェクトかどうか
+ */
+
+//==============================================================================
+//! @brief new/deleteによるAllocator
+template <typename ObjectType>
+struct HeapAllocator
+{
+    ObjectType* create() { return new ObjectType(); }
+    void destroy(ObjectType* object) { delete object; }
+};
+
+//==============================================================================
+/**
+ @brief 固定サイズのスロットをまとめて確保し、破棄されたスロットを再利用するオブジェクトプール
+ - スロットはnumSlotsPerSlab個ずつ連続したメモリ(スラブ)として確保されるため、続けて作成したオブジェクトはメモリ上で隣接する。
+ - 破棄されたスロットは次のcreate()で再利用され、確保したスラブはプールが破棄されるまで解放されない。
+ - destroy()にプール外で確保されたオブジェクトが渡された場合はdeleteで破棄する。
+ - create()およびdestroy()はスレッドセーフである。(WrappedTreeList::setParallelWrapping()でワーカースレッドから子要素を作成するため) @n
+ オブジェクトの構築・破棄はロックの外で行うため、コンストラクタ・デストラクタから同じプールを使用することが可能。
+ */
+template <typename ObjectType, int numSlotsPerSlab = 64>
+class SlabPool
+{
+public:
+    SlabPool() = default;
+    
+    ~SlabPool()
+    {
+        // プールより先にオブジェクトを破棄する必要がある
+        jassert(numAllocated == 0);
+    }
+    
+    template <typename... Args>
+    ObjectType* create(Args&&... args)
+    {
+        auto* slot = popFreeSlot();
+        
+        try
+        {
+            return new (slot->storage) ObjectType(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            pushFreeSlot(slot);
+            throw;
+        }
+    }
+    
+    void destroy(ObjectType* object)
+    {
+        if (object == nullptr) return;
+        
+        if (! owns(object))
+        {
+            delete object;
+            return;
+        }
+        
+        object->~ObjectType();
+        pushFreeSlot(reinterpret_cast<Slot*>(object));
+    }
+    
+    //! @brief このプールで確保したスロットのアドレスかどうか
+    bool owns(const ObjectType* object) const noexcept
+    {
+        const auto address = reinterpret_cast<std::uintptr_t>(object);
+        const juce::SpinLock::ScopedLockType sl(lock);
+        
+        auto it = std::upper_bound(slabRanges.begin(), slabRanges.end(), address,
+                                   [](std::uintptr_t a, const SlabRange& range) { return a < range.begin; });
+        if (it == slabRanges.begin()) return false;
+        
+        --it;
+        return address < it->end;
+    }
+    
+    int getNumAllocated() const noexcept { return numAllocated.load(); }
+    int getNumSlabs() const noexcept { return (int)slabs.size(); }
+    
+    //! @brief 型ごとに共有されるインスタンス。終了時の破棄順の問題を避けるため解放しない
+    static SlabPool& getSharedInstance()
+    {
+        static auto* instance = new SlabPool();
+        return *instance;
+    }
+    
+private:
+    union Slot
+    {
+        Slot* nextFree;
+        alignas(ObjectType) unsigned char storage[sizeof(ObjectType)];
+    };
+    
+    struct SlabRange
+    {
+        std::uintptr_t begin, end;
+    };
+    
+    Slot* popFreeSlot()
+    {
+        const juce::SpinLock::ScopedLockType sl(lock);
+        
+        if (freeList == nullptr)
+            addSlab();
+        
+        auto* slot = freeList;
+        freeList = slot->nextFree;
+        ++numAllocated;
+        return slot;
+    }
+    
+    void pushFreeSlot(Slot* slot)
+    {
+        const juce::SpinLock::ScopedLockType sl(lock);
+        
+        slot->nextFree = freeList;
+        freeList = slot;
+        --numAllocated;
+    }
+    
+    void addSlab()
+    {
+        auto slab = std::make_unique<Slot[]>(numSlotsPerSlab);
+        
+        // 先頭から順に割り当てられるようにリンクする
+        for (int i = 0; i < numSlotsPerSlab - 1; ++i)
+            slab[i].nextFree = &slab[i + 1];
+        slab[numSlotsPerSlab - 1].nextFree = freeList;
+        freeList = &slab[0];
+        
+        SlabRange range { reinterpret_cast<std::uintptr_t>(&slab[0]), reinterpret_cast<std::uintptr_t>(&slab[0] + numSlotsPerSlab) };
+        auto it = std::upper_bound(slabRanges.begin(), slabRanges.end(), range.begin,
+                                   [](std::uintptr_t a, const SlabRange& r) { return a < r.begin; });
+        slabRanges.insert(it, range);
+        slabs.push_back(std::move(slab));
+    }
+    
+    std::vector<std::unique_ptr<Slot[]>> slabs;
+    std::vector<SlabRange> slabRanges; // owns()で二分探索するため先頭アドレス順に保持する
+    Slot* freeList = nullptr;
+    std::atomic<int> numAllocated { 0 };
+    juce::SpinLock lock;
+    
+    JUCE_DECLARE_NON_COPYABLE(SlabPool)
+};
+
+//==============================================================================
+//! @brief 型ごとに共有されるSlabPoolによるAllocator。WrappedTreeListおよびUniquePtrのデフォルト
+template <typename ObjectType>
+struct PooledAllocator
+{
+    ObjectType* create() { return SlabPool<ObjectType>::getSharedInstance().create(); }
+    void destroy(ObjectType* object) { SlabPool<ObjectType>::getSharedInstance().destroy(object); }
+};
+
+//==============================================================================
+/**
+ @brief インスタンスごとに固定サイズのチャンクを確保し、オブジェクトをチャンク内に詰めて配置するAllocator
+ - PooledAllocatorは型ごとに共有されるため、複数のリストの要素がメモリ上で混在し、再利用されるスロットの順序も破棄の順に依存する。 @n
+ このAllocatorはWrappedTreeListごとにチャンクを持ち、常に先頭に近い空きスロットから割り当てるため、 @n
+ 続けて作成した要素(wrap()時の子要素など)は作成順にメモリ上で隣接する。
+ - チャンクは移動しないため、作成したオブジェクトのアドレスは破棄されるまで変わらない。 @n
+ 確保したチャンクはAllocatorが破棄されるまで解放されない。
+ - forEach()で生存しているオブジェクトをメモリ上の順に走査できる。(WrappedTreeList::forEachInStorageOrder()を参照)
+ - destroy()にチャンク外で確保されたオブジェクトが渡された場合はdeleteで破棄する。
+ - create()およびdestroy()はスレッドセーフである。forEach()はcreate()、destroy()と同時に呼び出してはならない。
+ */
+template <typename ObjectType, int numSlotsPerChunk = 256>
+class ChunkedAllocator
+{
+public:
+    static_assert(numSlotsPerChunk > 0 && numSlotsPerChunk % 64 == 0, "numSlotsPerChunk must be a multiple of 64");
+    
+    ChunkedAllocator() = default;
+    
+    ~ChunkedAllocator()
+    {
+        // Allocatorより先にオブジェクトを破棄する必要がある
+        jassert(numAllocated == 0);
+    }
+    
+    template <typename... Args>
+    ObjectType* create(Args&&... args)
+    {
+        auto* slot = acquireSlot();
+        
+        try
+        {
+            return new (slot) ObjectType(std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            releaseSlot(slot);
+            throw;
+        }
+    }
+    
+    void destroy(ObjectType* object)
+    {
+        if (object == nullptr) return;
+        
+        if (! owns(object))
+        {
+            delete object;
+            return;
+        }
+        
+        object->~ObjectType();
+        releaseSlot(object);
+    }
+    
+    //! @brief このAllocatorのチャンク内のアドレスかどうか
+    bool owns(const ObjectType* object) const noexcept
+    {
+        const juce::SpinLock::ScopedLockType sl(lock);
+        return findChunk(object) >= 0;
+    }
+    
+    //! @brief 生存している全てのオブジェクトに対して、メモリ上の順にfunction(ObjectType&)を呼び出す
+    template <typename Function>
+    void forEach(Function&& function)
+    {
+        for (auto& chunk : chunks)
+        {
+            for (int w = 0; w < numWordsPerChunk; ++w)
+            {
+                const auto bits = chunk->occupied[w];
+                if (bits == 0) continue;
+                
+                // 全て使用中の場合は判定を省く
+                const bool isFull = bits == ~(juce::uint64)0;
+                for (int bit = 0; bit < 64; ++bit)
+                    if (isFull || ((bits >> bit) & 1) != 0)
+                        function(*chunk->getObject(w * 64 + bit));
+            }
+        }
+    }
+    
+    int getNumAllocated() const noexcept { return numAllocated.load(); }
+    int getNumChunks() const noexcept { return (int)chunks.size(); }
+    
+private:
+    static constexpr int numWordsPerChunk = numSlotsPerChunk / 64;
+    
+    struct Chunk
+    {
+        ObjectType* getObject(int index) noexcept { return reinterpret_cast<ObjectType*>(storage[index].bytes); }
+        
+        struct alignas(ObjectType) SlotStorage { unsigned char bytes[sizeof(ObjectType)]; };
+        SlotStorage storage[numSlotsPerChunk];
+        juce::uint64 occupied[numWordsPerChunk] = {};
+        int numUsed = 0;
+    };
+    
+    struct ChunkRange
+    {
+        std::uintptr_t begin, end;
+        int chunkIndex;
+    };
+    
+    static int findLowestSetBit(juce::uint64 bits) noexcept { return juce::countNumberOfBits((bits & (~bits + 1)) - 1); }
+    
+    ObjectType* acquireSlot()
+    {
+        const juce::SpinLock::ScopedLockType sl(lock);
+        
+        // firstChunkWithSpaceより前のチャンクは全て使用中
+        while (firstChunkWithSpace < (int)chunks.size() && chunks[(size_t)firstChunkWithSpace]->numUsed == numSlotsPerChunk)
+            ++firstChunkWithSpace;
+        
+        if (firstChunkWithSpace == (int)chunks.size())
+            addChunk();
+        
+        auto& chunk = *chunks[(size_t)firstChunkWithSpace];
+        for (int w = 0;; ++w)
+        {
+            const auto freeBits = ~chunk.occupied[w];
+            if (freeBits == 0) continue;
+            
+            const int bit = findLowestSetBit(freeBits);
+            chunk.occupied[w] |= (juce::uint64)1 << bit;
+            ++chunk.numUsed;
+            ++numAllocated;
+            return chunk.getObject(w * 64 + bit);
+        }
+    }
+    
+    void releaseSlot(ObjectType* object)
+    {
+        const juce::SpinLock::ScopedLockType sl(lock);
+        
+        const int chunkIndex = findChunk(object);
+        jassert(chunkIndex >= 0);
+        
+        auto& chunk = *chunks[(size_t)chunkIndex];
+        const int index = (int)((reinterpret_cast<std::uintptr_t>(object) - reinterpret_cast<std::uintptr_t>(chunk.storage)) / sizeof(typename Chunk::SlotStorage));
+        chunk.occupied[index / 64] &= ~((juce::uint64)1 << (index % 64));
+        --chunk.numUsed;
+        --numAllocated;
+        
+        firstChunkWithSpace = juce::jmin(firstChunkWithSpace, chunkIndex);
+    }
+    
+    //! lockを取得した状態で呼び出す
+    int findChunk(const ObjectType* object) const noexcept
+    {
+        const auto address = reinterpret_cast<std::uintptr_t>(object);
+        
+        auto it = std::upper_bound(chunkRanges.begin(), chunkRanges.end(), address,
+                                   [](std::uintptr_t a, const ChunkRange& range) { return a < range.begin; });
+        if (it == chunkRanges.begin()) return -1;
+        
+        --it;
+        return address < it->end ? it->chunkIndex : -1;
+    }
+    
+    void addChunk()
+    {
+        auto chunk = std::make_unique<Chunk>();
+        
+        ChunkRange range { reinterpret_cast<std::uintptr_t>(chunk->storage), reinterpret_cast<std::uintptr_t>(chunk->storage + numSlotsPerChunk), (int)chunks.size() };
+        auto it = std::upper_bound(chunkRanges.begin(), chunkRanges.end(), range.begin,
+                                   [](std::uintptr_t a, const ChunkRange& r) { return a < r.begin; });
+        chunkRanges.insert(it, range);
+        chunks.push_back(std::move(chunk));
+    }
+    
+    std::vector<std::unique_ptr<Chunk>> chunks; // 作成順。割り当ておよびforEach()はこの順に行う
+    std::vector<ChunkRange> chunkRanges;        // findChunk()で二分探索するため先頭アドレス順に保持する
+    int firstChunkWithSpace = 0;
+    std::atomic<int> numAllocated { 0 };
+    mutable juce::SpinLock lock;
+    
+    JUCE_DECLARE_NON_COPYABLE(ChunkedAllocator)
+};
+
+} // namespace vtwrapper
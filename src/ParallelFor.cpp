@@ -0,0 +1,69 @@
+/*
+  ==============================================================================
+
+    ParallelFor.cpp
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#include "ParallelFor.h"
+#include <atomic>
+
+namespace vtwrapper
+{
+
+namespace
+{
+//! poolのジョブが呼び出し元より後に開始されても参照できるよう、共有ポインタで保持する
+struct ParallelJobs
+{
+    ParallelJobs(int numJobsToRun, const std::function<void(int)>& jobToRun)
+    : numJobs(numJobsToRun), job(jobToRun) {}
+
+    void runAvailableJobs()
+    {
+        for (int i = nextJob.fetch_add(1); i < numJobs; i = nextJob.fetch_add(1))
+            job(i);
+    }
+
+    const int numJobs;
+    const std::function<void(int)>& job;
+    std::atomic<int> nextJob { 0 };
+    std::atomic<int> numRunningHelpers { 0 };
+    std::atomic<bool> isClosed { false };
+    juce::WaitableEvent helpersFinished;
+};
+}
+
+void runInParallel(juce::ThreadPool& pool, int numJobs, const std::function<void(int jobIndex)>& job)
+{
+    if (numJobs <= 0) return;
+
+    auto jobs = std::make_shared<ParallelJobs>(numJobs, job);
+
+    const int numHelpers = juce::jmin(pool.getNumThreads(), numJobs - 1);
+    for (int i = 0; i < numHelpers; ++i)
+    {
+        pool.addJob([jobs]
+        {
+            ++jobs->numRunningHelpers;
+
+            // 呼び出し元が戻った後はjobを参照しない
+            if (! jobs->isClosed)
+                jobs->runAvailableJobs();
+
+            if (--jobs->numRunningHelpers == 0)
+                jobs->helpersFinished.signal();
+        });
+    }
+
+    jobs->runAvailableJobs();
+
+    // 開始済みのジョブのみ完了を待つ
+    jobs->isClosed = true;
+    while (jobs->numRunningHelpers.load() > 0)
+        jobs->helpersFinished.wait();
+}
+
+} // namespace vtwrapper
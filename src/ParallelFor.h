@@ -0,0 +1,26 @@
+/*
+  ==============================================================================
+
+    ParallelFor.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_core/juce_core.h>
+#include <functional>
+
+namespace vtwrapper
+{
+
+//==============================================================================
+/**
+ @brief job(0)〜job(numJobs - 1)をpoolのスレッドおよび呼び出し元のスレッドで分担して実行し、全て完了してから戻る
+ - 呼び出し元のスレッドも実行に加わるため、poolが他の処理で埋まっている場合も完了する。 @n
+ また実行を開始していないpoolのジョブは待たずに戻る。
+ - 各jobは異なるスレッドで同時に実行されるため、jobIndexごとに独立した処理である必要がある。
+ */
+void runInParallel(juce::ThreadPool& pool, int numJobs, const std::function<void(int jobIndex)>& job);
+
+} // namespace vtwrapper
@@ -0,0 +1,343 @@
+/*
+  ==============================================================================
+
+    PropertyColumn.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+#include <vector>
+#include "ListenerRegistrar.h"
+#include "RealtimeValue.h"
+#include "ValueTreeObjectList.h"
+
+namespace vtwrapper
+{
+
+//==============================================================================
+/**
+ @brief WrappedTreeListの全要素が持つひとつのプロパティの値を、連続したstd::vectorとして保持するクラス
+ - WrappedTreeList[i]->gain.get()のように要素ごとにポインタを辿らずに、data()から全要素の値をまとめて読み出せる。 @n
+ getMin()、getMax()、getSum()も連続した配列に対して行うため、キャッシュ効率が良くベクトル化されやすい。
+ - 値の並びは親ValueTreeの子の並び(WrappedTreeListのインデックス)と一致し、子の追加・削除・移動およびプロパティの変更に追従する。 @n
+ ValueTreeを直接監視するため、WrappedTreeListを介さない変更やundo/redoにも追従する。
+ - プロパティを持たない要素の値はdefaultValueとなる。WrappedPropertyのConstrainerは適用されない。
+ - MappedSessionの未読み込みの子は、attachTo()時に読み込まれる。
+ - メッセージスレッドでの使用を想定している。オーディオスレッドから読み出す場合はsetRealtimeReadEnabled(true)を呼んだ上でgetRealtime()を使用する。
+ - vector<bool>は連続した配列とならないため、boolのプロパティにはint等を用いる。
+
+ @code
+ PropertyColumn<float> gains(tracks, "gain", 1.0f);
+
+ const float* g = gains.data();           // tracks[i]->gainと同じ値が並ぶ
+ for (int i = 0; i < gains.size(); ++i) ...
+ auto peak = gains.getMax();
+ @endcode
+ */
+template <typename Type>
+class PropertyColumn
+: private juce::ValueTree::Listener
+{
+public:
+    static_assert(! std::is_same<Type, bool>::value, "std::vector<bool> is not contiguous");
+
+    PropertyColumn() = default;
+
+    template <typename WrappedTreeType, typename Allocator>
+    PropertyColumn(const WrappedTreeList<WrappedTreeType, Allocator>& list, const juce::Identifier& property, const Type& defaultVal = Type())
+    {
+        attachTo(list, property, defaultVal);
+    }
+
+    PropertyColumn(const juce::ValueTree& parent, const juce::Identifier& property, const Type& defaultVal = Type())
+    {
+        attachTo(parent, property, defaultVal);
+    }
+
+    ~PropertyColumn() override { detach(); }
+
+    //! @brief listの要素のpropertyを対象とする。listのwrap()後に呼び出す
+    template <typename WrappedTreeType, typename Allocator>
+    void attachTo(const WrappedTreeList<WrappedTreeType, Allocator>& list, const juce::Identifier& property, const Type& defaultVal = Type())
+    {
+        attachTo(list.getValueTree(), property, defaultVal);
+    }
+
+    //! @brief parentの子のpropertyを対象とする
+    void attachTo(const juce::ValueTree& parent, const juce::Identifier& property, const Type& defaultVal = Type());
+    void detach();
+
+    bool isAttached() const noexcept { return parentTree.isValid(); }
+    const juce::ValueTree& getParentTree() const noexcept { return parentTree; }
+    const juce::Identifier& getPropertyID() const noexcept { return targetProperty; }
+    Type getDefault() const noexcept { return defaultValue; }
+
+    //==============================================================================
+    const Type* data() const noexcept { return values.data(); }
+    int size() const noexcept { return (int)values.size(); }
+    bool isEmpty() const noexcept { return values.empty(); }
+    const std::vector<Type>& getValues() const noexcept { return values; }
+
+    Type operator[](int index) const noexcept { return juce::isPositiveAndBelow(index, size()) ? values[(size_t)index] : defaultValue; }
+    const Type* begin() const noexcept { return values.data(); }
+    const Type* end() const noexcept { return values.data() + values.size(); }
+
+    //! @brief 全要素の最小値。要素が無い場合はdefaultValue
+    Type getMin() const noexcept { return isEmpty() ? defaultValue : findMinAndMax().getStart(); }
+    //! @brief 全要素の最大値。要素が無い場合はdefaultValue
+    Type getMax() const noexcept { return isEmpty() ? defaultValue : findMinAndMax().getEnd(); }
+    //! @brief 全要素の最小値と最大値
+    juce::Range<Type> findMinAndMax() const noexcept;
+    //! @brief 全要素の合計。要素が無い場合は0
+    Type getSum() const noexcept;
+
+    //==============================================================================
+    //! @brief リアルタイムスレッドから値を読み出せるようにするかどうか。
+    //! 有効にするとメッセージスレッドでの変更のたびに全要素がgetRealtime()用のバッファへコピーされる。
+    //! @n 読み出し側スレッドでgetRealtime()を呼び出し始める前にメッセージスレッドで有効にしておく必要がある。
+    //! @n バッファは最初に有効にした時に確保され、無効にしても破棄されない。
+    void setRealtimeReadEnabled(bool shouldBeEnabled);
+    bool isRealtimeReadEnabled() const noexcept { return realtimeReadEnabled.load(std::memory_order_acquire); }
+
+    //! @brief リアルタイムスレッドから全要素を読み出す。wait-freeかつメモリ確保を行わない
+    //! @n 参照は同じスレッドで次にgetRealtime()を呼ぶまで有効。読み出し側のスレッドはひとつである必要がある。
+    //! @n 無効の間は最後に公開された値を返し続ける。(一度も有効にしていなければ空の配列)
+    const std::vector<Type>& getRealtime() const noexcept;
+
+private:
+    void valueTreePropertyChanged(juce::ValueTree& changedTree, const juce::Identifier& changedProperty) override;
+    void valueTreeChildAdded(juce::ValueTree& parent, juce::ValueTree& childWhichHasBeenAdded) override;
+    void valueTreeChildRemoved(juce::ValueTree& parent, juce::ValueTree& childWhichHasBeenRemoved, int indexFromWhichChildWasRemoved) override;
+    void valueTreeChildOrderChanged(juce::ValueTree& parent, int oldIndex, int newIndex) override;
+    void valueTreeRedirected(juce::ValueTree& treeWhichHasBeenChanged) override;
+
+    void rebuild();
+    Type readValue(const juce::ValueTree& child) const;
+    void updateRealtimeValues();
+
+    juce::ValueTree parentTree;
+    juce::Identifier targetProperty;
+    Type defaultValue {};
+
+    std::vector<Type> values;
+    int lastChangedIndex = 0;
+    std::unique_ptr<RealtimeValue<std::vector<Type>>> realtimeValues;
+    std::atomic<const RealtimeValue<std::vector<Type>>*> publishedRealtimeValues { nullptr };
+    std::atomic<bool> realtimeReadEnabled { false };
+
+    JUCE_DECLARE_NON_COPYABLE(PropertyColumn)
+};
+
+//==============================================================================
+template <typename Type>
+void PropertyColumn<Type>::attachTo(const juce::ValueTree& parent, const juce::Identifier& property, const Type& defaultVal)
+{
+    detach();
+
+    parentTree = parent;
+    targetProperty = property;
+    defaultValue = defaultVal;
+
+    if (! parentTree.isValid()) return;
+
+    ListenerRegistrar::add(parentTree, this);
+    rebuild();
+}
+
+template <typename Type>
+void PropertyColumn<Type>::detach()
+{
+    if (parentTree.isValid())
+        ListenerRegistrar::remove(parentTree, this);
+
+    parentTree = {};
+    values.clear();
+    updateRealtimeValues();
+}
+
+template <typename Type>
+juce::Range<Type> PropertyColumn<Type>::findMinAndMax() const noexcept
+{
+    static_assert(std::is_arithmetic<Type>::value, "findMinAndMax() requires an arithmetic type");
+
+    const Type* src = values.data();
+    const int num = size();
+    if (num == 0) return {};
+
+    // 依存関係を断ち切るため4本に分けて比較し、ベクトル化しやすくする
+    Type mn[4] = { src[0], src[0], src[0], src[0] };
+    Type mx[4] = { src[0], src[0], src[0], src[0] };
+
+    int i = 0;
+    for (; i + 4 <= num; i += 4)
+    {
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            const Type v = src[i + lane];
+            mn[lane] = v < mn[lane] ? v : mn[lane];
+            mx[lane] = mx[lane] < v ? v : mx[lane];
+        }
+    }
+    for (; i < num; ++i)
+    {
+        mn[0] = juce::jmin(mn[0], src[i]);
+        mx[0] = juce::jmax(mx[0], src[i]);
+    }
+
+    return { juce::jmin(mn[0], mn[1], mn[2], mn[3]), juce::jmax(mx[0], mx[1], mx[2], mx[3]) };
+}
+
+template <typename Type>
+Type PropertyColumn<Type>::getSum() const noexcept
+{
+    static_assert(std::is_arithmetic<Type>::value, "getSum() requires an arithmetic type");
+
+    const Type* src = values.data();
+    const int num = size();
+
+    // 浮動小数点数の加算は順序を入れ替えられないため、明示的に4本の和に分ける
+    Type sum[4] = {};
+
+    int i = 0;
+    for (; i + 4 <= num; i += 4)
+        for (int lane = 0; lane < 4; ++lane)
+            sum[lane] += src[i + lane];
+
+    for (; i < num; ++i)
+        sum[0] += src[i];
+
+    return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+template <typename Type>
+void PropertyColumn<Type>::setRealtimeReadEnabled(bool shouldBeEnabled)
+{
+    if (isRealtimeReadEnabled() == shouldBeEnabled) return;
+
+    // 読み出し中のスレッドがあり得るため、バッファは破棄せずに使い回す
+    if (shouldBeEnabled)
+    {
+        if (realtimeValues == nullptr)
+        {
+            realtimeValues = std::make_unique<RealtimeValue<std::vector<Type>>>(values);
+            publishedRealtimeValues.store(realtimeValues.get(), std::memory_order_release);
+        }
+        else
+            realtimeValues->store(values);
+    }
+    realtimeReadEnabled.store(shouldBeEnabled, std::memory_order_release);
+}
+
+template <typename Type>
+const std::vector<Type>& PropertyColumn<Type>::getRealtime() const noexcept
+{
+    // setRealtimeReadEnabled(true)を呼んでいない
+    jassert(isRealtimeReadEnabled());
+
+    // メッセージスレッドが書き換えるvaluesは読まず、最後に公開された値を返す
+    if (auto* published = publishedRealtimeValues.load(std::memory_order_acquire))
+        return published->load();
+
+    // 一度も有効化されていない場合は、書き込まれることの無い空の配列を返す
+    static const std::vector<Type> neverWritten;
+    return neverWritten;
+}
+
+//==============================================================================
+template <typename Type>
+void PropertyColumn<Type>::valueTreePropertyChanged(juce::ValueTree& changedTree, const juce::Identifier& changedProperty)
+{
+    if (changedProperty != targetProperty) return;
+    if (changedTree.getParent() != parentTree) return;
+
+    // ドラッグなどでは同じ要素への変更が続くため、前回の位置から確認する
+    int index = lastChangedIndex;
+    if (parentTree.getChild(index) != changedTree)
+        index = parentTree.indexOf(changedTree);
+    if (! juce::isPositiveAndBelow(index, size())) return;
+
+    values[(size_t)index] = readValue(changedTree);
+    lastChangedIndex = index;
+    updateRealtimeValues();
+}
+
+template <typename Type>
+void PropertyColumn<Type>::valueTreeChildAdded(juce::ValueTree& parent, juce::ValueTree& childWhichHasBeenAdded)
+{
+    if (parent != parentTree) return;
+
+    const int index = parent.indexOf(childWhichHasBeenAdded);
+    jassert(juce::isPositiveAndNotGreaterThan(index, size()));
+
+    values.insert(values.begin() + index, readValue(childWhichHasBeenAdded));
+    updateRealtimeValues();
+}
+
+template <typename Type>
+void PropertyColumn<Type>::valueTreeChildRemoved(juce::ValueTree& parent, juce::ValueTree& /*childWhichHasBeenRemoved*/, int indexFromWhichChildWasRemoved)
+{
+    if (parent != parentTree) return;
+    if (! juce::isPositiveAndBelow(indexFromWhichChildWasRemoved, size())) return;
+
+    values.erase(values.begin() + indexFromWhichChildWasRemoved);
+    updateRealtimeValues();
+}
+
+template <typename Type>
+void PropertyColumn<Type>::valueTreeChildOrderChanged(juce::ValueTree& parent, int oldIndex, int newIndex)
+{
+    if (parent != parentTree) return;
+    if (! juce::isPositiveAndBelow(oldIndex, size()) || ! juce::isPositiveAndBelow(newIndex, size())) return;
+
+    // 間の要素をずらして移動する
+    auto first = values.begin();
+    if (oldIndex < newIndex)
+        std::rotate(first + oldIndex, first + oldIndex + 1, first + newIndex + 1);
+    else
+        std::rotate(first + newIndex, first + oldIndex, first + oldIndex + 1);
+
+    updateRealtimeValues();
+}
+
+template <typename Type>
+void PropertyColumn<Type>::valueTreeRedirected(juce::ValueTree& treeWhichHasBeenChanged)
+{
+    if (treeWhichHasBeenChanged == parentTree)
+        rebuild();
+}
+
+//==============================================================================
+template <typename Type>
+void PropertyColumn<Type>::rebuild()
+{
+    const int numChildren = parentTree.getNumChildren();
+    values.clear();
+    values.reserve((size_t)numChildren);
+
+    for (auto child : parentTree)
+    {
+        WrappedTree::loadIfNeeded(child);
+        values.push_back(readValue(child));
+    }
+
+    updateRealtimeValues();
+}
+
+template <typename Type>
+Type PropertyColumn<Type>::readValue(const juce::ValueTree& child) const
+{
+    auto* value = child.getPropertyPointer(targetProperty);
+    return value != nullptr ? juce::VariantConverter<Type>::fromVar(*value) : defaultValue;
+}
+
+template <typename Type>
+void PropertyColumn<Type>::updateRealtimeValues()
+{
+    if (isRealtimeReadEnabled())
+        realtimeValues->store(values);
+}
+
+} // namespace vtwrapper
@@ -0,0 +1,159 @@
+/*
+  ==============================================================================
+
+    PropertyDispatcher.cpp
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#include "PropertyDispatcher.h"
+
+namespace vtwrapper
+{
+
+thread_local PropertyDispatcher* PropertyDispatcher::activeDispatcher = nullptr;
+
+//==============================================================================
+PropertyDispatcher::ScopedActivation::ScopedActivation(PropertyDispatcher& dispatcherToActivate)
+: previous(activeDispatcher)
+{
+    activeDispatcher = &dispatcherToActivate;
+}
+
+PropertyDispatcher::ScopedActivation::~ScopedActivation()
+{
+    activeDispatcher = previous;
+}
+
+//==============================================================================
+PropertyDispatcher::~PropertyDispatcher()
+{
+    detach();
+}
+
+void PropertyDispatcher::attachTo(const juce::ValueTree& tree)
+{
+    if (valueTree == tree) return;
+    
+    detach();
+    valueTree = tree;
+    ListenerRegistrar::add(valueTree, this);
+}
+
+void PropertyDispatcher::detach()
+{
+    ListenerRegistrar::remove(valueTree, this);
+    detachClients();
+    valueTree = juce::ValueTree();
+}
+
+void PropertyDispatcher::addClient(const juce::Identifier& property, Client* client)
+{
+    jassert(client != nullptr);
+    
+    if (clients[property].addIfNotAlreadyThere(client))
+        ++numClients;
+}
+
+void PropertyDispatcher::removeClient(const juce::Identifier& property, Client* client)
+{
+    auto it = clients.find(property);
+    if (it == clients.end()) return;
+    
+    auto& array = it->second;
+    int index = array.indexOf(client);
+    if (index < 0) return;
+    
+    array.remove(index);
+    --numClients;
+    
+    if (array.isEmpty())
+        clients.erase(it);
+    
+    for (auto* list : { &pendingClients, &flushingClients })
+    {
+        int pendingIndex = list->indexOf(client);
+        if (pendingIndex >= 0)
+            list->setUnchecked(pendingIndex, nullptr);
+    }
+}
+
+//==============================================================================
+void PropertyDispatcher::endTransaction(juce::UndoManager* um, const juce::String& transactionName)
+{
+    jassert(transactionDepth > 0);
+    if (--transactionDepth > 0) return;
+    if (pendingClients.isEmpty()) return;
+    
+    // 保留していた書き込みをひとつのUndoトランザクションとして反映する。
+    // 反映中の変更通知は保留されるため、反映中に新たに保留されたClientも同じリストに追加される
+    {
+        juce::ScopedValueSetter<bool> svs(isCommitting, true);
+        
+        if (um != nullptr)
+            um->beginNewTransaction(transactionName);
+        
+        for (int i = 0; i < pendingClients.size(); ++i)
+            if (auto* client = pendingClients.getUnchecked(i))
+                client->commitPendingValue();
+    }
+    
+    // 全ての書き込みが反映された後に変更通知を行う
+    flushingClients.swapWith(pendingClients);
+    pendingClients.clearQuick();
+    
+    for (int i = 0; i < flushingClients.size(); ++i)
+        if (auto* client = flushingClients.getUnchecked(i))
+            client->flushDeferredChange();
+    
+    flushingClients.clearQuick();
+}
+
+void PropertyDispatcher::addPendingClient(Client* client)
+{
+    jassert(isInTransaction());
+    pendingClients.add(client);
+}
+
+PropertyDispatcher* PropertyDispatcher::findActive(const juce::ValueTree& tree) noexcept // static
+{
+    if (activeDispatcher != nullptr && tree.isValid() && activeDispatcher->valueTree == tree)
+        return activeDispatcher;
+    
+    return nullptr;
+}
+
+//==============================================================================
+void PropertyDispatcher::valueTreePropertyChanged(juce::ValueTree& changedTree, const juce::Identifier& changedProperty)
+{
+    VTWRAPPER_INSTRUMENT_SCOPE(propertyChanged, "PropertyDispatcher", changedTree.getType(), changedProperty);
+
+    // 子孫のプロパティ変更も通知されるため、対象のValueTree以外は無視する
+    if (changedTree != valueTree) return;
+    
+    // 通知中にClientの追加削除が行われる可能性があるため、毎回テーブルを引き直す
+    for (int i = 0;; ++i)
+    {
+        auto it = clients.find(changedProperty);
+        if (it == clients.end() || i >= it->second.size()) break;
+        
+        it->second.getUnchecked(i)->dispatchedPropertyChanged();
+    }
+}
+
+void PropertyDispatcher::detachClients()
+{
+    auto detachedClients = std::move(clients);
+    clients.clear();
+    numClients = 0;
+    
+    pendingClients.fill(nullptr);
+    flushingClients.fill(nullptr);
+    
+    for (auto& pair : detachedClients)
+        for (auto* client : pair.second)
+            client->dispatcherDetached();
+}
+
+} // namespace vtwrapper
@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    PropertyDispatcher.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+#include <unordered_map>
+#include "Hash.h"
+#include "Instrumentation.h"
+#include "ListenerRegistrar.h"
+
+namespace vtwrapper
+{
+
+//==============================================================================
+/**
+ @brief ひとつのjuce::ValueTreeに紐付いた複数のWrappedPropertyへプロパティ変更を振り分けるクラス
+ - WrappedPropertyごとにjuce::ValueTree::Listenerを登録すると,ひとつのプロパティ変更で全てのWrappedPropertyが呼び出されてしまうため、 @n
+ リスナー登録をこのクラスに集約し,プロパティIDをキーとしたハッシュテーブルから通知先を引くことでO(1)で振り分ける。
+ - WrappedTreeが保持しており,WrappedTree::wrap()中のみアクティブになる。 @n
+ アクティブな間に同じjuce::ValueTreeへreferTo()したWrappedPropertyは自動的にこのクラスを経由して通知を受け取る。
+ - beginTransaction()〜endTransaction()の間は書き込みおよび変更通知を保留し、終了時に一括で反映する。(WrappedTree::ScopedTransactionを参照)
+ - メッセージスレッドでの使用を想定している
+ */
+class PropertyDispatcher
+: private juce::ValueTree::Listener
+{
+public:
+    //! @brief PropertyDispatcherから通知を受け取る側のインターフェース
+    class Client
+    {
+    public:
+        virtual ~Client() = default;
+        
+        //! 登録したプロパティが変更された時に呼ばれる
+        virtual void dispatchedPropertyChanged() = 0;
+        
+        //! PropertyDispatcherが別のValueTreeに紐付けられた、もしくは破棄される時に呼ばれる。
+        //! 以降は通知されないため、必要に応じて自身でリスナー登録を行う
+        virtual void dispatcherDetached() = 0;
+        
+        //! トランザクション終了時、保留していた書き込みをValueTreeに反映するために呼ばれる
+        virtual void commitPendingValue() {}
+        
+        //! トランザクション終了時、全ての書き込みが反映された後に保留していた変更通知を行うために呼ばれる
+        virtual void flushDeferredChange() {}
+    };
+    
+    //==============================================================================
+    //! @brief スコープの間,指定したPropertyDispatcherをアクティブにする
+    class ScopedActivation
+    {
+    public:
+        explicit ScopedActivation(PropertyDispatcher& dispatcherToActivate);
+        ~ScopedActivation();
+        
+    private:
+        PropertyDispatcher* previous;
+        JUCE_DECLARE_NON_COPYABLE(ScopedActivation)
+    };
+    
+    //==============================================================================
+    PropertyDispatcher() = default;
+    ~PropertyDispatcher() override;
+    
+    //! @brief 対象のjuce::ValueTreeを設定する。
+    //! 既に別のValueTreeに紐付いていた場合は、登録済みのClientを全て切り離す
+    void attachTo(const juce::ValueTree& tree);
+    
+    //! @brief 登録済みのClientを全て切り離し、リスナー登録を解除する
+    void detach();
+    
+    void addClient(const juce::Identifier& property, Client* client);
+    void removeClient(const juce::Identifier& property, Client* client);
+    int getNumClients() const noexcept { return numClients; }
+    
+    const juce::ValueTree& getValueTree() const noexcept { return valueTree; }
+    
+    //==============================================================================
+    //! @brief トランザクションを開始する。入れ子にすることが可能で、最も外側のendTransaction()で反映される
+    void beginTransaction() noexcept { ++transactionDepth; }
+    
+    //! @brief トランザクションを終了し、保留中のClientに書き込み・変更通知を行わせる
+    //! @param um 書き込みをひとつのUndoトランザクションにまとめるためのUndoManager。nullptrの場合はまとめない
+    void endTransaction(juce::UndoManager* um, const juce::String& transactionName = {});
+    
+    //! @brief 変更通知を保留するべき状態か(トランザクション中もしくは反映中)
+    bool isInTransaction() const noexcept { return transactionDepth > 0 || isCommitting; }
+    
+    //! @brief 書き込みを保留するべき状態か
+    bool shouldDeferWrites() const noexcept { return transactionDepth > 0 && ! isCommitting; }
+    
+    //! @brief トランザクション終了時にcommitPendingValue()およびflushDeferredChange()を呼ぶ対象として登録する
+    void addPendingClient(Client* client);
+    
+    //==============================================================================
+    //! @brief setPropertyExcludingListener()で除外対象に指定するためのリスナー
+    juce::ValueTree::Listener* getListener() noexcept { return this; }
+    
+    //! @brief 現在のスレッドでアクティブなPropertyDispatcherのうち、treeを対象とするものを返す。無ければnullptr
+    static PropertyDispatcher* findActive(const juce::ValueTree& tree) noexcept;
+    
+private:
+    void valueTreePropertyChanged(juce::ValueTree& changedTree, const juce::Identifier& changedProperty) override;
+    void detachClients();
+    
+    juce::ValueTree valueTree;
+    std::unordered_map<juce::Identifier, juce::Array<Client*>, IdentifierHash> clients;
+    int numClients = 0;
+    
+    // 反映中にClientが削除される可能性があるため、削除時は要素をnullptrに置き換える
+    juce::Array<Client*> pendingClients;
+    juce::Array<Client*> flushingClients;
+    int transactionDepth = 0;
+    bool isCommitting = false;
+    
+    static thread_local PropertyDispatcher* activeDispatcher;
+    
+    JUCE_DECLARE_NON_COPYABLE(PropertyDispatcher)
+};
+
+} // namespace vtwrapper
@@ -0,0 +1,251 @@
+/*
+  ==============================================================================
+
+    PropertySchema.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+#include <array>
+#include <tuple>
+#include "Constrainer.h"
+#include "WrappedProperty.h"
+
+namespace vtwrapper
+{
+
+//==============================================================================
+//! @brief PropertySchemaのひとつのプロパティの定義。型と制限処理はテンプレート引数、名前・デフォルト値・制限処理の値は集成体初期化で指定する
+template <typename Type, typename ConstrainerType = NoConstrainer<Type>, typename CallbackType = std::function<void()>>
+struct PropertyDef
+{
+    using ValueType = Type;
+    using WrapperType = WrappedProperty<Type, ConstrainerType, CallbackType>;
+
+    const char* name;
+    Type defaultValue {};
+    ConstrainerType constrainer {};
+};
+
+//==============================================================================
+/**
+ @brief WrappedTreeのプロパティを型として宣言し、紐付け・検証・シリアライズを行うクラス
+ - 各プロパティの型・制限処理はPropertyDefのテンプレート引数として、コンパイル時に決まる。 @n
+ Propertiesはその型のWrappedPropertyをstd::tupleとして保持する。
+ - juce::Identifierはスキーマの構築時に一度だけ作成される。 @n
+ wrapPropertiesAndChildren()で文字列からjuce::Identifierを作成する場合と異なり、bind()では文字列のプールへの問い合わせが行われない。
+ - デフォルト値は構築時に制限処理を適用した値となる。制限処理は最初のbind()でWrappedPropertyに設定される。
+ - validate()、writeValues()、readValues()も同じ定義から行われる。 @n
+ writeValues()はプロパティ名を含まず定義の順に値のみを書き出す。定義の末尾にプロパティを追加した場合は、古いデータの読み込みが可能。
+ - スキーマは通常、関数内のstatic変数として一度だけ構築し、全てのインスタンスで共有する。
+
+ @code
+ class TrackTree : public WrappedTree
+ {
+ public:
+     using Schema = PropertySchema<PropertyDef<float, RangeConstrainer<float>>,
+                                   PropertyDef<juce::String, MaxLengthConstrainer>>;
+     enum { gain, name };
+
+     static const Schema& getSchema()
+     {
+         static const Schema schema { { "gain", 1.0f, { 0.0f, 2.0f } },
+                                      { "name", "untitled", MaxLengthConstrainer(32) } };
+         return schema;
+     }
+
+     void wrapPropertiesAndChildren() override { getSchema().bind(properties, valueTree, undoManager); }
+
+     Schema::Properties properties; // properties.get<gain>().set(0.5f);
+ };
+ @endcode
+ */
+template <typename... Defs>
+class PropertySchema
+{
+public:
+    static constexpr size_t numProperties = sizeof...(Defs);
+
+    //! @brief スキーマから生成される、型付きのWrappedPropertyの組
+    class Properties
+    {
+    public:
+        template <size_t index> auto& get() noexcept { return std::get<index>(wrappers); }
+        template <size_t index> const auto& get() const noexcept { return std::get<index>(wrappers); }
+
+        //! @brief 全てのWrappedPropertyに対してfunction(wrappedProperty)を呼び出す
+        template <typename Function>
+        void forEach(Function&& function) { std::apply([&](auto&... w) { (function(w), ...); }, wrappers); }
+
+    private:
+        std::tuple<typename Defs::WrapperType...> wrappers;
+    };
+
+    explicit PropertySchema(Defs... definitionsToUse)
+    : definitions(std::move(definitionsToUse)...)
+    {
+        forEachDefinition([this](size_t i, const auto& def) { ids[i] = def.name; });
+        constrainDefaults(std::index_sequence_for<Defs...>());
+    }
+
+    //==============================================================================
+    //! @brief propertiesをtreeのプロパティに紐付ける。WrappedTree::wrapPropertiesAndChildren()から呼び出す
+    void bind(Properties& properties, juce::ValueTree& tree, juce::UndoManager* um) const
+    {
+        bindAll(properties, tree, um, std::index_sequence_for<Defs...>());
+    }
+
+    template <size_t index> const auto& getDefinition() const noexcept { return std::get<index>(definitions); }
+    template <size_t index> const juce::Identifier& getID() const noexcept { return ids[index]; }
+    const juce::Identifier& getID(size_t index) const noexcept { return ids[index]; }
+    const std::array<juce::Identifier, numProperties>& getIDs() const noexcept { return ids; }
+
+    //! @brief プロパティのインデックス。定義されていない場合は-1
+    int indexOf(const juce::Identifier& property) const noexcept
+    {
+        for (size_t i = 0; i < numProperties; ++i)
+            if (ids[i] == property)
+                return (int)i;
+        return -1;
+    }
+
+    //==============================================================================
+    //! @brief 全てのプロパティをデフォルト値で持つjuce::ValueTreeを作成する
+    juce::ValueTree createDefaultTree(const juce::Identifier& type) const
+    {
+        juce::ValueTree tree(type);
+        forEachDefinition([&](size_t i, const auto& def)
+        {
+            tree.setProperty(ids[i], toVar(def, def.defaultValue), nullptr);
+        });
+        return tree;
+    }
+
+    //! @brief treeのプロパティが定義を満たしているか検証し、問題をメッセージとして返す。問題が無ければ空
+    //! @param requireAllProperties 定義されたプロパティが無い場合も問題とする
+    //! @param allowUnknownProperties 定義されていないプロパティを許容する
+    juce::StringArray validate(const juce::ValueTree& tree, bool requireAllProperties = false, bool allowUnknownProperties = true) const
+    {
+        juce::StringArray problems;
+
+        forEachDefinition([&](size_t i, const auto& def)
+        {
+            const auto* value = tree.getPropertyPointer(ids[i]);
+            if (value == nullptr)
+            {
+                if (requireAllProperties)
+                    problems.add("missing property: " + ids[i].toString());
+                return;
+            }
+
+            // 制限処理により値が変わる場合は範囲外とする
+            if (def.constrainer)
+            {
+                const auto original = fromVar(def, *value);
+                auto constrained = original;
+                def.constrainer(constrained, false);
+                if (! (constrained == original))
+                    problems.add("constraint violated: " + ids[i].toString() + " = " + value->toString());
+            }
+        });
+
+        if (! allowUnknownProperties)
+            for (int i = 0; i < tree.getNumProperties(); ++i)
+                if (indexOf(tree.getPropertyName(i)) < 0)
+                    problems.add("unknown property: " + tree.getPropertyName(i).toString());
+
+        return problems;
+    }
+
+    //! @brief 定義されたプロパティの値のみを定義の順に書き出す。持たないプロパティはvoidとして書き出す
+    void writeValues(const juce::ValueTree& tree, juce::OutputStream& output) const
+    {
+        output.writeCompressedInt((int)numProperties);
+        for (const auto& id : ids)
+        {
+            const auto* value = tree.getPropertyPointer(id);
+            (value != nullptr ? *value : juce::var()).writeToStream(output);
+        }
+    }
+
+    //! @brief writeValues()で書き出した値をtreeに設定する。voidの値はプロパティを削除する
+    //! @return 読み込めた場合true
+    bool readValues(juce::ValueTree& tree, juce::InputStream& input, juce::UndoManager* um) const
+    {
+        const int numStored = input.readCompressedInt();
+        if (numStored < 0) return false;
+
+        for (int i = 0; i < numStored; ++i)
+        {
+            if (input.isExhausted()) return false;
+            const auto value = juce::var::readFromStream(input);
+
+            // 新しい定義で書き出されたデータの末尾のプロパティは読み飛ばす
+            if (i >= (int)numProperties) continue;
+
+            if (value.isVoid())
+                tree.removeProperty(ids[(size_t)i], um);
+            else
+                tree.setProperty(ids[(size_t)i], value, um);
+        }
+        return true;
+    }
+
+private:
+    template <size_t... index>
+    void bindAll(Properties& properties, juce::ValueTree& tree, juce::UndoManager* um, std::index_sequence<index...>) const
+    {
+        (bindProperty(properties.template get<index>(), std::get<index>(definitions), ids[index], tree, um), ...);
+    }
+
+    template <typename WrapperType, typename Def>
+    static void bindProperty(WrapperType& property, const Def& def, const juce::Identifier& id, juce::ValueTree& tree, juce::UndoManager* um)
+    {
+        // 再度のbind()では同じ制限処理が設定済みのため、紐付け前の場合のみ設定する
+        if (! property.isValid() && def.constrainer)
+            property.setConstrainer(def.constrainer);
+
+        property.referTo(tree, id, um, def.defaultValue);
+    }
+
+    template <size_t... index>
+    void constrainDefaults(std::index_sequence<index...>)
+    {
+        (constrainDefault(std::get<index>(definitions)), ...);
+    }
+
+    template <typename Def>
+    static void constrainDefault(Def& def)
+    {
+        if (def.constrainer)
+            def.constrainer(def.defaultValue, true);
+    }
+
+    template <typename Function>
+    void forEachDefinition(Function&& function) const
+    {
+        forEachDefinitionImpl(function, std::index_sequence_for<Defs...>());
+    }
+
+    template <typename Function, size_t... index>
+    void forEachDefinitionImpl(Function& function, std::index_sequence<index...>) const
+    {
+        (function(index, std::get<index>(definitions)), ...);
+    }
+
+    template <typename Def>
+    static juce::var toVar(const Def&, const typename Def::ValueType& value) { return juce::VariantConverter<typename Def::ValueType>::toVar(value); }
+
+    template <typename Def>
+    static typename Def::ValueType fromVar(const Def&, const juce::var& value) { return juce::VariantConverter<typename Def::ValueType>::fromVar(value); }
+
+    std::tuple<Defs...> definitions;
+    std::array<juce::Identifier, numProperties> ids;
+
+    JUCE_DECLARE_NON_COPYABLE(PropertySchema)
+};
+
+} // namespace vtwrapper
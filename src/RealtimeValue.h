@@ -0,0 +1,96 @@
+/*
+  ==============================================================================
+
+    RealtimeValue.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+#include <atomic>
+
+namespace vtwrapper
+{
+
+//! @brief std::atomic<Type>がロックフリーで扱える型かどうか
+//! trivially copyableでない型ではstd::atomic<Type>自体をインスタンス化できないため、特殊化で判定する
+template <typename Type, bool = std::is_trivially_copyable<Type>::value>
+struct IsLockFreeAtomicCompatible : std::false_type {};
+
+template <typename Type>
+struct IsLockFreeAtomicCompatible<Type, true> : std::integral_constant<bool, std::atomic<Type>::is_always_lock_free> {};
+
+//==============================================================================
+/**
+ @brief メッセージスレッドで書き込み、オーディオスレッド等のリアルタイムスレッドから読み出すための値
+ - 書き込み側・読み出し側それぞれひとつのスレッドから使用する想定
+ - 読み出しはwait-freeかつメモリ確保を行わない
+ - ロックフリーなstd::atomicで扱える型ではstd::atomicを、それ以外の型ではトリプルバッファを使用する
+ */
+template <typename Type, bool useAtomic = IsLockFreeAtomicCompatible<Type>::value>
+class RealtimeValue;
+
+//! @brief std::atomicによる実装
+template <typename Type>
+class RealtimeValue<Type, true>
+{
+public:
+    using ReadType = Type;
+    
+    explicit RealtimeValue(const Type& initialValue) : value(initialValue) {}
+    
+    //! 書き込み側スレッドから呼び出す
+    void store(const Type& newValue) noexcept { value.store(newValue, std::memory_order_release); }
+    
+    //! 読み出し側スレッドから呼び出す
+    ReadType load() const noexcept { return value.load(std::memory_order_acquire); }
+    
+private:
+    std::atomic<Type> value;
+    
+    JUCE_DECLARE_NON_COPYABLE(RealtimeValue)
+};
+
+//! @brief トリプルバッファによる実装
+//! 書き込み側は書き込み用バッファに値をコピーした後に中間バッファと交換し、 @n
+//! 読み出し側は更新があった場合のみ中間バッファと読み出し用バッファを交換するため、互いに同じバッファへ同時にアクセスすることはない。
+template <typename Type>
+class RealtimeValue<Type, false>
+{
+public:
+    //! 読み出し用バッファへの参照を返す。参照は同じスレッドで次にload()を呼ぶまで有効
+    using ReadType = const Type&;
+    
+    explicit RealtimeValue(const Type& initialValue) : buffers { initialValue, initialValue, initialValue } {}
+    
+    //! 書き込み側スレッドから呼び出す。値のコピーおよび古い値の破棄は書き込み側スレッドで行われる
+    void store(const Type& newValue)
+    {
+        buffers[writeIndex] = newValue;
+        writeIndex = middle.exchange(writeIndex | dirtyFlag, std::memory_order_acq_rel) & indexMask;
+    }
+    
+    //! 読み出し側スレッドから呼び出す
+    ReadType load() const noexcept
+    {
+        if ((middle.load(std::memory_order_relaxed) & dirtyFlag) != 0)
+            readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & indexMask;
+        
+        return buffers[readIndex];
+    }
+    
+private:
+    static constexpr int indexMask = 0x3;
+    static constexpr int dirtyFlag = 0x4;
+    
+    Type buffers[3];
+    int writeIndex = 0;
+    mutable std::atomic<int> middle { 1 };
+    mutable int readIndex = 2;
+    
+    JUCE_DECLARE_NON_COPYABLE(RealtimeValue)
+};
+
+} // namespace vtwrapper
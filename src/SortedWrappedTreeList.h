@@ -0,0 +1,311 @@
+/*
+  ==============================================================================
+
+    SortedWrappedTreeList.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+#include "ValueTreeObjectList.h"
+
+namespace vtwrapper
+{
+
+//==============================================================================
+/**
+ @brief 指定したプロパティの値で子ValueTreeを比較するSortedWrappedTreeList用の比較クラス
+ - 文字列同士は文字列として、それ以外は数値として比較する。プロパティを持たない要素は先頭に並ぶ。
+ - juce::ValueTree::sort()の比較クラスとしても使用可能
+ */
+class PropertyComparator
+{
+public:
+    explicit PropertyComparator(const juce::Identifier& sortKey = {}, bool shouldSortDescending = false)
+    : key(sortKey), descending(shouldSortDescending) {}
+
+    int compareElements(const juce::ValueTree& first, const juce::ValueTree& second) const
+    {
+        return compareValues(first.getPropertyPointer(key), second.getPropertyPointer(key));
+    }
+
+    //! @brief 要素のプロパティの値とkeyValueを比較する。SortedWrappedTreeList::lowerBound()などでキーを直接指定する場合に用いる
+    int compareWithKey(const juce::ValueTree& element, const juce::var& keyValue) const
+    {
+        return compareValues(element.getPropertyPointer(key), &keyValue);
+    }
+
+    const juce::Identifier& getKey() const noexcept { return key; }
+
+private:
+    int compareValues(const juce::var* first, const juce::var* second) const
+    {
+        const int result = compareAscending(first, second);
+        return descending ? -result : result;
+    }
+
+    static int compareAscending(const juce::var* first, const juce::var* second)
+    {
+        const bool hasFirst = first != nullptr && ! first->isVoid();
+        const bool hasSecond = second != nullptr && ! second->isVoid();
+        if (! hasFirst || ! hasSecond) return (int)hasFirst - (int)hasSecond;
+
+        if (first->isString() && second->isString())
+            return first->toString().compare(second->toString());
+
+        const double a = *first, b = *second;
+        return a < b ? -1 : (b < a ? 1 : 0);
+    }
+
+    juce::Identifier key;
+    bool descending;
+};
+
+//==============================================================================
+/**
+ @brief 子要素を常に比較クラスの順に保つWrappedTreeList
+ - WrappedTreeList::sort()は呼び出すたびに全体を並べ替えるが、このクラスでは変更のあった要素のみを二分探索で求めた位置へ移動する。
+ - add()では挿入位置を二分探索で求める。子ValueTreeのプロパティが変更された場合は前後の要素と比較し、順序が崩れた場合のみ移動する。
+ - 比較結果が等しい要素は追加・変更された順に後ろへ並ぶ。
+ - wrap()時に並んでいない場合は一度だけ全体を並べ替える。
+ - undo/redo中は記録済みの移動操作により順序が戻るため、移動を行わない。 @n
+ そのためキーとなるプロパティの変更と移動は同じUndoManagerに記録される必要があり、UndoCoalescerでまとめる変更には用いない。
+ - Comparatorは juce::ValueTree::sort() と同じく int compareElements(const juce::ValueTree&, const juce::ValueTree&) を持つ必要がある。 @n
+ キーを直接指定するlowerBound()などを用いる場合は int compareWithKey(const juce::ValueTree&, const KeyType&) も必要となる。(PropertyComparatorを参照)
+ - 並び順を崩すためWrappedTreeListのinsertAt()およびsort()は使用できない。
+
+ @code
+ SortedWrappedTreeList<EventTree> events(PropertyComparator("time"));
+ events.wrap(timeline, "timeline", "event", &undoManager);
+
+ events.add(new EventTree(...));          // timeの順に挿入される
+ events[3]->time.set(120.0);              // 変更された要素のみ移動する
+ auto visible = events.getRange(start, end); // start <= time < end の要素のインデックスの範囲
+ @endcode
+ */
+template <typename WrappedTreeType, typename Comparator = PropertyComparator, typename Allocator = PooledAllocator<WrappedTreeType>>
+class SortedWrappedTreeList
+: public WrappedTreeList<WrappedTreeType, Allocator>
+{
+public:
+    using Base = WrappedTreeList<WrappedTreeType, Allocator>;
+
+    explicit SortedWrappedTreeList(Comparator comparatorToUse = {}) : comparator(std::move(comparatorToUse)) {}
+
+    void wrap(const juce::ValueTree& targetTree, const juce::Identifier& targetParentType, const juce::Identifier& targetChildType, juce::UndoManager* um, bool allowCreationIfInvalid = true, bool allowChildWrapping = true);
+
+    //! @brief 比較クラスを変更し、全体を並べ替える
+    void setComparator(Comparator newComparator);
+    const Comparator& getComparator() const noexcept { return comparator; }
+
+    //! @brief 並び順の位置に要素を追加する
+    WrappedTreeType* add(WrappedTreeType* t);
+    //! @brief 複数の要素をそれぞれ並び順の位置に追加する
+    //! @n WrappedTreeList::addRange()と同様に、追加できない要素が含まれる場合は何も追加せずにfalseを返す
+    bool addRange(const juce::Array<WrappedTreeType*>& itemsToAdd);
+
+    //! @brief probe以上となる最初の要素のインデックス。無ければsize()
+    int lowerBound(const juce::ValueTree& probe) const { return findBound([&](const juce::ValueTree& vt) { return comparator.compareElements(vt, probe) < 0; }); }
+    //! @brief probeより大きくなる最初の要素のインデックス。無ければsize()
+    int upperBound(const juce::ValueTree& probe) const { return findBound([&](const juce::ValueTree& vt) { return comparator.compareElements(vt, probe) <= 0; }); }
+
+    //! @brief キーがkeyValue以上となる最初の要素のインデックス。無ければsize()
+    template <typename KeyType>
+    int lowerBound(const KeyType& keyValue) const { return findBound([&](const juce::ValueTree& vt) { return comparator.compareWithKey(vt, keyValue) < 0; }); }
+    //! @brief キーがkeyValueより大きくなる最初の要素のインデックス。無ければsize()
+    template <typename KeyType>
+    int upperBound(const KeyType& keyValue) const { return findBound([&](const juce::ValueTree& vt) { return comparator.compareWithKey(vt, keyValue) <= 0; }); }
+
+    //! @brief キーがstartKey以上、endKey未満となる要素のインデックスの範囲
+    template <typename KeyType>
+    juce::Range<int> getRange(const KeyType& startKey, const KeyType& endKey) const
+    {
+        const int start = lowerBound(startKey);
+        return { start, juce::jmax(start, lowerBound(endKey)) };
+    }
+
+    //! @brief 全ての要素が並び順になっているか
+    bool isSorted() const;
+
+protected:
+    void valueTreeChildAdded(juce::ValueTree& parent, juce::ValueTree& childWhichHasBeenAdded) override;
+    void valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged, const juce::Identifier& property) override;
+
+private:
+    // 並び順を崩す操作は使用しない
+    using Base::insertAt;
+    using Base::sort;
+
+    //! 遅延読み込みされたノードはプロパティを持たないため、比較の前に読み込む
+    juce::ValueTree getChildTree(int index) const;
+    int compareChildren(int firstIndex, int secondIndex) const { return comparator.compareElements(getChildTree(firstIndex), getChildTree(secondIndex)); }
+
+    //! [0, size())のうちisBefore(要素)がtrueとなる範囲の末尾を二分探索で求める
+    template <typename PredicateType>
+    int findBound(PredicateType&& isBefore) const { return findBound(0, this->size(), isBefore); }
+    template <typename PredicateType>
+    int findBound(int start, int end, PredicateType&& isBefore) const;
+
+    //! indexの要素が前後の要素と順序が崩れている場合のみ、並び順の位置へ移動する
+    void moveToSortedPosition(int index);
+    void sortAll();
+    bool isPerformingUndoRedo() { auto* um = this->getUndoManager(); return um != nullptr && um->isPerformingUndoRedo(); }
+
+    mutable Comparator comparator;
+};
+
+//==============================================================================
+// implementation
+//==============================================================================
+template <typename WrappedTreeType, typename Comparator, typename Allocator>
+void SortedWrappedTreeList<WrappedTreeType, Comparator, Allocator>::wrap(const juce::ValueTree& targetTree, const juce::Identifier& targetParentType, const juce::Identifier& targetChildType, juce::UndoManager* um, bool allowCreationIfInvalid, bool allowChildWrapping)
+{
+    Base::wrap(targetTree, targetParentType, targetChildType, um, allowCreationIfInvalid, allowChildWrapping);
+
+    if (! isSorted())
+        sortAll();
+}
+
+template <typename WrappedTreeType, typename Comparator, typename Allocator>
+void SortedWrappedTreeList<WrappedTreeType, Comparator, Allocator>::setComparator(Comparator newComparator)
+{
+    comparator = std::move(newComparator);
+
+    if (this->isValid() && ! isSorted())
+        sortAll();
+}
+
+template <typename WrappedTreeType, typename Comparator, typename Allocator>
+WrappedTreeType* SortedWrappedTreeList<WrappedTreeType, Comparator, Allocator>::add(WrappedTreeType* t)
+{
+    if (t == nullptr)
+    {
+        jassertfalse;
+        return nullptr;
+    }
+
+    const int index = t->isValid() ? upperBound(t->getValueTree()) : this->size();
+    if (this->insert(index, t) == nullptr)
+        return nullptr;
+
+    // 初期化前の要素は挿入時のwrap()でプロパティが書き込まれるため、挿入後に位置を合わせる
+    moveToSortedPosition(index);
+
+    return t;
+}
+
+template <typename WrappedTreeType, typename Comparator, typename Allocator>
+bool SortedWrappedTreeList<WrappedTreeType, Comparator, Allocator>::addRange(const juce::Array<WrappedTreeType*>& itemsToAdd)
+{
+    if (itemsToAdd.isEmpty()) return true;
+
+    if (! this->isValid() || ! this->canInsertAll(itemsToAdd))
+    {
+        jassertfalse;
+        return false;
+    }
+
+    if (auto* um = this->getUndoManager())
+        um->beginNewTransaction();
+
+    bool allAdded = true;
+    for (auto* t : itemsToAdd)
+        allAdded = (add(t) != nullptr) && allAdded;
+
+    return allAdded;
+}
+
+template <typename WrappedTreeType, typename Comparator, typename Allocator>
+bool SortedWrappedTreeList<WrappedTreeType, Comparator, Allocator>::isSorted() const
+{
+    for (int i = 1; i < this->size(); ++i)
+        if (compareChildren(i - 1, i) > 0)
+            return false;
+
+    return true;
+}
+
+//==============================================================================
+template <typename WrappedTreeType, typename Comparator, typename Allocator>
+void SortedWrappedTreeList<WrappedTreeType, Comparator, Allocator>::valueTreeChildAdded(juce::ValueTree& parent, juce::ValueTree& childWhichHasBeenAdded)
+{
+    Base::valueTreeChildAdded(parent, childWhichHasBeenAdded);
+
+    // 外部から追加された場合
+    if (this->isHandlingOwnChange() || parent != this->getValueTree() || isPerformingUndoRedo()) return;
+
+    moveToSortedPosition(parent.indexOf(childWhichHasBeenAdded));
+}
+
+template <typename WrappedTreeType, typename Comparator, typename Allocator>
+void SortedWrappedTreeList<WrappedTreeType, Comparator, Allocator>::valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged, const juce::Identifier& property)
+{
+    Base::valueTreePropertyChanged(treeWhosePropertyHasChanged, property);
+
+    if (this->isHandlingOwnChange() || isPerformingUndoRedo()) return;
+    if (treeWhosePropertyHasChanged.getParent() != this->getValueTree()) return;
+
+    moveToSortedPosition(this->getValueTree().indexOf(treeWhosePropertyHasChanged));
+}
+
+//==============================================================================
+template <typename WrappedTreeType, typename Comparator, typename Allocator>
+juce::ValueTree SortedWrappedTreeList<WrappedTreeType, Comparator, Allocator>::getChildTree(int index) const
+{
+    auto vt = this->getValueTree().getChild(index);
+    WrappedTree::loadIfNeeded(vt);
+    return vt;
+}
+
+template <typename WrappedTreeType, typename Comparator, typename Allocator>
+template <typename PredicateType>
+int SortedWrappedTreeList<WrappedTreeType, Comparator, Allocator>::findBound(int start, int end, PredicateType&& isBefore) const
+{
+    while (start < end)
+    {
+        const int middle = start + (end - start) / 2;
+
+        if (isBefore(getChildTree(middle)))
+            start = middle + 1;
+        else
+            end = middle;
+    }
+    return start;
+}
+
+template <typename WrappedTreeType, typename Comparator, typename Allocator>
+void SortedWrappedTreeList<WrappedTreeType, Comparator, Allocator>::moveToSortedPosition(int index)
+{
+    const int numChildren = this->size();
+    if (! juce::isPositiveAndBelow(index, numChildren)) return;
+
+    const auto child = getChildTree(index);
+    auto isNotAfterChild = [&](const juce::ValueTree& vt) { return comparator.compareElements(vt, child) <= 0; };
+
+    int newIndex = index;
+
+    // 前の要素より小さくなった場合は前方へ、後の要素より大きくなった場合は後方へ移動する
+    if (index > 0 && compareChildren(index - 1, index) > 0)
+        newIndex = findBound(0, index, isNotAfterChild);
+    else if (index < numChildren - 1 && compareChildren(index, index + 1) > 0)
+        newIndex = findBound(index + 1, numChildren, isNotAfterChild) - 1;
+
+    if (newIndex == index) return;
+
+    auto vt = this->getValueTree();
+    vt.moveChild(index, newIndex, this->getUndoManager());
+}
+
+template <typename WrappedTreeType, typename Comparator, typename Allocator>
+void SortedWrappedTreeList<WrappedTreeType, Comparator, Allocator>::sortAll()
+{
+    for (int i = 0; i < this->size(); ++i)
+        getChildTree(i);
+
+    auto vt = this->getValueTree();
+    vt.sort(comparator, this->getUndoManager(), true);
+}
+
+} // namespace vtwrapper
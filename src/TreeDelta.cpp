@@ -0,0 +1,347 @@
+/*
+  ==============================================================================
+
+    TreeDelta.cpp
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#include "TreeDelta.h"
+#include <limits>
+#include "MappedSession.h"
+
+namespace vtwrapper
+{
+
+/*
+ [形式]
+ 各差分: 種類(1バイト), 経路(階層数, 各階層の子のインデックス), 種類ごとの内容
+ - setProperty: Identifier, 値
+ - removeProperty: Identifier
+ - addChild: 追加位置, 部分木
+ - removeChild: 削除位置
+ - moveChild: 移動前の位置, 移動後の位置
+ Identifier: 既出の場合は(出現順のインデックス + 1)、初出の場合は0の後にUTF-8文字列
+ 部分木: TypeのIdentifier, プロパティ数, 各プロパティの(Identifier, 値), 子の数, 各子の部分木
+ 値の形式はBinaryTreeFormatと同じ
+ */
+namespace
+{
+enum DeltaType : juce::uint8
+{
+    setPropertyDelta = 0,
+    removePropertyDelta,
+    addChildDelta,
+    removeChildDelta,
+    moveChildDelta
+};
+
+//==============================================================================
+class DeltaReader
+{
+public:
+    DeltaReader(const void* data, size_t numBytes, juce::Array<juce::Identifier>& identifierTable)
+    : decoder(data, numBytes), identifiers(identifierTable) {}
+
+    bool applyAll(juce::ValueTree& target, juce::UndoManager* um)
+    {
+        while (decoder.getNumBytesRemaining() > 0)
+            if (! applyNext(target, um))
+                return false;
+
+        return true;
+    }
+
+private:
+    bool applyNext(juce::ValueTree& target, juce::UndoManager* um)
+    {
+        const auto deltaType = decoder.readByte();
+
+        auto tree = readPath(target);
+        if (! tree.isValid()) return false;
+
+        switch (deltaType)
+        {
+            case setPropertyDelta:
+            {
+                const auto name = readIdentifier();
+                auto value = decoder.readValue();
+                if (decoder.hasFailed()) return false;
+
+                tree.setProperty(name, std::move(value), um);
+                return true;
+            }
+            case removePropertyDelta:
+            {
+                const auto name = readIdentifier();
+                if (decoder.hasFailed()) return false;
+
+                tree.removeProperty(name, um);
+                return true;
+            }
+            case addChildDelta:
+            {
+                const auto index = readIndex();
+                auto child = readTree(0);
+                if (decoder.hasFailed() || index > tree.getNumChildren()) return false;
+
+                tree.addChild(child, index, um);
+                return true;
+            }
+            case removeChildDelta:
+            {
+                const auto index = readIndex();
+                if (decoder.hasFailed() || index >= tree.getNumChildren()) return false;
+
+                tree.removeChild(index, um);
+                return true;
+            }
+            case moveChildDelta:
+            {
+                const auto oldIndex = readIndex();
+                const auto newIndex = readIndex();
+                if (decoder.hasFailed() || oldIndex >= tree.getNumChildren() || newIndex >= tree.getNumChildren()) return false;
+
+                tree.moveChild(oldIndex, newIndex, um);
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    juce::ValueTree readPath(const juce::ValueTree& target)
+    {
+        auto tree = target;
+        MappedSession::ensureLoaded(tree);
+
+        const auto depth = decoder.readVarint();
+        for (juce::uint64 i = 0; i < depth && tree.isValid(); ++i)
+        {
+            const auto index = readIndex();
+            if (decoder.hasFailed()) return {};
+
+            tree = tree.getChild(index);
+            MappedSession::ensureLoaded(tree);
+        }
+        return decoder.hasFailed() ? juce::ValueTree() : tree;
+    }
+
+    juce::ValueTree readTree(int depth)
+    {
+        if (depth > BinaryDecoder::maxTreeDepth)
+        {
+            decoder.fail();
+            return {};
+        }
+
+        const auto type = readIdentifier();
+        if (decoder.hasFailed()) return {};
+
+        juce::ValueTree tree(type);
+
+        const auto numProperties = decoder.readVarint();
+        for (juce::uint64 i = 0; i < numProperties && ! decoder.hasFailed(); ++i)
+        {
+            const auto name = readIdentifier();
+            auto value = decoder.readValue();
+            if (! decoder.hasFailed())
+                tree.setProperty(name, std::move(value), nullptr);
+        }
+
+        const auto numChildren = decoder.readVarint();
+        for (juce::uint64 i = 0; i < numChildren && ! decoder.hasFailed(); ++i)
+        {
+            auto child = readTree(depth + 1);
+            if (! decoder.hasFailed())
+                tree.appendChild(child, nullptr);
+        }
+        return tree;
+    }
+
+    juce::Identifier readIdentifier()
+    {
+        const auto v = decoder.readVarint();
+        if (decoder.hasFailed()) return {};
+
+        if (v == 0)
+        {
+            auto name = decoder.readString();
+            if (decoder.hasFailed() || name.isEmpty())
+            {
+                decoder.fail();
+                return {};
+            }
+            identifiers.add(juce::Identifier(name));
+            return identifiers.getLast();
+        }
+
+        if (v > (juce::uint64)identifiers.size())
+        {
+            decoder.fail();
+            return {};
+        }
+        return identifiers.getReference((int)(v - 1));
+    }
+
+    int readIndex()
+    {
+        const auto v = decoder.readVarint();
+        if (v > (juce::uint64)std::numeric_limits<int>::max())
+        {
+            decoder.fail();
+            return 0;
+        }
+        return (int)v;
+    }
+
+    BinaryDecoder decoder;
+    juce::Array<juce::Identifier>& identifiers;
+};
+}
+
+//==============================================================================
+DeltaRecorder::~DeltaRecorder()
+{
+    root.removeListener(this);
+}
+
+void DeltaRecorder::setRoot(const juce::ValueTree& rootTree)
+{
+    root.removeListener(this);
+
+    root = rootTree;
+    pending.clear();
+    numPendingDeltas = 0;
+    identifierIndices.clear();
+
+    root.addListener(this);
+}
+
+juce::MemoryBlock DeltaRecorder::takePendingDeltas()
+{
+    juce::MemoryBlock block(pending.getData(), pending.getSize());
+    pending.clear();
+    numPendingDeltas = 0;
+    return block;
+}
+
+//==============================================================================
+void DeltaRecorder::valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged, const juce::Identifier& property)
+{
+    if (MappedSession::isLoading()) return;
+
+    // 削除された場合もプロパティの変更として通知されるため、値の有無で区別する
+    auto* value = treeWhosePropertyHasChanged.getPropertyPointer(property);
+
+    if (! beginDelta(value != nullptr ? setPropertyDelta : removePropertyDelta, treeWhosePropertyHasChanged))
+        return;
+
+    writeIdentifier(property);
+    if (value != nullptr)
+        pending.writeValue(*value);
+}
+
+void DeltaRecorder::valueTreeChildAdded(juce::ValueTree& parentTree, juce::ValueTree& childWhichHasBeenAdded)
+{
+    if (MappedSession::isLoading()) return;
+
+    // 部分木の内容を全て書き込むため、読み込まれていないノードを先に読み込む
+    MappedSession::ensureLoadedRecursively(childWhichHasBeenAdded);
+
+    if (! beginDelta(addChildDelta, parentTree))
+        return;
+
+    pending.writeVarint((juce::uint64)parentTree.indexOf(childWhichHasBeenAdded));
+    writeTree(childWhichHasBeenAdded);
+}
+
+void DeltaRecorder::valueTreeChildRemoved(juce::ValueTree& parentTree, juce::ValueTree&, int indexFromWhichChildWasRemoved)
+{
+    if (MappedSession::isLoading()) return;
+
+    if (! beginDelta(removeChildDelta, parentTree))
+        return;
+
+    pending.writeVarint((juce::uint64)indexFromWhichChildWasRemoved);
+}
+
+void DeltaRecorder::valueTreeChildOrderChanged(juce::ValueTree& parentTreeWhoseChildrenHaveMoved, int oldIndex, int newIndex)
+{
+    if (MappedSession::isLoading()) return;
+
+    if (! beginDelta(moveChildDelta, parentTreeWhoseChildrenHaveMoved))
+        return;
+
+    pending.writeVarint((juce::uint64)oldIndex);
+    pending.writeVarint((juce::uint64)newIndex);
+}
+
+//==============================================================================
+bool DeltaRecorder::beginDelta(juce::uint8 deltaType, const juce::ValueTree& tree)
+{
+    // 対象からrootまでの各階層でのインデックスを求める
+    juce::Array<int> path;
+    for (auto t = tree; t != root; )
+    {
+        auto parent = t.getParent();
+        if (! parent.isValid()) return false;
+
+        path.add(parent.indexOf(t));
+        t = parent;
+    }
+
+    pending.writeByte(deltaType);
+    pending.writeVarint((juce::uint64)path.size());
+    for (int i = path.size(); --i >= 0;)
+        pending.writeVarint((juce::uint64)path.getUnchecked(i));
+
+    ++numPendingDeltas;
+    return true;
+}
+
+void DeltaRecorder::writeIdentifier(const juce::Identifier& id)
+{
+    auto it = identifierIndices.find(id);
+    if (it != identifierIndices.end())
+    {
+        pending.writeVarint(it->second + 1);
+        return;
+    }
+
+    identifierIndices.emplace(id, (juce::uint64)identifierIndices.size());
+    pending.writeVarint(0);
+    pending.writeString(id.toString());
+}
+
+void DeltaRecorder::writeTree(const juce::ValueTree& tree)
+{
+    writeIdentifier(tree.getType());
+
+    const int numProperties = tree.getNumProperties();
+    pending.writeVarint((juce::uint64)numProperties);
+    for (int i = 0; i < numProperties; ++i)
+    {
+        const auto name = tree.getPropertyName(i);
+        writeIdentifier(name);
+        pending.writeValue(tree[name]);
+    }
+
+    pending.writeVarint((juce::uint64)tree.getNumChildren());
+    for (const auto& child : tree)
+        writeTree(child);
+}
+
+//==============================================================================
+bool DeltaPlayer::apply(juce::ValueTree& target, const void* data, size_t numBytes, juce::UndoManager* um)
+{
+    if (! target.isValid())
+    {
+        jassertfalse;
+        return false;
+    }
+    return DeltaReader(data, numBytes, identifiers).applyAll(target, um);
+}
+
+} // namespace vtwrapper
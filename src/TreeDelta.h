@@ -0,0 +1,102 @@
+/*
+  ==============================================================================
+
+    TreeDelta.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+#include <unordered_map>
+#include "BinaryCoding.h"
+#include "Hash.h"
+#include "WrappedTree.h"
+
+namespace vtwrapper
+{
+
+//==============================================================================
+/**
+ @brief juce::ValueTreeの部分木への変更を、順序付きの差分としてバイナリ形式で記録するクラス
+ - 対象のルートをリッスンし、プロパティの設定・削除、子の追加・削除・移動を発生順に記録する。
+ - 各差分はルートからの子のインデックスの経路で対象を示すため、DeltaPlayerで同じ状態のValueTreeに適用すると同じ変更が再現される。
+ - Identifierは最初に現れた時にのみ文字列として書き込み、以降は出現順のインデックスで示す。 @n
+ そのためtakePendingDeltas()で取り出したデータは、取り出した順に同じDeltaPlayerへ適用する必要がある。
+ - MappedSessionのプレースホルダの読み込みによる変更は記録しない。
+
+ @code
+ DeltaRecorder recorder(project);
+ ...
+ journal.write(recorder.takePendingDeltas()); // 自動保存では全体を書き込まずに差分のみを追記する
+
+ // 復元側
+ DeltaPlayer player;
+ player.apply(restoredTree, journalData.getData(), journalData.getSize());
+ @endcode
+ */
+class DeltaRecorder
+: private juce::ValueTree::Listener
+{
+public:
+    DeltaRecorder() = default;
+    explicit DeltaRecorder(const juce::ValueTree& rootTree) { setRoot(rootTree); }
+    explicit DeltaRecorder(const WrappedTree& rootTree) { setRoot(rootTree.getValueTree()); }
+    ~DeltaRecorder() override;
+
+    //! @brief 記録する対象の部分木を設定する。記録済みの差分およびIdentifierの対応は破棄される
+    void setRoot(const juce::ValueTree& rootTree);
+    const juce::ValueTree& getRoot() const noexcept { return root; }
+
+    //! @brief 前回のtakePendingDeltas()以降に記録した差分を取り出す
+    juce::MemoryBlock takePendingDeltas();
+
+    //! @brief 前回のtakePendingDeltas()以降に記録した差分の数
+    int getNumPendingDeltas() const noexcept { return numPendingDeltas; }
+
+    //! @brief 前回のtakePendingDeltas()以降に記録した差分のバイト数
+    size_t getPendingSize() const noexcept { return pending.getSize(); }
+
+private:
+    void valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged, const juce::Identifier& property) override;
+    void valueTreeChildAdded(juce::ValueTree& parentTree, juce::ValueTree& childWhichHasBeenAdded) override;
+    void valueTreeChildRemoved(juce::ValueTree& parentTree, juce::ValueTree& childWhichHasBeenRemoved, int indexFromWhichChildWasRemoved) override;
+    void valueTreeChildOrderChanged(juce::ValueTree& parentTreeWhoseChildrenHaveMoved, int oldIndex, int newIndex) override;
+
+    //! 種類とtreeのルートからの経路を書き込む。treeが対象の部分木に含まれない場合は何も書き込まずfalseを返す
+    bool beginDelta(juce::uint8 deltaType, const juce::ValueTree& tree);
+    void writeIdentifier(const juce::Identifier& id);
+    void writeTree(const juce::ValueTree& tree);
+
+    juce::ValueTree root;
+    BinaryEncoder pending;
+    int numPendingDeltas = 0;
+    std::unordered_map<juce::Identifier, juce::uint64, IdentifierHash> identifierIndices;
+
+    JUCE_DECLARE_NON_COPYABLE(DeltaRecorder)
+};
+
+//==============================================================================
+/**
+ @brief DeltaRecorderで記録した差分をjuce::ValueTreeに適用するクラス
+ - 記録開始時と同じ状態のValueTreeに対して、取り出した順に適用する。
+ - Identifierの対応を保持するため、ひとつのDeltaRecorderに対してひとつのDeltaPlayerを用いる。
+ */
+class DeltaPlayer
+{
+public:
+    //! @brief dataに含まれる差分を順にtargetへ適用する
+    //! @n 不正なデータや対象と一致しない差分を検出した場合はその時点で中断しfalseを返す。それ以前の差分は適用済みとなる
+    //! 追加する部分木の深さがBinaryDecoder::maxTreeDepthを超える場合も不正なデータとして扱う
+    bool apply(juce::ValueTree& target, const void* data, size_t numBytes, juce::UndoManager* um = nullptr);
+    bool apply(juce::ValueTree& target, const juce::MemoryBlock& deltas, juce::UndoManager* um = nullptr) { return apply(target, deltas.getData(), deltas.getSize(), um); }
+
+    //! @brief Identifierの対応を破棄する。DeltaRecorder::setRoot()で記録をやり直した場合に呼び出す
+    void reset() { identifiers.clearQuick(); }
+
+private:
+    juce::Array<juce::Identifier> identifiers;
+};
+
+} // namespace vtwrapper
@@ -0,0 +1,340 @@
+/*
+  ==============================================================================
+
+    TreeIndex.cpp
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#include "TreeIndex.h"
+#include "ListenerRegistrar.h"
+#include <limits>
+
+namespace vtwrapper
+{
+
+//==============================================================================
+struct TreeIndex::Node
+{
+    juce::ValueTree tree;
+    Node* parent = nullptr;
+    NodeKey key;
+    
+    // 索引の更新用に保持する。順序はValueTreeの子の順序とは一致しない
+    std::vector<std::unique_ptr<Node>> children;
+    size_t indexInParent = 0;
+    
+    // 同じキーを持つノードの連結リスト。索引には先頭のノードのみを登録する
+    Node* previousSameKey = nullptr;
+    Node* nextSameKey = nullptr;
+    
+    Registration* registration = nullptr;
+};
+
+//==============================================================================
+bool TreeIndex::Registration::registerTo(TreeIndex& index, WrappedTree& wrapperToRegister)
+{
+    reset();
+    
+    auto* target = index.findNode(wrapperToRegister.getValueTree());
+    if (target == nullptr) return false;
+    
+    // ひとつのノードに紐付けられるのはひとつのみ
+    if (target->registration != nullptr)
+        target->registration->reset();
+    
+    node = target;
+    wrapper = &wrapperToRegister;
+    node->registration = this;
+    return true;
+}
+
+void TreeIndex::Registration::reset() noexcept
+{
+    if (node != nullptr)
+        node->registration = nullptr;
+    
+    node = nullptr;
+    wrapper = nullptr;
+}
+
+//==============================================================================
+TreeIndex::TreeIndex() = default;
+
+TreeIndex::TreeIndex(const juce::ValueTree& root, const juce::Identifier& keyProperty)
+{
+    attachTo(root, keyProperty);
+}
+
+TreeIndex::~TreeIndex()
+{
+    detach();
+}
+
+void TreeIndex::attachTo(const juce::ValueTree& root, const juce::Identifier& keyProperty)
+{
+    jassert(root.isValid());
+    jassert(keyProperty.isValid());
+    
+    detach();
+    rootTree = root;
+    keyId = keyProperty;
+    
+    rootNode = std::make_unique<Node>();
+    rootNode->tree = rootTree;
+    numNodes = 1;
+    
+    for (const auto& child : rootTree)
+        addSubtree(*rootNode, child);
+    
+    ListenerRegistrar::add(rootTree, this);
+}
+
+void TreeIndex::detach()
+{
+    ListenerRegistrar::remove(rootTree, this);
+    clear();
+    rootTree = juce::ValueTree();
+}
+
+juce::ValueTree TreeIndex::findChild(const juce::ValueTree& parent, const juce::Identifier& type, const juce::var& key) const
+{
+    auto* parentNode = findNode(parent);
+    if (parentNode == nullptr) return {};
+    
+    return getTree(lookup(makeKey(parentNode, type, key), {}));
+}
+
+//==============================================================================
+void TreeIndex::valueTreePropertyChanged(juce::ValueTree& changedTree, const juce::Identifier& property)
+{
+    if (property != keyId || changedTree == rootTree) return;
+    
+    // キーが変わったノードは新しいキーでは引けないため、親の子から探す
+    auto* parentNode = findNode(changedTree.getParent());
+    if (parentNode == nullptr) return;
+    
+    for (auto& child : parentNode->children)
+    {
+        if (child->tree != changedTree) continue;
+        
+        unlinkFromKeys(*child);
+        child->key = makeKey(parentNode, changedTree);
+        linkToKeys(*child);
+        return;
+    }
+}
+
+void TreeIndex::valueTreeChildAdded(juce::ValueTree& parent, juce::ValueTree& child)
+{
+    if (auto* parentNode = findNode(parent))
+        addSubtree(*parentNode, child);
+}
+
+void TreeIndex::valueTreeChildRemoved(juce::ValueTree& parent, juce::ValueTree& child, int /*index*/)
+{
+    auto* parentNode = findNode(parent);
+    if (parentNode == nullptr) return;
+    
+    if (auto* node = lookup(makeKey(parentNode, child), child))
+        removeSubtree(*node);
+}
+
+void TreeIndex::valueTreeRedirected(juce::ValueTree& treeWhichHasBeenChanged)
+{
+    if (treeWhichHasBeenChanged != rootTree) return;
+    
+    auto newRoot = treeWhichHasBeenChanged;
+    const auto keyProperty = keyId;
+    attachTo(newRoot, keyProperty);
+}
+
+//==============================================================================
+TreeIndex::NodeKey TreeIndex::makeKey(const Node* parent, const juce::ValueTree& tree) const
+{
+    const auto* keyValue = tree.getPropertyPointer(keyId);
+    return { parent, tree.getType(), keyValue != nullptr ? keyValue->toString() : juce::String(), keyValue != nullptr };
+}
+
+TreeIndex::NodeKey TreeIndex::makeKey(const Node* parent, const juce::Identifier& type, const juce::var& key) // static
+{
+    return { parent, type, key.isVoid() ? juce::String() : key.toString(), ! key.isVoid() };
+}
+
+void TreeIndex::addSubtree(Node& parent, const juce::ValueTree& tree)
+{
+    auto node = std::make_unique<Node>();
+    node->tree = tree;
+    node->parent = &parent;
+    node->key = makeKey(&parent, tree);
+    node->indexInParent = parent.children.size();
+    linkToKeys(*node);
+    
+    auto& added = *node;
+    parent.children.push_back(std::move(node));
+    
+    for (const auto& child : tree)
+        addSubtree(added, child);
+}
+
+void TreeIndex::removeSubtree(Node& node)
+{
+    unlinkSubtree(node);
+    
+    // 親の配列から末尾との入れ替えで取り除く
+    auto& siblings = node.parent->children;
+    const auto index = node.indexInParent;
+    if (index + 1 != siblings.size())
+    {
+        std::swap(siblings[index], siblings.back());
+        siblings[index]->indexInParent = index;
+    }
+    siblings.pop_back();
+}
+
+void TreeIndex::unlinkSubtree(Node& node)
+{
+    for (auto& child : node.children)
+        unlinkSubtree(*child);
+    
+    unlinkFromKeys(node);
+    
+    if (node.registration != nullptr)
+        node.registration->reset();
+}
+
+void TreeIndex::linkToKeys(Node& node)
+{
+    auto result = nodesByKey.emplace(node.key, &node);
+    ++numNodes;
+    if (result.second) return;
+    
+    // 既に同じキーのノードがある場合は先頭の後ろに繋ぐ
+    auto* head = result.first->second;
+    node.previousSameKey = head;
+    node.nextSameKey = head->nextSameKey;
+    if (head->nextSameKey != nullptr)
+        head->nextSameKey->previousSameKey = &node;
+    head->nextSameKey = &node;
+}
+
+void TreeIndex::unlinkFromKeys(Node& node)
+{
+    if (node.previousSameKey != nullptr)
+    {
+        node.previousSameKey->nextSameKey = node.nextSameKey;
+    }
+    else
+    {
+        auto it = nodesByKey.find(node.key);
+        jassert(it != nodesByKey.end() && it->second == &node);
+        
+        if (node.nextSameKey != nullptr)
+            it->second = node.nextSameKey;
+        else
+            nodesByKey.erase(it);
+    }
+    
+    if (node.nextSameKey != nullptr)
+        node.nextSameKey->previousSameKey = node.previousSameKey;
+    
+    node.previousSameKey = node.nextSameKey = nullptr;
+    --numNodes;
+}
+
+void TreeIndex::resetRegistrations(Node& node) // static
+{
+    for (auto& child : node.children)
+        resetRegistrations(*child);
+    
+    if (node.registration != nullptr)
+        node.registration->reset();
+}
+
+void TreeIndex::clear()
+{
+    if (rootNode != nullptr)
+        resetRegistrations(*rootNode);
+    
+    nodesByKey.clear();
+    rootNode = nullptr;
+    numNodes = 0;
+}
+
+//==============================================================================
+TreeIndex::Node* TreeIndex::lookup(const NodeKey& key, const juce::ValueTree& tree) const
+{
+    auto it = nodesByKey.find(key);
+    if (it == nodesByKey.end()) return nullptr;
+    
+    auto* head = it->second;
+    
+    // 同じ経路を持つノードがひとつの場合
+    if (head->nextSameKey == nullptr)
+        return ! tree.isValid() || head->tree == tree ? head : nullptr;
+    
+    if (tree.isValid())
+    {
+        for (auto* node = head; node != nullptr; node = node->nextSameKey)
+            if (node->tree == tree)
+                return node;
+        return nullptr;
+    }
+    
+    // 複数ある場合はValueTreeの順で最初のもの
+    Node* first = nullptr;
+    int firstIndex = std::numeric_limits<int>::max();
+    for (auto* node = head; node != nullptr; node = node->nextSameKey)
+    {
+        const int index = node->parent->tree.indexOf(node->tree);
+        if (index < firstIndex)
+        {
+            first = node;
+            firstIndex = index;
+        }
+    }
+    return first;
+}
+
+TreeIndex::Node* TreeIndex::findNode(const juce::ValueTree& tree) const
+{
+    if (rootNode == nullptr || ! tree.isValid()) return nullptr;
+    if (tree == rootTree) return rootNode.get();
+    
+    // ルートまでの祖先を集め、ルート側から索引を引く
+    juce::Array<juce::ValueTree> ancestors;
+    for (auto t = tree; t != rootTree; t = t.getParent())
+    {
+        if (! t.isValid()) return nullptr;
+        ancestors.add(t);
+    }
+    
+    auto* node = rootNode.get();
+    for (int i = ancestors.size(); --i >= 0 && node != nullptr;)
+    {
+        const auto& ancestor = ancestors.getReference(i);
+        node = lookup(makeKey(node, ancestor), ancestor);
+    }
+    return node;
+}
+
+TreeIndex::Node* TreeIndex::findNode(const Step* begin, const Step* end) const
+{
+    auto* node = rootNode.get();
+    for (auto* step = begin; step != end && node != nullptr; ++step)
+        node = lookup(makeKey(node, step->type, step->key), {});
+    return node;
+}
+
+juce::ValueTree TreeIndex::getTree(const Node* node) // static
+{
+    return node != nullptr ? node->tree : juce::ValueTree();
+}
+
+WrappedTree* TreeIndex::getWrapper(const Node* node) noexcept // static
+{
+    return node != nullptr && node->registration != nullptr ? node->registration->wrapper : nullptr;
+}
+
+} // namespace vtwrapper
@@ -0,0 +1,195 @@
+/*
+  ==============================================================================
+
+    TreeIndex.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "Hash.h"
+#include "WrappedTree.h"
+
+namespace vtwrapper
+{
+
+//==============================================================================
+/**
+ @brief ルート以下の階層全体を、Typeとキーとなるプロパティの値の経路で引くための索引
+ - 例えば root → tracks → track[id] → plugins → plugin[id] のような深いノードを探す場合、 @n
+ getChildWithName()などによる各階層の線形探索の代わりに、階層ごとにハッシュテーブルを一度引くだけで見つけられる。
+ - 各ノードは 親ノード・Type・キー の組で索引に登録される。キーとなるプロパティを持たないノードは「キー無し」として登録される。 @n
+ Stepにキーを指定しない場合は、キー無しのノードが対象となる。(tracksやpluginsなど、ひとつしか無いノード)
+ - ルートに登録したjuce::ValueTree::Listenerで子の追加削除・キーの変更を受け取り、変更のあった部分木のみを更新する。 @n
+ 子の並べ替えでは更新は行わない。同じ経路を持つノードが複数ある場合のみ、探索時にValueTreeの順で最初のものを返す。
+ - findChild()などValueTreeから探す場合は、ルートまでの祖先を辿り各階層で索引を引く。(深さに比例し、兄弟の数には依存しない) @n
+ ただし同じType・キーを持つ兄弟が多い場合はそれらの数に比例する。
+ - Registrationにより各ノードにWrappedTreeを紐付けておくと、findWrapper()で経路から直接ラッパーを得られる。 @n
+ 紐付けはノードが削除されるか、Registrationが破棄されると解除される。
+ - キーはjuce::var::toString()による文字列として比較する。そのため型の異なる値でも文字列が同じであれば同じキーとなる。 @n
+ (例えば整数の3と文字列の"3"は区別されない。XMLなどから読み込んで文字列になった値も、元の型の値で引くことができる)
+ - 読み込まれていないMappedSessionのノード(プレースホルダ)は読み込みを行わず、Typeのみを持つ「キー無し」のノードとして登録される。 @n
+ そのため読み込まれるまではキーを指定したStepでは見つからず、キーを指定しないStepで見つかる場合がある。 @n
+ 読み込まれた時点で、キーの変更および子の追加として索引に反映される。必要な場合は先にMappedSession::ensureLoadedRecursively()を呼び出す。
+ - メッセージスレッドでの使用を想定している
+
+ @code
+ TreeIndex index(root, "id");
+ auto plugin = index.find({ { "tracks" }, { "track", 3 }, { "plugins" }, { "plugin", "eq" } });
+ @endcode
+ */
+class TreeIndex
+: private juce::ValueTree::Listener
+{
+public:
+    //! @brief 経路の一階層。keyがvoidの場合はキーとなるプロパティを持たないノードを対象とする
+    struct Step
+    {
+        Step(const juce::Identifier& typeToUse) : type(typeToUse) {}
+        Step(const char* typeToUse) : type(typeToUse) {}
+        Step(const juce::Identifier& typeToUse, const juce::var& keyToUse) : type(typeToUse), key(keyToUse) {}
+
+        juce::Identifier type;
+        juce::var key;
+    };
+
+    struct Node;
+
+    //==============================================================================
+    //! @brief 索引のノードにWrappedTreeを紐付ける。WrappedTreeのメンバとして保持し、wrapPropertiesAndChildren()でregisterTo()を呼び出す
+    //! @n 破棄時に紐付けは解除される。
+    class Registration
+    {
+    public:
+        Registration() = default;
+        ~Registration() { reset(); }
+
+        //! @brief wrapperのValueTreeに対応するノードに紐付ける。索引に含まれないValueTreeの場合は紐付けない
+        //! @return 紐付けられた場合true
+        bool registerTo(TreeIndex& index, WrappedTree& wrapper);
+
+        //! @brief 紐付けを解除する
+        void reset() noexcept;
+
+        bool isRegistered() const noexcept { return node != nullptr; }
+
+    private:
+        friend class TreeIndex;
+        Node* node = nullptr;
+        WrappedTree* wrapper = nullptr;
+
+        JUCE_DECLARE_NON_COPYABLE(Registration)
+    };
+
+    //==============================================================================
+    TreeIndex();
+    TreeIndex(const juce::ValueTree& root, const juce::Identifier& keyProperty);
+    ~TreeIndex() override;
+
+    //! @brief rootの部分木全体を索引に登録し、以降の変更を追跡する
+    //! @param keyProperty 兄弟の中でノードを識別するプロパティ(idなど)
+    void attachTo(const juce::ValueTree& root, const juce::Identifier& keyProperty);
+    void detach();
+
+    const juce::ValueTree& getRoot() const noexcept { return rootTree; }
+    const juce::Identifier& getKeyProperty() const noexcept { return keyId; }
+    int getNumNodes() const noexcept { return numNodes; }
+
+    //==============================================================================
+    //! @brief ルートからの経路でノードを探す。見つからない場合は無効なValueTree
+    juce::ValueTree find(std::initializer_list<Step> path) const { return getTree(findNode(path.begin(), path.end())); }
+    juce::ValueTree find(const juce::Array<Step>& path) const { return getTree(findNode(path.begin(), path.end())); }
+
+    //! @brief parentの子からtypeとkeyを持つものを探す。parentが索引に含まれない場合や、見つからない場合は無効なValueTree
+    juce::ValueTree findChild(const juce::ValueTree& parent, const juce::Identifier& type, const juce::var& key = {}) const;
+
+    //! @brief ルートからの経路で、Registrationで紐付けられたWrappedTreeを探す。見つからない場合や型が異なる場合はnullptr
+    template <typename WrappedTreeType>
+    WrappedTreeType* findWrapper(std::initializer_list<Step> path) const { return dynamic_cast<WrappedTreeType*>(getWrapper(findNode(path.begin(), path.end()))); }
+
+    template <typename WrappedTreeType>
+    WrappedTreeType* findWrapper(const juce::Array<Step>& path) const { return dynamic_cast<WrappedTreeType*>(getWrapper(findNode(path.begin(), path.end()))); }
+
+    //! @brief treeが索引に含まれているか
+    bool contains(const juce::ValueTree& tree) const { return findNode(tree) != nullptr; }
+
+private:
+    struct NodeKey
+    {
+        const Node* parent;
+        juce::Identifier type;
+        juce::String key;
+        bool hasKey;
+
+        bool operator==(const NodeKey& other) const noexcept
+        {
+            return parent == other.parent && type == other.type && hasKey == other.hasKey && key == other.key;
+        }
+    };
+
+    struct NodeKeyHash
+    {
+        size_t operator()(const NodeKey& k) const noexcept
+        {
+            size_t h = std::hash<const void*>()(k.parent);
+            h = h * 31 + IdentifierHash()(k.type);
+            return k.hasKey ? h * 31 + StringHash()(k.key) : h;
+        }
+    };
+
+    void valueTreePropertyChanged(juce::ValueTree& changedTree, const juce::Identifier& property) override;
+    void valueTreeChildAdded(juce::ValueTree& parent, juce::ValueTree& child) override;
+    void valueTreeChildRemoved(juce::ValueTree& parent, juce::ValueTree& child, int index) override;
+    void valueTreeRedirected(juce::ValueTree& treeWhichHasBeenChanged) override;
+
+    NodeKey makeKey(const Node* parent, const juce::ValueTree& tree) const;
+    static NodeKey makeKey(const Node* parent, const juce::Identifier& type, const juce::var& key);
+
+    void addSubtree(Node& parent, const juce::ValueTree& tree);
+    void removeSubtree(Node& node);
+    void unlinkSubtree(Node& node);
+    void linkToKeys(Node& node);
+    void unlinkFromKeys(Node& node);
+    static void resetRegistrations(Node& node);
+    void clear();
+
+    //! keyに一致するノードのうち、treeと同じもの。treeが無効な場合はValueTreeの順で最初のもの
+    Node* lookup(const NodeKey& key, const juce::ValueTree& tree) const;
+    Node* findNode(const juce::ValueTree& tree) const;
+    Node* findNode(const Step* begin, const Step* end) const;
+
+    static juce::ValueTree getTree(const Node* node);
+    static WrappedTree* getWrapper(const Node* node) noexcept;
+
+    juce::ValueTree rootTree;
+    juce::Identifier keyId;
+    std::unique_ptr<Node> rootNode;
+    std::unordered_map<NodeKey, Node*, NodeKeyHash> nodesByKey;
+    int numNodes = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(TreeIndex)
+};
+
+//==============================================================================
+/**
+ @brief parentの子のうちtypeを持つものを索引から探し、UniquePtr::referTo()で参照する
+ - 子の線形探索を行わない点以外はptr.referTo(parent, type, um)と同様。
+ - 索引に見つからない場合(キーを持つ子や読み込まれていない子など)はparentを与えたreferTo()と同じ処理を行う。
+
+ @code
+ vtwrapper::referToIndexedChild(plugins, index, track, IDs::plugins, &undoManager);
+ @endcode
+ */
+template <typename PointerType>
+void referToIndexedChild(PointerType& ptr, const TreeIndex& index, const juce::ValueTree& parent, const juce::Identifier& type, juce::UndoManager* um)
+{
+    auto child = index.findChild(parent, type);
+    ptr.referTo(child.isValid() ? child : parent, type, um);
+}
+
+} // namespace vtwrapper
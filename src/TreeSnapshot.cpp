@@ -0,0 +1,224 @@
+/*
+  ==============================================================================
+
+    TreeSnapshot.cpp
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#include "TreeSnapshot.h"
+#include "MappedSession.h"
+
+namespace vtwrapper
+{
+
+namespace
+{
+//! Identifierはプールされた文字列のポインタで同一性が決まるため、そのアドレスで並べる
+const void* getAddress(const juce::Identifier& id) noexcept
+{
+    return id.getCharPointer().getAddress();
+}
+}
+
+//==============================================================================
+const juce::Identifier& TreeSnapshot::getPropertyName(int index) const noexcept
+{
+    jassert(juce::isPositiveAndBelow(index, getNumProperties()));
+    return properties[(size_t)index].name;
+}
+
+const juce::var* TreeSnapshot::getPropertyPointer(const juce::Identifier& name) const noexcept
+{
+    auto it = std::lower_bound(properties.begin(), properties.end(), getAddress(name),
+                               [](const Property& p, const void* address) { return getAddress(p.name) < address; });
+
+    if (it != properties.end() && it->name == name)
+        return &it->value;
+
+    return nullptr;
+}
+
+const juce::var& TreeSnapshot::operator[](const juce::Identifier& name) const noexcept
+{
+    static const juce::var nullValue;
+
+    auto* value = getPropertyPointer(name);
+    return value != nullptr ? *value : nullValue;
+}
+
+TreeSnapshot::Ptr TreeSnapshot::getChild(int index) const noexcept
+{
+    if (! juce::isPositiveAndBelow(index, getNumChildren()))
+        return nullptr;
+
+    return children[(size_t)index];
+}
+
+TreeSnapshot::Ptr TreeSnapshot::getChildWithName(const juce::Identifier& typeName) const noexcept
+{
+    for (auto& child : children)
+        if (child->hasType(typeName))
+            return child;
+
+    return nullptr;
+}
+
+//==============================================================================
+SnapshotBuilder::~SnapshotBuilder()
+{
+    root.removeListener(this);
+}
+
+void SnapshotBuilder::setRoot(const juce::ValueTree& rootTree)
+{
+    root.removeListener(this);
+
+    root = rootTree;
+    rootMirror = root.isValid() ? createMirror(root) : nullptr;
+
+    root.addListener(this);
+}
+
+TreeSnapshot::Ptr SnapshotBuilder::publish()
+{
+    if (rootMirror == nullptr)
+    {
+        // setRoot()で有効なValueTreeを設定していない
+        jassertfalse;
+        return nullptr;
+    }
+
+    if (rootMirror->snapshot == nullptr)
+        std::atomic_store(&latest, build(*rootMirror, root));
+
+    return rootMirror->snapshot;
+}
+
+TreeSnapshot::Ptr SnapshotBuilder::getLatest() const
+{
+    return std::atomic_load(&latest);
+}
+
+//==============================================================================
+void SnapshotBuilder::valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged, const juce::Identifier&)
+{
+    // 読み込みによる変更は、読み込みを行ったcreateMirror()の呼び出し元で反映される
+    if (MappedSession::isLoading()) return;
+
+    invalidatePathTo(treeWhosePropertyHasChanged);
+}
+
+void SnapshotBuilder::valueTreeChildAdded(juce::ValueTree& parentTree, juce::ValueTree& childWhichHasBeenAdded)
+{
+    if (MappedSession::isLoading()) return;
+
+    if (auto* mirror = invalidatePathTo(parentTree))
+    {
+        const int index = parentTree.indexOf(childWhichHasBeenAdded);
+        mirror->children.insert(mirror->children.begin() + index, createMirror(childWhichHasBeenAdded));
+    }
+}
+
+void SnapshotBuilder::valueTreeChildRemoved(juce::ValueTree& parentTree, juce::ValueTree&, int indexFromWhichChildWasRemoved)
+{
+    if (MappedSession::isLoading()) return;
+
+    if (auto* mirror = invalidatePathTo(parentTree))
+    {
+        jassert(juce::isPositiveAndBelow(indexFromWhichChildWasRemoved, (int)mirror->children.size()));
+        mirror->children.erase(mirror->children.begin() + indexFromWhichChildWasRemoved);
+    }
+}
+
+void SnapshotBuilder::valueTreeChildOrderChanged(juce::ValueTree& parentTreeWhoseChildrenHaveMoved, int oldIndex, int newIndex)
+{
+    if (MappedSession::isLoading()) return;
+
+    if (auto* mirror = invalidatePathTo(parentTreeWhoseChildrenHaveMoved))
+    {
+        auto& c = mirror->children;
+        auto moved = std::move(c[(size_t)oldIndex]);
+        c.erase(c.begin() + oldIndex);
+        c.insert(c.begin() + newIndex, std::move(moved));
+    }
+}
+
+void SnapshotBuilder::valueTreeRedirected(juce::ValueTree& treeWhichHasBeenChanged)
+{
+    if (treeWhichHasBeenChanged == root)
+        rootMirror = createMirror(root);
+}
+
+//==============================================================================
+SnapshotBuilder::MirrorNode* SnapshotBuilder::invalidatePathTo(const juce::ValueTree& tree)
+{
+    if (rootMirror == nullptr) return nullptr;
+
+    // 対象からrootまでの各階層でのインデックスを求める
+    juce::Array<int> path;
+    for (auto node = tree; node != root; )
+    {
+        auto parent = node.getParent();
+        if (! parent.isValid()) return nullptr;
+
+        path.add(parent.indexOf(node));
+        node = parent;
+    }
+
+    auto* mirror = rootMirror.get();
+    mirror->snapshot = nullptr;
+
+    for (int i = path.size(); --i >= 0;)
+    {
+        mirror = mirror->children[(size_t)path.getUnchecked(i)].get();
+        mirror->snapshot = nullptr;
+    }
+    return mirror;
+}
+
+std::unique_ptr<SnapshotBuilder::MirrorNode> SnapshotBuilder::createMirror(const juce::ValueTree& tree) // static
+{
+    // プレースホルダを通常のノードとしてスナップショットに含めないよう、子を辿る前に読み込む
+    MappedSession::ensureLoaded(tree);
+
+    auto mirror = std::make_unique<MirrorNode>();
+    mirror->children.reserve((size_t)tree.getNumChildren());
+
+    for (const auto& child : tree)
+        mirror->children.push_back(createMirror(child));
+
+    return mirror;
+}
+
+TreeSnapshot::Ptr SnapshotBuilder::build(MirrorNode& mirror, const juce::ValueTree& tree) // static
+{
+    if (mirror.snapshot != nullptr)
+        return mirror.snapshot;
+
+    std::shared_ptr<TreeSnapshot> snapshot(new TreeSnapshot());
+    snapshot->type = tree.getType();
+
+    const int numProperties = tree.getNumProperties();
+    snapshot->properties.reserve((size_t)numProperties);
+    for (int i = 0; i < numProperties; ++i)
+    {
+        // WrappedProperty::valueTreePropertyChanged()と同様に、名前ごとのプロパティの取得は一度だけ行う
+        const auto name = tree.getPropertyName(i);
+        if (const auto* value = tree.getPropertyPointer(name))
+            snapshot->properties.push_back({ name, *value });
+    }
+    std::sort(snapshot->properties.begin(), snapshot->properties.end(),
+              [](const TreeSnapshot::Property& a, const TreeSnapshot::Property& b) { return getAddress(a.name) < getAddress(b.name); });
+
+    jassert((int)mirror.children.size() == tree.getNumChildren());
+    snapshot->children.reserve(mirror.children.size());
+    for (size_t i = 0; i < mirror.children.size(); ++i)
+        snapshot->children.push_back(build(*mirror.children[i], tree.getChild((int)i)));
+
+    mirror.snapshot = snapshot;
+    return mirror.snapshot;
+}
+
+} // namespace vtwrapper
@@ -0,0 +1,159 @@
+/*
+  ==============================================================================
+
+    TreeSnapshot.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+#include <memory>
+#include <vector>
+#include "WrappedProperty.h"
+#include "WrappedTree.h"
+
+namespace vtwrapper
+{
+
+//==============================================================================
+/**
+ @brief juce::ValueTreeのある時点の内容を保持する不変なノード
+ - 作成後は変更されないため、任意のスレッドからロックを取らずに読み出すことが可能。
+ - SnapshotBuilderにより作成され、変更の無かった部分木は前回のスナップショットと共有される。
+ - プロパティの値はjuce::varとして保持するため、参照型(DynamicObjectなど)の値の中身はメッセージスレッドで変更しないこと。
+ */
+class TreeSnapshot
+{
+public:
+    using Ptr = std::shared_ptr<const TreeSnapshot>;
+
+    const juce::Identifier& getType() const noexcept { return type; }
+    bool hasType(const juce::Identifier& typeName) const noexcept { return type == typeName; }
+
+    int getNumProperties() const noexcept { return (int)properties.size(); }
+    const juce::Identifier& getPropertyName(int index) const noexcept;
+    bool hasProperty(const juce::Identifier& name) const noexcept { return getPropertyPointer(name) != nullptr; }
+
+    //! @brief プロパティの値へのポインタを返す。存在しない場合はnullptr
+    const juce::var* getPropertyPointer(const juce::Identifier& name) const noexcept;
+
+    //! @brief プロパティの値を返す。存在しない場合はvoidのjuce::var
+    const juce::var& operator[](const juce::Identifier& name) const noexcept;
+
+    //! @brief プロパティの値をType型として返す。存在しない場合はdefaultValue
+    template <typename Type>
+    Type getProperty(const juce::Identifier& name, const Type& defaultValue) const
+    {
+        auto* value = getPropertyPointer(name);
+        return value != nullptr ? juce::VariantConverter<Type>::fromVar(*value) : defaultValue;
+    }
+
+    //! @brief WrappedPropertyと同じプロパティIDおよびデフォルト値で値を取得する
+    //! @n 読み出し側スレッドからはpropertyのプロパティIDおよびデフォルト値のみを参照するため、 @n
+    //! スナップショットを読み出している間はメッセージスレッドでreferTo()やsetDefault()を呼ばないこと。
+    template <typename Type, typename ConstrainerType, typename CallbackType>
+    Type get(const WrappedProperty<Type, ConstrainerType, CallbackType>& property) const
+    {
+        return getProperty<Type>(property.getPropertyID(), property.getDefault());
+    }
+
+    int getNumChildren() const noexcept { return (int)children.size(); }
+
+    //! @brief 子ノードを返す。範囲外の場合はnullptr
+    Ptr getChild(int index) const noexcept;
+
+    //! @brief 指定したTypeを持つ最初の子ノードを返す。見つからない場合はnullptr
+    Ptr getChildWithName(const juce::Identifier& typeName) const noexcept;
+
+    const Ptr* begin() const noexcept { return children.data(); }
+    const Ptr* end() const noexcept { return children.data() + children.size(); }
+
+private:
+    friend class SnapshotBuilder;
+    TreeSnapshot() = default;
+
+    struct Property
+    {
+        juce::Identifier name;
+        juce::var value;
+    };
+
+    juce::Identifier type;
+    std::vector<Property> properties; // 二分探索のためIdentifierの文字列アドレス順に保持する
+    std::vector<Ptr> children;
+
+    JUCE_DECLARE_NON_COPYABLE(TreeSnapshot)
+};
+
+//==============================================================================
+/**
+ @brief juce::ValueTreeの部分木からTreeSnapshotを作成し、他のスレッドへ受け渡すクラス
+ - 対象のValueTreeをリッスンし、変更のあったノードとその祖先のみを次のpublish()で作り直す。 @n
+ 変更の無かった部分木は前回のスナップショットのノードをそのまま共有する。
+ - MappedSessionの読み込まれていないノードは、setRoot()時および子の追加時に部分木ごと読み込まれる。
+ - setRoot()およびpublish()はメッセージスレッドから、getLatest()は任意のスレッドから呼び出せる。
+ - 読み出し側のスレッドは取得したTreeSnapshot::Ptrを保持している間、その時点の内容を一貫して読み出せる。
+
+ @code
+ // メッセージスレッド
+ SnapshotBuilder builder(projectTree);
+ builder.publish(); // 編集後、必要なタイミングで呼び出す
+
+ // ワーカースレッド
+ if (auto snapshot = builder.getLatest())
+     auto gain = snapshot->get(projectTree.gain);
+ @endcode
+ */
+class SnapshotBuilder
+: private juce::ValueTree::Listener
+{
+public:
+    SnapshotBuilder() = default;
+    explicit SnapshotBuilder(const juce::ValueTree& rootTree) { setRoot(rootTree); }
+    explicit SnapshotBuilder(const WrappedTree& rootTree) { setRoot(rootTree.getValueTree()); }
+    ~SnapshotBuilder() override;
+
+    //! @brief スナップショットを作成する対象の部分木を設定する。次のpublish()では全体を作り直す
+    void setRoot(const juce::ValueTree& rootTree);
+    const juce::ValueTree& getRoot() const noexcept { return root; }
+
+    //! @brief 前回のpublish()以降に変更があった部分を作り直し、新しいスナップショットとして公開する
+    //! @n 変更が無い場合は前回と同じスナップショットを返す。メッセージスレッドから呼び出す
+    TreeSnapshot::Ptr publish();
+
+    //! @brief 最後に公開されたスナップショットを返す。まだ公開されていない場合はnullptr。任意のスレッドから呼び出せる
+    TreeSnapshot::Ptr getLatest() const;
+
+    //! @brief 前回のpublish()以降に変更があったかどうか
+    bool hasPendingChanges() const noexcept { return rootMirror == nullptr || rootMirror->snapshot == nullptr; }
+
+private:
+    //! ValueTreeと同じ構造を持ち、各ノードの最新のスナップショットを保持する。変更時は祖先まで破棄される
+    struct MirrorNode
+    {
+        TreeSnapshot::Ptr snapshot;
+        std::vector<std::unique_ptr<MirrorNode>> children;
+    };
+
+    void valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged, const juce::Identifier& property) override;
+    void valueTreeChildAdded(juce::ValueTree& parentTree, juce::ValueTree& childWhichHasBeenAdded) override;
+    void valueTreeChildRemoved(juce::ValueTree& parentTree, juce::ValueTree& childWhichHasBeenRemoved, int indexFromWhichChildWasRemoved) override;
+    void valueTreeChildOrderChanged(juce::ValueTree& parentTreeWhoseChildrenHaveMoved, int oldIndex, int newIndex) override;
+    void valueTreeRedirected(juce::ValueTree& treeWhichHasBeenChanged) override;
+
+    //! treeに対応するMirrorNodeを探し、その経路上のスナップショットを破棄する。対象の部分木に含まれない場合はnullptr
+    MirrorNode* invalidatePathTo(const juce::ValueTree& tree);
+
+    static std::unique_ptr<MirrorNode> createMirror(const juce::ValueTree& tree);
+    static TreeSnapshot::Ptr build(MirrorNode& mirror, const juce::ValueTree& tree);
+
+    juce::ValueTree root;
+    std::unique_ptr<MirrorNode> rootMirror;
+    TreeSnapshot::Ptr latest;
+
+    JUCE_DECLARE_NON_COPYABLE(SnapshotBuilder)
+};
+
+} // namespace vtwrapper
@@ -0,0 +1,248 @@
+/*
+  ==============================================================================
+
+    UndoCoalescer.cpp
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#include "UndoCoalescer.h"
+
+namespace vtwrapper
+{
+
+//==============================================================================
+//! まとめた変更を表す操作。登録時には既に最終値が書き込まれているため、perform()は実質何も行わない
+//! @n 時間によるまとめの間はownerと結び付き、取り消されるまで最終値を現在の値として扱う
+class UndoCoalescer::CoalescedPropertyAction
+: public juce::UndoableAction
+{
+public:
+    CoalescedPropertyAction(const juce::ValueTree& tree, const juce::Identifier& property,
+                            const juce::var& before, bool hadBefore, const juce::var& after, bool hasAfter)
+    : targetTree(tree), targetProperty(property)
+    , valueBefore(before), valueAfter(after)
+    , hadValueBefore(hadBefore), hasValueAfter(hasAfter)
+    {}
+
+    ~CoalescedPropertyAction() override
+    {
+        if (owner != nullptr)
+            owner->actionReleased();
+    }
+
+    bool perform() override { return apply(valueAfter, hasValueAfter); }
+
+    bool undo() override
+    {
+        // まとめている途中で取り消された場合は、その時点の値を最終値としてまとめを終了する
+        if (auto* o = owner)
+        {
+            close();
+            o->actionReleased();
+        }
+        return apply(valueBefore, hadValueBefore);
+    }
+
+    //! 現在の値を最終値とし、ownerとの結び付きを解除する
+    void close()
+    {
+        owner = nullptr;
+
+        const auto* value = targetTree.getPropertyPointer(targetProperty);
+        hasValueAfter = value != nullptr;
+        valueAfter = hasValueAfter ? *value : juce::var();
+    }
+
+    int getSizeInUnits() override
+    {
+        return (int)sizeof(*this) + getSizeOf(valueBefore) + getSizeOf(valueAfter);
+    }
+
+    juce::UndoableAction* createCoalescedAction(juce::UndoableAction* nextAction) override
+    {
+        // 同じトランザクション内で同じプロパティのまとめが続いた場合はさらにまとめる
+        // まとめている途中の操作はUndoCoalescerが参照しているため対象としない
+        if (auto* next = dynamic_cast<CoalescedPropertyAction*>(nextAction))
+            if (owner == nullptr && next->owner == nullptr && next->targetTree == targetTree && next->targetProperty == targetProperty)
+                return new CoalescedPropertyAction(targetTree, targetProperty, valueBefore, hadValueBefore, next->valueAfter, next->hasValueAfter);
+
+        return nullptr;
+    }
+
+private:
+    bool apply(const juce::var& value, bool hasValue)
+    {
+        if (hasValue)
+            targetTree.setProperty(targetProperty, value, nullptr);
+        else
+            targetTree.removeProperty(targetProperty, nullptr);
+
+        return true;
+    }
+
+    static int getSizeOf(const juce::var& value)
+    {
+        if (value.isString())     return (int)value.toString().getNumBytesAsUTF8();
+        if (value.isBinaryData()) return (int)value.getBinaryData()->getSize();
+        return 0;
+    }
+
+    friend class UndoCoalescer;
+    UndoCoalescer* owner = nullptr;
+
+    juce::ValueTree targetTree;
+    juce::Identifier targetProperty;
+    juce::var valueBefore, valueAfter;
+    bool hadValueBefore, hasValueAfter;
+
+    JUCE_DECLARE_NON_COPYABLE(CoalescedPropertyAction)
+};
+
+//==============================================================================
+UndoCoalescer::~UndoCoalescer()
+{
+    // 破棄時はUndoManagerを呼び出さない。登録済みの操作には現在の値を反映し、ジェスチャ中の変更は破棄する
+    if (openAction != nullptr)
+        openAction->close();
+}
+
+void UndoCoalescer::setTarget(const juce::ValueTree& tree, const juce::Identifier& property, juce::UndoManager* um)
+{
+    if (targetTree == tree && targetProperty == property && undoManager == um) return;
+
+    finish();
+
+    targetTree = tree;
+    targetProperty = property;
+    undoManager = um;
+
+    if (isInGesture())
+        begin();
+}
+
+void UndoCoalescer::setWindow(int milliseconds)
+{
+    windowMilliseconds = juce::jmax(0, milliseconds);
+
+    if (windowMilliseconds == 0 && ! isInGesture())
+        commit();
+}
+
+void UndoCoalescer::beginGesture()
+{
+    if (gestureDepth++ > 0) return;
+
+    // 時間によるまとめの途中であれば、その開始前の値からまとめる
+    stopTimer();
+    if (! isActive)
+        begin();
+}
+
+void UndoCoalescer::endGesture()
+{
+    if (gestureDepth == 0)
+    {
+        // beginGesture()と対応していない
+        jassertfalse;
+        return;
+    }
+
+    if (--gestureDepth == 0)
+        commit();
+}
+
+juce::UndoManager* UndoCoalescer::prepareWrite()
+{
+    if (undoManager == nullptr) return nullptr;
+    if (! isInGesture() && windowMilliseconds == 0) return undoManager;
+
+    if (! isInGesture())
+    {
+        // 前回の書き込みから時間が経過している場合は別の操作とする(タイマーが呼ばれる前に書き込まれた場合)
+        const auto now = juce::Time::getMillisecondCounter();
+        if (isActive && now - lastWriteTime > (juce::uint32)windowMilliseconds)
+            commit();
+
+        lastWriteTime = now;
+        startTimer(windowMilliseconds);
+    }
+
+    if (! isActive)
+        begin();
+
+    return isActive ? nullptr : undoManager;
+}
+
+void UndoCoalescer::commit()
+{
+    finish();
+
+    // ジェスチャ中にcommit()された場合は、現在の値から再びまとめる
+    if (isInGesture())
+        begin();
+}
+
+void UndoCoalescer::finish()
+{
+    if (! isActive) return;
+
+    isActive = false;
+    stopTimer();
+
+    // 時間によるまとめの操作は登録済みのため、現在の値を反映するのみ
+    if (openAction != nullptr)
+    {
+        openAction->close();
+        openAction = nullptr;
+        return;
+    }
+
+    if (undoManager != nullptr && targetTree.isValid())
+    {
+        const auto* valueAfter = targetTree.getPropertyPointer(targetProperty);
+        const bool hasValueAfter = valueAfter != nullptr;
+
+        if (hadValueBefore != hasValueAfter || (hasValueAfter && valueBefore != *valueAfter))
+            undoManager->perform(new CoalescedPropertyAction(targetTree, targetProperty,
+                                                             valueBefore, hadValueBefore,
+                                                             hasValueAfter ? *valueAfter : juce::var(), hasValueAfter));
+    }
+}
+
+//==============================================================================
+void UndoCoalescer::timerCallback()
+{
+    if (! isInGesture())
+        commit();
+}
+
+void UndoCoalescer::begin()
+{
+    jassert(! isActive);
+
+    const auto* value = targetTree.getPropertyPointer(targetProperty);
+    hadValueBefore = value != nullptr;
+    valueBefore = hadValueBefore ? *value : juce::var();
+
+    isActive = true;
+
+    // 時間によるまとめでは現在のトランザクションに操作を登録しておき、以降の書き込みはその操作に反映する
+    // 登録に失敗した場合(Undo/Redoの実行中など)は、actionReleased()によりまとめは行われない
+    if (! isInGesture() && undoManager != nullptr)
+    {
+        openAction = new CoalescedPropertyAction(targetTree, targetProperty, valueBefore, hadValueBefore, valueBefore, hadValueBefore);
+        openAction->owner = this;
+        undoManager->perform(openAction);
+    }
+}
+
+void UndoCoalescer::actionReleased() noexcept
+{
+    openAction = nullptr;
+    isActive = false;
+    stopTimer();
+}
+
+} // namespace vtwrapper
@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+    UndoCoalescer.h
+    Author:  migizo
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <juce_data_structures/juce_data_structures.h>
+
+namespace vtwrapper
+{
+
+//==============================================================================
+/**
+ @brief ひとつのプロパティへの連続した書き込みを、ひとつのUndo操作にまとめるクラス
+ - juce::UndoManagerはトランザクション内の同じプロパティへの書き込みのみをまとめるため、 @n
+ スライダーのドラッグなどで書き込みごとにトランザクションが区切られると、書き込みの数だけUndo履歴が増えてしまう。
+ - まとめている間の書き込みはUndoManagerを経由せずに行い、開始前の値から最終値への変更をひとつの操作として登録する。 @n
+ そのため履歴の量は書き込みの回数に依存しない。
+ - 範囲はbeginGesture()〜endGesture()で明示するか、setWindow()で時間を指定する。 @n
+ 時間を指定した場合は最後の書き込みから指定時間が経過するとまとめを終了する。
+ - 時間によるまとめでは、最初の書き込み時にその時点のトランザクションへ操作を登録し、以降の書き込みはその操作に反映される。 @n
+ そのためUndoManager::undo()の前に登録を行う必要は無く、UndoManagerが操作を取り消すか破棄した時点でまとめは終了する。
+ - ジェスチャ中の変更はendGesture()で登録されるまでUndo履歴に含まれない。
+ - 破棄時にはUndoManagerを呼び出さない。ジェスチャ中で登録されていない変更は破棄される。
+ - 登録された履歴の総量はjuce::UndoManager::setMaxNumberOfStoredUnits()で制限できる。 @n
+ 登録する操作は保持する値の大きさをgetSizeInUnits()で返すため、大きな値を持つプロパティも制限の対象になる。
+ - WrappedProperty::setUndoCoalescingWindow()、WrappedProperty::beginGesture()から使用される。メッセージスレッドでの使用を想定している
+ */
+class UndoCoalescer
+: private juce::Timer
+{
+public:
+    UndoCoalescer() = default;
+    ~UndoCoalescer() override;
+
+    //! @brief 対象のプロパティを設定する。まとめている途中の変更は登録される
+    void setTarget(const juce::ValueTree& tree, const juce::Identifier& property, juce::UndoManager* um);
+
+    //! @brief まとめる時間を設定する。0の場合は時間ではまとめない
+    void setWindow(int milliseconds);
+    int getWindow() const noexcept { return windowMilliseconds; }
+
+    //! @brief ジェスチャを開始する。入れ子にすることが可能で、最も外側のendGesture()までの変更がまとめられる
+    void beginGesture();
+    //! @brief ジェスチャを終了し、変更があればUndoManagerに登録する
+    void endGesture();
+    bool isInGesture() const noexcept { return gestureDepth > 0; }
+
+    //! @brief 書き込みの直前に呼び出し、書き込みに使用するUndoManagerを返す。まとめている間はnullptr
+    juce::UndoManager* prepareWrite();
+
+    //! @brief まとめている途中の変更をUndoManagerに登録する。ジェスチャ中の場合はジェスチャを継続する
+    void commit();
+    bool isCoalescing() const noexcept { return isActive; }
+
+private:
+    class CoalescedPropertyAction;
+
+    void timerCallback() override;
+    void begin();
+    //! まとめている途中の変更を登録し、まとめを終了する
+    void finish();
+    //! 時間によるまとめの操作がUndoManagerにより取り消しもしくは破棄された場合に、UndoManagerを呼び出さずにまとめを終了する
+    void actionReleased() noexcept;
+
+    juce::ValueTree targetTree;
+    juce::Identifier targetProperty;
+    juce::UndoManager* undoManager = nullptr;
+
+    juce::var valueBefore;
+    bool hadValueBefore = false;
+    bool isActive = false;
+    int gestureDepth = 0;
+    int windowMilliseconds = 0;
+    juce::uint32 lastWriteTime = 0;
+
+    // 時間によるまとめの間、UndoManagerに登録済みで書き込みを反映する操作。所有権はUndoManagerにある
+    CoalescedPropertyAction* openAction = nullptr;
+
+    JUCE_DECLARE_NON_COPYABLE(UndoCoalescer)
+};
+
+} // namespace vtwrapper
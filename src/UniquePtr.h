@@ -10,6 +10,8 @@
 #pragma once
 #include <juce_data_structures/juce_data_structures.h>
 #include "WrappedTree.h"
+#include "ObjectPool.h"
+#include "Instrumentation.h"
 
 namespace vtwrapper
 {
@@ -18,8 +20,11 @@ namespace vtwrapper
 //! WrappedTreeType型はvtwrapper::WrappedTreeの派生クラスである必要がある。
 //! 対象のtreeをリッスンし、有効無効状態および親への追加削除に応じてunique_ptrを同期させる
 //! juce::ValueTree::isValid()では無い場合はnullptrを指す。
+//! オブジェクトの確保および破棄はAllocatorで行う。(ObjectPool.hを参照) reset()やcreatorに渡すオブジェクトはnewで確保したものでも良い。
+//! 親の変更通知を受けても同じValueTreeに紐付いている場合はオブジェクトを作り直さない。
+//! setRetainDetached(true)の場合は親から外れたオブジェクトを破棄せずに保持し、Undoなどで同じValueTreeが親に戻った時にそのまま再利用する。
 // TODO: ListenerおよびUniquePtrChanged(UniquePtr<WrappedTreeType> changedPtr)を用意、もしくはstd::function
-template <typename WrappedTreeType>
+template <typename WrappedTreeType, typename Allocator = PooledAllocator<WrappedTreeType>>
 class UniquePtr
 : private juce::ValueTree::Listener
 {
@@ -31,12 +36,12 @@ public:
     UniquePtr(std::function<WrappedTreeType*()> creator) : createCallback(creator) {}
     ~UniquePtr() override = default;
     
-    UniquePtr<WrappedTreeType>& operator=(nullptr_t) noexcept { reset(nullptr); return *this; }
+    UniquePtr& operator=(nullptr_t) noexcept { reset(nullptr); return *this; }
     const WrappedTreeType& operator*() const { jassert(ptr); return *ptr.get(); }
     WrappedTreeType* const operator->() const noexcept { return ptr.get(); }
     explicit operator bool() const noexcept { return (bool)ptr; }
-    bool operator== (const UniquePtr<WrappedTreeType>& other) const { return ptr == other.ptr; }
-    bool operator!= (const UniquePtr<WrappedTreeType>& other) const { return ! operator== (other); }
+    bool operator== (const UniquePtr& other) const { return ptr == other.ptr; }
+    bool operator!= (const UniquePtr& other) const { return ! operator== (other); }
     bool operator== (nullptr_t) const { return ptr == nullptr; }
     bool operator!= (nullptr_t) const { return ! operator== (nullptr); }
     
@@ -47,6 +52,7 @@ public:
     //! - targetTreeが有効かつtargetTypeと同じTypeを持たないが子が同じTypeを持つ場合...targetTreeを親としtargetTypeを持つ子も保持する
     //! - targetTreeが有効だがtargetTypeと同じTypeを持たず子も同じTypeを持たない場合...親Treeのみを保持する
     void referTo(const juce::ValueTree& targetTree, const juce::Identifier& targetType, juce::UndoManager* um);
+    
         
     //! std::unique_ptr<>::reset()と同様、解放および新たなリソースの所有権を設定する
     //! 先にreferToによる紐付けを行なっている必要がある。
@@ -58,37 +64,60 @@ public:
 
     WrappedTreeType const* get() const { return ptr.get(); }
     
+    //! @brief 親から外れたオブジェクトを破棄せずに保持するかどうか。保持するのは直近のひとつのみ
+    //! @n エフェクトスロットのon/offをUndoで切り替える場合などに、オブジェクトの確保およびwrap()を行わずに再利用できる。
+    //! 保持している間もオブジェクトは外れたValueTreeを監視し続ける。falseを指定した時点で保持していたオブジェクトは破棄される
+    void setRetainDetached(bool shouldRetain);
+    bool isRetainingDetached() const noexcept { return retainDetached; }
+    bool hasDetached() const noexcept { return detachedPtr != nullptr; }
+    
 private:
     void valueTreeParentChanged(juce::ValueTree& treeWhoseParentHasChanged) override;
     
     void reset(bool isOn);
     void updatePtrWithTree();
+    WrappedTreeType* createPtr();
+    void detachPtr();
+    bool isBoundToTarget(WrappedTreeType* t) const;
+    
+    struct Deleter
+    {
+        void operator()(WrappedTreeType* t) const { allocator->destroy(t); }
+        Allocator* allocator;
+    };
     
     std::function<WrappedTreeType*()> createCallback = nullptr;
-    std::unique_ptr<WrappedTreeType> ptr = nullptr;
+    Allocator allocator;
+    std::unique_ptr<WrappedTreeType, Deleter> ptr { nullptr, Deleter { &allocator } };
+    std::unique_ptr<WrappedTreeType, Deleter> detachedPtr { nullptr, Deleter { &allocator } };
     juce::ValueTree parentTree;
     juce::ValueTree valueTree;
     juce::Identifier typeId;
     juce::UndoManager* undoManager;
     bool ignoreCallback = false;
+    bool retainDetached = false;
 };
 
 
-template <typename WrappedTreeType>
-void UniquePtr<WrappedTreeType>::referTo(const juce::ValueTree& targetTree, const juce::Identifier& targetType, juce::UndoManager* um)
+template <typename WrappedTreeType, typename Allocator>
+void UniquePtr<WrappedTreeType, Allocator>::referTo(const juce::ValueTree& targetTree, const juce::Identifier& targetType, juce::UndoManager* um)
 {
     jassert(targetType.isValid());
     jassert(targetTree.isValid());
 
     juce::ScopedValueSetter<bool> svs(ignoreCallback, true);
 
-    valueTree.removeListener(this);
+    ListenerRegistrar::remove(valueTree, this);
     
     typeId = targetType;
     undoManager = um;
     
     if (targetType.isValid() && targetTree.isValid())
     {
+        // 読み込まれていないノードの場合は子を探す前に読み込む
+        if (! targetTree.hasType(typeId))
+            WrappedTree::loadIfNeeded(targetTree);
+        
         // target自身が有効なTypeを持つ場合
         if (targetTree.hasType(typeId))
         {
@@ -115,12 +144,16 @@ void UniquePtr<WrappedTreeType>::referTo(const juce::ValueTree& targetTree, cons
         parentTree = {};
     }
     
+    // 保持していたオブジェクトが別のValueTreeに紐付いている場合は再利用されないため破棄する
+    if (detachedPtr != nullptr && detachedPtr->getValueTree() != valueTree)
+        detachedPtr = nullptr;
+    
     updatePtrWithTree();
-    valueTree.addListener(this);
+    ListenerRegistrar::add(valueTree, this);
 }
 
-template <typename WrappedTreeType>
-void UniquePtr<WrappedTreeType>::reset(WrappedTreeType* t)
+template <typename WrappedTreeType, typename Allocator>
+void UniquePtr<WrappedTreeType, Allocator>::reset(WrappedTreeType* t)
 {
     juce::ScopedValueSetter<bool> svs(ignoreCallback, true);
 
@@ -159,61 +192,128 @@ void UniquePtr<WrappedTreeType>::reset(WrappedTreeType* t)
     //------------------
     // ptrの更新
     //------------------
+    if (t == nullptr)
+    {
+        detachPtr();
+        return;
+    }
+    
+    if (t == detachedPtr.get())
+        detachedPtr.release();
+    
+    detachedPtr = nullptr;
     ptr.reset(t);
 }
 
-template <typename WrappedTreeType>
-void UniquePtr<WrappedTreeType>::reset(bool isOn)
+template <typename WrappedTreeType, typename Allocator>
+void UniquePtr<WrappedTreeType, Allocator>::reset(bool isOn)
 {
-    WrappedTreeType* newPtr = nullptr;
-
-    if (isOn)
+    if (! isOn)
     {
-        if (createCallback)
-        {
-            newPtr = createCallback();
-        }
-        else
-        {
-            newPtr = new WrappedTreeType();
-            newPtr->wrap(valueTree, typeId, undoManager);
-        }
+        reset(nullptr);
+        return;
     }
-    reset(newPtr);
+    
+    // 保持していたオブジェクトがあれば再利用する
+    if (isBoundToTarget(detachedPtr.get()))
+        reset(detachedPtr.get());
+    else
+        reset(createPtr());
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void UniquePtr<WrappedTreeType, Allocator>::setRetainDetached(bool shouldRetain)
+{
+    retainDetached = shouldRetain;
+    
+    if (! retainDetached)
+        detachedPtr = nullptr;
 }
 
-template <typename WrappedTreeType>
-void UniquePtr<WrappedTreeType>::valueTreeParentChanged(juce::ValueTree& treeWhoseParentHasChanged)
+template <typename WrappedTreeType, typename Allocator>
+void UniquePtr<WrappedTreeType, Allocator>::valueTreeParentChanged(juce::ValueTree& treeWhoseParentHasChanged)
 {
+    VTWRAPPER_INSTRUMENT_SCOPE(parentChanged, "UniquePtr", treeWhoseParentHasChanged.getType(), {});
+
     if (ignoreCallback) return;
     if (valueTree != treeWhoseParentHasChanged) return;
     
     updatePtrWithTree();
 }
 
-template <typename WrappedTreeType>
-void UniquePtr<WrappedTreeType>::updatePtrWithTree()
+template <typename WrappedTreeType, typename Allocator>
+void UniquePtr<WrappedTreeType, Allocator>::updatePtrWithTree()
 {
     // 無効なValueTreeの場合はnullをセット
     if (valueTree.isValid() == false || valueTree.isAChildOf(parentTree) == false)
     {
-        ptr = nullptr;
+        detachPtr();
+        return;
     }
-    // 有効な場合はコールバックがあればそちらを呼び出し、無ければwrap処理を呼んだ後スマートポインタに格納する
-    else
+    
+    // 既に同じValueTreeに紐付いている場合は何もしない(親の中での移動など)
+    if (isBoundToTarget(ptr.get()))
+        return;
+    
+    // 保持していたオブジェクトが同じValueTreeに紐付いている場合はそのまま戻す(Undoによる再追加など)
+    if (isBoundToTarget(detachedPtr.get()))
     {
-        WrappedTreeType* newPtr = nullptr;
-        if (createCallback)
-        {
-            newPtr = createCallback();
-        }
-        else
+        ptr = std::move(detachedPtr);
+        return;
+    }
+    
+    // 既存のオブジェクトがあれば紐付け直す。
+    // createCallbackはValueTreeに応じて異なる派生クラスを返す可能性があるため、その場合は作り直す
+    if (! createCallback)
+    {
+        if (ptr == nullptr)
+            ptr = std::move(detachedPtr);
+        
+        if (ptr != nullptr)
         {
-            newPtr = new WrappedTreeType();
-            newPtr->wrap(valueTree, typeId, undoManager);
+            ptr->wrap(valueTree, typeId, undoManager);
+            return;
         }
-        ptr.reset(newPtr);
     }
+    
+    ptr.reset(createPtr());
+}
+
+template <typename WrappedTreeType, typename Allocator>
+WrappedTreeType* UniquePtr<WrappedTreeType, Allocator>::createPtr()
+{
+    // コールバックがあればそちらを呼び出し、無ければAllocatorで確保する
+    WrappedTreeType* newPtr = nullptr;
+    if (createCallback)
+    {
+        newPtr = createCallback();
+    }
+    else
+    {
+        VTWRAPPER_INSTRUMENT_SCOPE(allocation, "UniquePtr", typeId, {});
+        newPtr = allocator.create();
+    }
+    
+    // wrap()による初期化処理が行われていない場合は初期化する
+    if (newPtr != nullptr && ! newPtr->isValid())
+        newPtr->wrap(valueTree, typeId, undoManager);
+    
+    return newPtr;
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void UniquePtr<WrappedTreeType, Allocator>::detachPtr()
+{
+    if (retainDetached && ptr != nullptr)
+        detachedPtr = std::move(ptr);
+    else
+        ptr = nullptr;
+}
+
+template <typename WrappedTreeType, typename Allocator>
+bool UniquePtr<WrappedTreeType, Allocator>::isBoundToTarget(WrappedTreeType* t) const
+{
+    return t != nullptr && valueTree.isValid() && t->getValueTree() == valueTree && t->getUndoManager() == undoManager;
 }
 
 
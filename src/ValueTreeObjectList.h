@@ -10,24 +10,91 @@
 #pragma once
 #include <juce_data_structures/juce_data_structures.h>
 #include "WrappedTree.h"
+#include "Hash.h"
+#include "ObjectPool.h"
+#include "ListenerRegistrar.h"
+#include "ParallelFor.h"
+#include "Instrumentation.h"
 //#include "../ValueTreeConverter.h"
 
 namespace vtwrapper
 {
 
 // TODO: Listenerおよびhoge(WrappedTreeList<WrappedTreeType> changedPtr)を用意、もしくはstd::function
-template <typename WrappedTreeType>
+//! @brief juce::ValueTreeの子要素と同期するWrappedTreeのリスト
+//! 子要素の確保および破棄はAllocatorで行う。デフォルトでは型ごとに共有されるSlabPoolを使用する。(ObjectPool.hを参照)
+//! @n 多数の要素を毎フレーム走査する場合は、リストごとに要素を連続して配置するChunkedAllocatorを指定し、forEachInStorageOrder()で走査する。
+//! @n add()に渡すオブジェクトはnewで確保したものでも良い。
+template <typename WrappedTreeType, typename Allocator = PooledAllocator<WrappedTreeType>>
 class WrappedTreeList
 : protected juce::ValueTree::Listener
 {
 public:
     WrappedTreeList() = default;
-    ~WrappedTreeList() override { clear(); }
+    ~WrappedTreeList() override { clear(); destroyAllChildren(); }
     
     void wrap(const juce::ValueTree& targetTree, const juce::Identifier& targetParentType, const juce::Identifier& targetChildType, juce::UndoManager* um, bool allowCreationIfInvalid = true, bool allowChildWrapping = true);
     
-    WrappedTreeType* add(WrappedTreeType* t);
+    //! @brief wrap()時に既存の子要素を再利用するかどうか。デフォルトではfalse
+    //! @n trueの場合、wrap()で新しい子ValueTreeと既存の子要素を照合し、一致した子要素は破棄せずに再利用する。
+    //! 同じValueTreeに紐付いている子要素はそのまま、matchingKeyで一致した子要素は新しいValueTreeに再度wrap()される。
+    //! 一致しなかった子ValueTreeに対してのみ新たに子要素を作成する。
+    //! @param matchingKey 照合に用いるプロパティ。指定しない場合はjuce::ValueTreeの同一性のみで照合する
+    void setReuseChildrenOnWrap(bool shouldReuse, const juce::Identifier& matchingKey = {});
+    
+    //! @brief 子要素を遅延作成するかどうか。デフォルトではfalse
+    //! @n trueの場合、wrap()や子ValueTreeの追加時には子要素を作成せず、getUnchecked()などで初めてアクセスした時に作成しwrap()する。
+    //! 表示される部分のみにアクセスする場合、読み込み時間はツリー全体の大きさではなくアクセスした要素数に比例する。
+    //! begin()/end()による走査やgetArray()では全ての子要素が作成される。falseに戻した場合は未作成の子要素を全て作成する。
+    void setLazyWrapping(bool shouldBeLazy);
+    bool isLazyWrapping() const noexcept { return lazyWrapping; }
+    
+    //! @brief wrap()時の子要素の作成をpoolのスレッドで並列に行うかどうか。nullptrの場合は行わない(デフォルト)
+    //! @n 子要素の作成およびwrap()をminChildrenPerJob個ずつ、poolのスレッドと呼び出し元のスレッドで分担する。
+    //! その間にWrappedPropertyなどが行うリスナー登録は保留され、全ての子要素の作成後に呼び出し元のスレッドでまとめて行われる。(ListenerRegistrar.hを参照)
+    //! @n 複数のスレッドで同時に子ValueTreeを扱うため、以下を満たす場合のみ使用する。
+    //! - 読み込み直後のValueTreeなど、対象のValueTreeおよびその親に他のリスナーが登録されていない
+    //! - 子要素のwrapPropertiesAndChildren()が自身の部分木以外にアクセスせず、UndoManagerに記録される書き込みを行わない
+    //! - MappedSessionで遅延読み込みされるノードを含まない
+    //! - Allocator::create()がスレッドセーフである(HeapAllocator、PooledAllocatorは満たす)
+    //! @n 遅延作成が有効な場合、およびsetReuseChildrenOnWrap()で既存の子要素を再利用する場合は使用されない。
+    void setParallelWrapping(juce::ThreadPool* poolToUse, int minChildrenPerJob = 256);
+    
+    //! @brief 作成済みの子要素の数。遅延作成が無効な場合はsize()と等しい
+    int getNumMaterialisedChildren() const noexcept;
+    
+    WrappedTreeType* add(WrappedTreeType* t) { return insert(-1, t); }
     void remove(WrappedTreeType* t);
+    
+    //! @brief 複数の要素をまとめて末尾に追加する
+    //! @n 以下の一括操作ではundoManagerが設定されている場合に新しいトランザクションを開始し、一度のundoで元に戻せるようにする。
+    //! 内部の要素の配列は操作ごとに一度だけ更新する
+    //! @n nullptr、他のValueTreeに紐付いている要素、重複した要素が含まれる場合は何も追加せずにfalseを返す。この場合、要素の所有権は呼び出し側に残る
+    bool addRange(const juce::Array<WrappedTreeType*>& itemsToAdd);
+    
+    //! @brief 複数の要素をまとめてindexの位置に挿入する。indexが範囲外の場合は末尾に追加する
+    //! @n 追加できない要素が含まれる場合はaddRange()と同様に何も挿入せずにfalseを返す
+    bool insertAt(int index, const juce::Array<WrappedTreeType*>& itemsToInsert);
+    
+    //! @brief startIndexからnumberToRemove個の要素をまとめて削除する
+    void removeRange(int startIndex, int numberToRemove);
+    
+    //! @brief predicate(WrappedTreeType*)がtrueを返す要素をまとめて削除する
+    //! @return 削除した要素数
+    template <typename PredicateType>
+    int removeIf(PredicateType&& predicate);
+    
+    //! @brief find()で用いるキーとなるプロパティを設定し、子要素の索引を作成する。無効なIdentifierを指定した場合は索引を破棄する
+    //! @n 索引は子要素の追加削除およびキーとなるプロパティの変更に合わせて更新される。
+    //! キーの変更は各子要素のPropertyDispatcher経由で受け取るため、子ValueTreeから要素を探す処理は行わない。
+    //! キーの値はjuce::var::toString()で比較するため、文字列・数値のどちらでも良い
+    void setIndexKey(const juce::Identifier& key);
+    const juce::Identifier& getIndexKey() const noexcept { return indexKey; }
+    
+    //! @brief キーとなるプロパティがkeyValueと一致する子要素を返す。見つからない場合はnullptr
+    //! @n 先にsetIndexKey()でキーを設定しておく必要がある。同じキーを持つ子要素が複数ある場合はそのいずれかを返す
+    WrappedTreeType* find(const juce::var& keyValue) const;
+    
     void clear() { valueTree.removeAllChildren(nullptr); }
     
     template<typename ElementComparator>
@@ -36,17 +103,32 @@ public:
     bool isEmpty() const { return children.isEmpty(); }
     int size() const { return children.size(); }
     
-    inline WrappedTreeType* const getUnchecked(int index) const noexcept { return children[index]; }
-    inline WrappedTreeType* const operator[](int index) const noexcept { return getUnchecked(index); }
-    inline WrappedTreeType* getFirst() const noexcept { return children.getFirst(); }
-    inline WrappedTreeType* getLast() const noexcept { return children.getLast(); }
+    inline WrappedTreeType* const getUnchecked(int index) const { return getOrCreateChild(index); }
+    inline WrappedTreeType* const operator[](int index) const { return getUnchecked(index); }
+    inline WrappedTreeType* getFirst() const { return getOrCreateChild(0); }
+    inline WrappedTreeType* getLast() const { return getOrCreateChild(children.size() - 1); }
 
-    inline WrappedTreeType** begin() noexcept { return children.begin(); }
-    inline WrappedTreeType* const* begin() const noexcept { return children.begin(); }
+    inline WrappedTreeType** begin() { createAllChildren(); return children.begin(); }
+    inline WrappedTreeType* const* begin() const { createAllChildren(); return children.begin(); }
     inline WrappedTreeType** end() noexcept { return children.end(); }
     inline WrappedTreeType* const* end() const noexcept { return children.end(); }
 
-    const juce::OwnedArray<WrappedTreeType>& getOwnedArray() const { return children; }
+    const juce::Array<WrappedTreeType*>& getArray() const { createAllChildren(); return children; }
+    
+    //! @brief 非推奨。getArray()を使用する
+    //! @n 子要素はAllocatorで確保するようになったため、juce::OwnedArrayではなくgetArray()と同じ配列を返す。
+    //! size()、getUnchecked()、範囲forなどの読み出しのみの使用はそのまま動作する
+    [[deprecated ("Use getArray() instead")]]
+    const juce::Array<WrappedTreeType*>& getOwnedArray() const { return getArray(); }
+    
+    //! @brief 作成済みの子要素に対して、メモリ上の順にfunction(WrappedTreeType&)を呼び出す
+    //! @n 順序に依存しない毎フレームの更新など、全ての要素を走査する場合に用いる。AllocatorがforEach()、owns()を持つ必要がある。(ChunkedAllocatorなど)
+    //! Allocator外で確保されadd()された要素は、Allocatorの要素の後にリストの順で呼び出される。
+    template <typename Function>
+    void forEachInStorageOrder(Function&& function);
+    
+    //! @brief 子要素の確保に用いるAllocator。add()に渡す要素をAllocatorで作成する場合に用いる
+    Allocator& getAllocator() noexcept { return allocator; }
     
     //! @brief 既にwrap()による紐付け処理を行い有効な状態であるか
     bool isValid() const { return valueTree.isValid() && parentTypeId.isValid() && childTypeId.isValid() && valueTree.hasType(parentTypeId); }
@@ -57,27 +139,86 @@ public:
     juce::UndoManager* getUndoManager() noexcept { return undoManager; }
     
 protected:
-    juce::OwnedArray<WrappedTreeType> children;
+    //! 要素はAllocatorで破棄する必要があるため、削除する場合はdestroyChild()を用いる
+    //! 遅延作成が有効な場合は未作成の要素がnullptrとなる
+    juce::Array<WrappedTreeType*> children;
+    Allocator allocator;
     
-private:
+    void destroyChild(WrappedTreeType* t) { if (t != nullptr) { removeFromIndex(t); allocator.destroy(t); } }
+    void destroyAllChildren();
+    
+    //! 要素をindexの位置に挿入する。indexが範囲外の場合は末尾に追加する
+    WrappedTreeType* insert(int index, WrappedTreeType* t);
+    
+    //! 一括追加の前に全ての要素が追加可能か確認する。途中の要素で失敗して一部だけ追加されるのを防ぐため
+    bool canInsertAll(const juce::Array<WrappedTreeType*>& items) const;
+    
+    //! 派生クラスでリスナー関数を拡張する場合は、基底クラスの処理を呼び出した上で追加の処理を行う
     void valueTreeChildAdded(juce::ValueTree& parent, juce::ValueTree& childWhichHasBeenAdded) override;
     void valueTreeChildRemoved(juce::ValueTree& parent, juce::ValueTree& /*childWhichHasBeenRemoved*/, int indexFromWhichChildWasRemoved) override;
     void valueTreeChildOrderChanged(juce::ValueTree& parent, int oldIndex, int newIndex) override;
+    void valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged, const juce::Identifier& property) override;
     
-    WrappedTreeType* createNewChild(juce::ValueTree& targetChild) const;
+    //! 自身の操作によるValueTreeの変更中か。この間のリスナー関数の呼び出しは基底クラスでは無視される
+    bool isHandlingOwnChange() const noexcept { return ignoreCallback; }
+    
+private:
+    WrappedTreeType* createNewChild(juce::ValueTree& targetChild);
+    WrappedTreeType* createNewChildUnlessLazy(juce::ValueTree& targetChild) { return lazyWrapping ? nullptr : createNewChild(targetChild); }
+    WrappedTreeType* getOrCreateChild(int index) const;
+    void createAllChildren() const;
+    bool insertChildTree(int index, WrappedTreeType* t);
+    void beginBulkTransaction();
+    
+    struct IndexEntry;
+    void addToIndex(WrappedTreeType* t);
+    void removeFromIndex(const WrappedTreeType* t);
+    void linkIndexEntry(IndexEntry& entry);
+    void unlinkIndexEntry(IndexEntry& entry);
+    void updateIndexEntry(IndexEntry& entry);
+    void clearIndex();
+    void rebuildIndex();
+    void wrapChildren();
+    void wrapChildrenInParallel();
+    void rewrapChildrenIncrementally();
     
     juce::ValueTree valueTree;
     juce::Identifier parentTypeId;
     juce::Identifier childTypeId;
     juce::UndoManager* undoManager;
     
+    bool reuseChildrenOnWrap = false;
+    juce::Identifier reuseMatchingKey;
+    bool lazyWrapping = false;
+    juce::ThreadPool* parallelWrappingPool = nullptr;
+    int minChildrenPerParallelJob = 256;
+    
+    // 索引に含めた要素ごとに保持し、要素のPropertyDispatcherからキーの変更を受け取る。
+    // キーの変更時に古いキーを辿れるよう、現在のキーも保持する
+    struct IndexEntry
+    : public PropertyDispatcher::Client
+    {
+        IndexEntry(WrappedTreeList& ownerToUse, WrappedTreeType& childToUse) : owner(ownerToUse), child(childToUse) {}
+        void dispatchedPropertyChanged() override { owner.updateIndexEntry(*this); }
+        void dispatcherDetached() override {}
+        
+        WrappedTreeList& owner;
+        WrappedTreeType& child;
+        juce::String key;
+        bool hasKey = false;
+    };
+    
+    juce::Identifier indexKey;
+    std::unordered_multimap<juce::String, WrappedTreeType*, StringHash> childrenByKey;
+    std::unordered_map<const WrappedTreeType*, IndexEntry> indexEntries;
+    
     bool ignoreCallback = false;
 };
 
-template <typename WrappedTreeType>
-void WrappedTreeList<WrappedTreeType>::wrap(const juce::ValueTree& targetTree, const juce::Identifier& targetParentType, const juce::Identifier& targetChildType, juce::UndoManager* um, bool allowCreationIfInvalid, bool allowChildWrapping)
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::wrap(const juce::ValueTree& targetTree, const juce::Identifier& targetParentType, const juce::Identifier& targetChildType, juce::UndoManager* um, bool allowCreationIfInvalid, bool allowChildWrapping)
 {
-    valueTree.removeListener(this);
+    ListenerRegistrar::remove(valueTree, this);
     
     parentTypeId = targetParentType;
     childTypeId = targetChildType;
@@ -85,18 +226,239 @@ void WrappedTreeList<WrappedTreeType>::wrap(const juce::ValueTree& targetTree, c
     valueTree = targetTree;
 
     WrappedTree::updateTreeIfNeeded(valueTree, parentTypeId, undoManager, allowCreationIfInvalid, allowChildWrapping);
+    WrappedTree::loadIfNeeded(valueTree);
     
-    children.clear();
+    if (reuseChildrenOnWrap && ! children.isEmpty())
+        rewrapChildrenIncrementally();
+    else
+        wrapChildren();
+    
+    rebuildIndex();
+    ListenerRegistrar::add(valueTree, this);
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::setReuseChildrenOnWrap(bool shouldReuse, const juce::Identifier& matchingKey)
+{
+    reuseChildrenOnWrap = shouldReuse;
+    reuseMatchingKey = matchingKey;
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::setLazyWrapping(bool shouldBeLazy)
+{
+    if (lazyWrapping == shouldBeLazy) return;
+    
+    // 無効にする場合は未作成の子要素を全て作成する
+    if (! shouldBeLazy)
+        createAllChildren();
+    
+    lazyWrapping = shouldBeLazy;
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::setParallelWrapping(juce::ThreadPool* poolToUse, int minChildrenPerJob)
+{
+    parallelWrappingPool = poolToUse;
+    minChildrenPerParallelJob = juce::jmax(1, minChildrenPerJob);
+}
+
+template <typename WrappedTreeType, typename Allocator>
+int WrappedTreeList<WrappedTreeType, Allocator>::getNumMaterialisedChildren() const noexcept
+{
+    if (! lazyWrapping) return children.size();
+    
+    return (int)std::count_if(children.begin(), children.end(), [](const WrappedTreeType* t) { return t != nullptr; });
+}
+
+template <typename WrappedTreeType, typename Allocator>
+WrappedTreeType* WrappedTreeList<WrappedTreeType, Allocator>::getOrCreateChild(int index) const
+{
+    auto* t = children[index];
+    if (t != nullptr || ! juce::isPositiveAndBelow(index, children.size()))
+        return t;
+    
+    // 未作成の要素を作成する。索引などの内部状態のみの更新のため、constなアクセスでも行う
+    auto& self = const_cast<WrappedTreeList&>(*this);
+    auto vt = valueTree.getChild(index);
+    t = self.createNewChild(vt);
+    self.children.setUnchecked(index, t);
+    self.addToIndex(t);
+    return t;
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::createAllChildren() const
+{
+    if (! lazyWrapping) return;
+    
+    for (int i = 0; i < children.size(); ++i)
+        getOrCreateChild(i);
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::wrapChildren()
+{
+    destroyAllChildren();
+    
+    if (lazyWrapping)
+    {
+        children.resize(valueTree.getNumChildren());
+        return;
+    }
+    
+    if (parallelWrappingPool != nullptr && valueTree.getNumChildren() >= minChildrenPerParallelJob * 2)
+    {
+        wrapChildrenInParallel();
+        return;
+    }
+    
+    children.ensureStorageAllocated(valueTree.getNumChildren());
     for (auto vt: valueTree)
     {
         children.add(createNewChild(vt));
     }
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::wrapChildrenInParallel()
+{
+    const int numChildren = valueTree.getNumChildren();
+    const int numJobs = numChildren / minChildrenPerParallelJob;
+    
+    // 各ジョブは異なるインデックスにのみ書き込む
+    children.resize(numChildren);
+    std::vector<ListenerRegistrar::Registrations> registrations((size_t)numJobs);
+    
+    runInParallel(*parallelWrappingPool, numJobs, [&](int jobIndex)
+    {
+        ListenerRegistrar::ScopedDeferral deferral(registrations[(size_t)jobIndex]);
+        
+        const int start = (int)((juce::int64)numChildren * jobIndex / numJobs);
+        const int end = (int)((juce::int64)numChildren * (jobIndex + 1) / numJobs);
+        for (int i = start; i < end; ++i)
+        {
+            auto vt = valueTree.getChild(i);
+            children.setUnchecked(i, createNewChild(vt));
+        }
+    });
+    
+    for (const auto& r : registrations)
+        ListenerRegistrar::addAll(r);
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::rewrapChildrenIncrementally()
+{
+    juce::Array<WrappedTreeType*> oldChildren;
+    oldChildren.swapWith(children);
+    
+    const int numChildren = valueTree.getNumChildren();
+    children.ensureStorageAllocated(numChildren);
+    
+    // 再利用されなかった要素はスコープを抜ける時に破棄する。(新しい子の数が少ない場合の末尾の要素も含む)
+    struct Cleanup
+    {
+        ~Cleanup() { for (auto* t : array) owner.destroyChild(t); }
+        WrappedTreeList& owner;
+        juce::Array<WrappedTreeType*>& array;
+    } cleanup { *this, oldChildren };
+    
+    auto takeOldChild = [&oldChildren](int index)
+    {
+        auto* t = oldChildren.getUnchecked(index);
+        oldChildren.setUnchecked(index, nullptr);
+        return t;
+    };
+    
+    // 同じ位置の要素が同じValueTreeに紐付いていれば再利用する。
+    // 再wrapで変化が無い場合はここで全ての要素が一致する
+    juce::Array<int> unmatchedIndices;
+    for (int i = 0; i < numChildren; ++i)
+    {
+        auto vt = valueTree.getChild(i);
+        auto* old = oldChildren[i];
+        
+        if (old != nullptr && old->getValueTree() == vt && old->getUndoManager() == undoManager)
+        {
+            children.add(takeOldChild(i));
+        }
+        else
+        {
+            children.add(nullptr);
+            unmatchedIndices.add(i);
+        }
+    }
+    
+    if (unmatchedIndices.isEmpty()) return;
+    
+    // 一致しなかった要素のみ照合する。キー指定が無い場合は残りの要素からValueTreeの同一性で探す
+    std::unordered_multimap<juce::String, int, StringHash> oldIndicesByKey;
+    std::vector<int> oldIndicesInTree;
+    if (reuseMatchingKey.isValid())
+    {
+        for (int i = 0; i < oldChildren.size(); ++i)
+            if (auto* old = oldChildren.getUnchecked(i))
+                if (auto* key = old->getValueTree().getPropertyPointer(reuseMatchingKey))
+                    oldIndicesByKey.emplace(key->toString(), i);
+    }
+    else
+    {
+        // 同一性で一致し得るのは、紐付いているValueTreeがまだ親の子として残っている要素のみ。
+        // リダイレクトやプリセットの読み込みで子が全て置き換えられた場合は候補が無く、探索を行わない
+        for (int i = 0; i < oldChildren.size(); ++i)
+            if (auto* old = oldChildren.getUnchecked(i))
+                if (old->getValueTree().getParent() == valueTree)
+                    oldIndicesInTree.push_back(i);
+    }
     
-    valueTree.addListener(this);
+    for (int index : unmatchedIndices)
+    {
+        auto vt = valueTree.getChild(index);
+        WrappedTreeType* reused = nullptr;
+        
+        if (reuseMatchingKey.isValid())
+        {
+            WrappedTree::loadIfNeeded(vt);
+            
+            if (auto* key = vt.getPropertyPointer(reuseMatchingKey))
+            {
+                auto it = oldIndicesByKey.find(key->toString());
+                if (it != oldIndicesByKey.end())
+                {
+                    reused = takeOldChild(it->second);
+                    oldIndicesByKey.erase(it);
+                }
+            }
+        }
+        else
+        {
+            for (auto it = oldIndicesInTree.begin(); it != oldIndicesInTree.end(); ++it)
+            {
+                if (oldChildren.getUnchecked(*it)->getValueTree() == vt)
+                {
+                    reused = takeOldChild(*it);
+                    oldIndicesInTree.erase(it);
+                    break;
+                }
+            }
+        }
+        
+        if (reused != nullptr)
+        {
+            if (reused->getValueTree() != vt || reused->getUndoManager() != undoManager)
+                reused->wrap(vt, childTypeId, undoManager);
+        }
+        else
+        {
+            reused = createNewChildUnlessLazy(vt);
+        }
+        children.setUnchecked(index, reused);
+    }
 }
 
-template <typename WrappedTreeType>
-WrappedTreeType* WrappedTreeList<WrappedTreeType>::add(WrappedTreeType* t)
+template <typename WrappedTreeType, typename Allocator>
+WrappedTreeType* WrappedTreeList<WrappedTreeType, Allocator>::insert(int index, WrappedTreeType* t)
 {
     if (! isValid() || t == nullptr)
     {
@@ -106,20 +468,79 @@ WrappedTreeType* WrappedTreeList<WrappedTreeType>::add(WrappedTreeType* t)
 
     juce::ScopedValueSetter<bool> svs(ignoreCallback, true);
     
-    if (! t->isValid())
+    if (! juce::isPositiveAndNotGreaterThan(index, children.size()))
+        index = children.size();
+    
+    if (! insertChildTree(index, t))
+        return nullptr;
+    
+    children.insert(index, t);
+    addToIndex(t);
+    return t;
+}
+
+template <typename WrappedTreeType, typename Allocator>
+bool WrappedTreeList<WrappedTreeType, Allocator>::addRange(const juce::Array<WrappedTreeType*>& itemsToAdd)
+{
+    return insertAt(-1, itemsToAdd);
+}
+
+template <typename WrappedTreeType, typename Allocator>
+bool WrappedTreeList<WrappedTreeType, Allocator>::insertAt(int index, const juce::Array<WrappedTreeType*>& itemsToInsert)
+{
+    if (! isValid())
     {
-        auto vtNewChild = juce::ValueTree(childTypeId);
-        valueTree.appendChild(vtNewChild, undoManager);
-        t->wrap(vtNewChild, childTypeId, undoManager);
+        jassertfalse;
+        return false;
     }
+    if (itemsToInsert.isEmpty()) return true;
     
-    jassert(t->getTypeID() == childTypeId);
+    if (! canInsertAll(itemsToInsert))
+    {
+        jassertfalse;
+        return false;
+    }
+    
+    if (! juce::isPositiveAndNotGreaterThan(index, children.size()))
+        index = children.size();
+    
+    beginBulkTransaction();
+    juce::ScopedValueSetter<bool> svs(ignoreCallback, true);
+    
+    juce::Array<WrappedTreeType*> inserted;
+    inserted.ensureStorageAllocated(itemsToInsert.size());
+    
+    for (auto* t : itemsToInsert)
+    {
+        if (insertChildTree(index + inserted.size(), t))
+            inserted.add(t);
+    }
+    
+    children.insertArray(index, inserted.begin(), inserted.size());
     
-    return children.add(t);
+    for (auto* t : inserted)
+        addToIndex(t);
+    
+    return inserted.size() == itemsToInsert.size();
+}
+
+template <typename WrappedTreeType, typename Allocator>
+bool WrappedTreeList<WrappedTreeType, Allocator>::canInsertAll(const juce::Array<WrappedTreeType*>& items) const
+{
+    for (auto* t : items)
+    {
+        if (t == nullptr) return false;
+        if (t->isValid() && t->getValueTree().getParent().isValid()) return false;
+    }
+    
+    // 同じ要素が二度含まれていると、二度目の挿入は既に親を持つため失敗する
+    auto sortedItems = items;
+    std::sort(sortedItems.begin(), sortedItems.end());
+    return std::adjacent_find(sortedItems.begin(), sortedItems.end()) == sortedItems.end();
 }
 
-template <typename WrappedTreeType>
-void WrappedTreeList<WrappedTreeType>::remove(WrappedTreeType* t)
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::remove(WrappedTreeType* t)
 {
     if (! isValid() || t == nullptr || t->getTypeID() != childTypeId)
     {
@@ -129,57 +550,332 @@ void WrappedTreeList<WrappedTreeType>::remove(WrappedTreeType* t)
     
     juce::ScopedValueSetter<bool> svs(ignoreCallback, true);
 
-    int index = children.indexOf(t);
-    if (index > 0)
+    // 保持していないオブジェクトは破棄しない(他のリストのAllocatorが所有している場合などがあるため)
+    const int index = children.indexOf(t);
+    if (index < 0)
+    {
+        jassertfalse;
+        return;
+    }
+    
+    valueTree.removeChild(index, undoManager);
+    children.remove(index);
+    destroyChild(t);
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::removeRange(int startIndex, int numberToRemove)
+{
+    if (! isValid())
+    {
+        jassertfalse;
+        return;
+    }
+    
+    const int endIndex = juce::jlimit(0, children.size(), startIndex + numberToRemove);
+    startIndex = juce::jlimit(0, children.size(), startIndex);
+    if (endIndex <= startIndex) return;
+    
+    beginBulkTransaction();
+    juce::ScopedValueSetter<bool> svs(ignoreCallback, true);
+    
+    // 後ろから削除することで残りの子ValueTreeの移動を減らす
+    for (int i = endIndex; --i >= startIndex;)
+        valueTree.removeChild(i, undoManager);
+    
+    for (int i = startIndex; i < endIndex; ++i)
+        destroyChild(children.getUnchecked(i));
+    
+    children.removeRange(startIndex, endIndex - startIndex);
+}
+
+template <typename WrappedTreeType, typename Allocator>
+template <typename PredicateType>
+int WrappedTreeList<WrappedTreeType, Allocator>::removeIf(PredicateType&& predicate)
+{
+    if (! isValid())
     {
-        valueTree.removeChild(index, nullptr);
+        jassertfalse;
+        return 0;
+    }
+    
+    juce::ScopedValueSetter<bool> svs(ignoreCallback, true);
+    
+    // 全ての要素を判定するため、遅延作成の要素はValueTreeから削除を始める前に作成しておく
+    // (削除後は要素のインデックスとValueTreeの子のインデックスが一致しなくなる)
+    createAllChildren();
+    
+    // 残す要素を前に詰めながら走査し、最後にまとめて末尾を切り詰める
+    const int numChildren = children.size();
+    int numKept = 0;
+    bool hasBegunTransaction = false;
+    
+    for (int i = 0; i < numChildren; ++i)
+    {
+        auto* t = children.getUnchecked(i);
+        
+        if (predicate(t))
+        {
+            if (! hasBegunTransaction)
+            {
+                beginBulkTransaction();
+                hasBegunTransaction = true;
+            }
+            
+            valueTree.removeChild(numKept, undoManager);
+            destroyChild(t);
+        }
+        else
+        {
+            children.setUnchecked(numKept++, t);
+        }
     }
-    else jassertfalse;
     
-    children.removeObject(t);
+    children.removeRange(numKept, numChildren - numKept);
+    return numChildren - numKept;
 }
 
-template <typename WrappedTreeType>
+template <typename WrappedTreeType, typename Allocator>
 template <typename ElementComparator>
-void WrappedTreeList<WrappedTreeType>::sort(ElementComparator& comparator, bool retainOrderOfEquivalentItems) noexcept
+void WrappedTreeList<WrappedTreeType, Allocator>::sort(ElementComparator& comparator, bool retainOrderOfEquivalentItems) noexcept
 {
     valueTree.sort(comparator, undoManager, retainOrderOfEquivalentItems);
 }
 
 
-template <typename WrappedTreeType>
-void WrappedTreeList<WrappedTreeType>::valueTreeChildAdded(juce::ValueTree& parent, juce::ValueTree& childWhichHasBeenAdded)
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::valueTreeChildAdded(juce::ValueTree& parent, juce::ValueTree& childWhichHasBeenAdded)
 {
+    VTWRAPPER_INSTRUMENT_SCOPE(childAdded, "WrappedTreeList", parent.getType(), {});
+
     if (ignoreCallback) return;
     if (parent != valueTree) return;
     
-    auto ptr = createNewChild(childWhichHasBeenAdded);
-    children.add(ptr);
+    // undo等で途中に追加された場合も順番を合わせる
+    auto ptr = createNewChildUnlessLazy(childWhichHasBeenAdded);
+    children.insert(parent.indexOf(childWhichHasBeenAdded), ptr);
+    addToIndex(ptr);
 }
 
-template <typename WrappedTreeType>
-void WrappedTreeList<WrappedTreeType>::valueTreeChildRemoved(juce::ValueTree& parent, juce::ValueTree& /*childWhichHasBeenRemoved*/, int indexFromWhichChildWasRemoved)
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::valueTreeChildRemoved(juce::ValueTree& parent, juce::ValueTree& /*childWhichHasBeenRemoved*/, int indexFromWhichChildWasRemoved)
 {
+    VTWRAPPER_INSTRUMENT_SCOPE(childRemoved, "WrappedTreeList", parent.getType(), {});
+
     if (ignoreCallback) return;
     if (parent != valueTree) return;
     
-    children.remove(indexFromWhichChildWasRemoved);
+    destroyChild(children.removeAndReturn(indexFromWhichChildWasRemoved));
 }
 
-template <typename WrappedTreeType>
-void WrappedTreeList<WrappedTreeType>::valueTreeChildOrderChanged(juce::ValueTree& parent, int oldIndex, int newIndex)
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::valueTreeChildOrderChanged(juce::ValueTree& parent, int oldIndex, int newIndex)
 {
     if (parent != valueTree) return;
     
     children.move(oldIndex, newIndex);
 }
 
-template <typename WrappedTreeType>
-WrappedTreeType* WrappedTreeList<WrappedTreeType>::createNewChild(juce::ValueTree& targetChild) const
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::valueTreePropertyChanged(juce::ValueTree& treeWhosePropertyHasChanged, const juce::Identifier& property)
+{
+    // 索引のキーの変更は要素ごとのIndexEntryで受け取るため、基底クラスでは何も行わない
+    VTWRAPPER_INSTRUMENT_SCOPE(propertyChanged, "WrappedTreeList", treeWhosePropertyHasChanged.getType(), property);
+}
+
+template <typename WrappedTreeType, typename Allocator>
+template <typename Function>
+void WrappedTreeList<WrappedTreeType, Allocator>::forEachInStorageOrder(Function&& function)
+{
+    int numVisited = 0;
+    allocator.forEach([&](WrappedTreeType& t)
+    {
+        ++numVisited;
+        function(t);
+    });
+    
+    if (numVisited == getNumMaterialisedChildren()) return;
+    
+    for (auto* t : children)
+        if (t != nullptr && ! allocator.owns(t))
+            function(*t);
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::setIndexKey(const juce::Identifier& key)
+{
+    // 登録済みのIndexEntryは古いキーで登録されているため、先に破棄する
+    clearIndex();
+    indexKey = key;
+    rebuildIndex();
+}
+
+template <typename WrappedTreeType, typename Allocator>
+WrappedTreeType* WrappedTreeList<WrappedTreeType, Allocator>::find(const juce::var& keyValue) const
+{
+    // キーが設定されていない
+    jassert(indexKey.isValid());
+    
+    const auto key = keyValue.toString();
+    auto it = childrenByKey.find(key);
+    if (it != childrenByKey.end())
+        return it->second;
+    
+    // 遅延作成で未作成の要素は索引に含まれないため、ValueTreeから探して作成する
+    if (lazyWrapping && getNumMaterialisedChildren() < children.size())
+    {
+        for (int i = 0; i < children.size(); ++i)
+        {
+            if (children.getUnchecked(i) != nullptr) continue;
+            
+            auto vt = valueTree.getChild(i);
+            WrappedTree::loadIfNeeded(vt);
+            
+            auto* property = vt.getPropertyPointer(indexKey);
+            if (property != nullptr && property->toString() == key)
+                return getOrCreateChild(i);
+        }
+    }
+    return nullptr;
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::addToIndex(WrappedTreeType* t)
+{
+    if (! indexKey.isValid() || t == nullptr) return;
+    
+    // キーとなるプロパティを持たない要素も、後からキーが設定された場合に備えて変更を受け取る
+    auto result = indexEntries.emplace(std::piecewise_construct, std::forward_as_tuple(t), std::forward_as_tuple(*this, *t));
+    if (! result.second) return;
+    
+    auto& entry = result.first->second;
+    linkIndexEntry(entry);
+    t->addPropertyClient(indexKey, &entry);
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::removeFromIndex(const WrappedTreeType* t)
+{
+    auto it = indexEntries.find(t);
+    if (it == indexEntries.end()) return;
+    
+    auto& entry = it->second;
+    unlinkIndexEntry(entry);
+    entry.child.removePropertyClient(indexKey, &entry);
+    indexEntries.erase(it);
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::linkIndexEntry(IndexEntry& entry)
+{
+    // キーとなるプロパティを持たない要素は索引に含めない
+    auto* keyValue = entry.child.getValueTree().getPropertyPointer(indexKey);
+    if (keyValue == nullptr) return;
+    
+    entry.key = keyValue->toString();
+    entry.hasKey = true;
+    childrenByKey.emplace(entry.key, &entry.child);
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::unlinkIndexEntry(IndexEntry& entry)
+{
+    if (! entry.hasKey) return;
+    
+    auto range = childrenByKey.equal_range(entry.key);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == &entry.child)
+        {
+            childrenByKey.erase(it);
+            break;
+        }
+    }
+    entry.key = {};
+    entry.hasKey = false;
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::updateIndexEntry(IndexEntry& entry)
+{
+    unlinkIndexEntry(entry);
+    linkIndexEntry(entry);
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::clearIndex()
+{
+    for (auto& pair : indexEntries)
+        pair.second.child.removePropertyClient(indexKey, &pair.second);
+    
+    childrenByKey.clear();
+    indexEntries.clear();
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::rebuildIndex()
+{
+    clearIndex();
+    if (! indexKey.isValid()) return;
+    
+    childrenByKey.reserve((size_t)children.size());
+    indexEntries.reserve((size_t)children.size());
+    for (auto* t : children)
+        addToIndex(t);
+}
+
+template <typename WrappedTreeType, typename Allocator>
+WrappedTreeType* WrappedTreeList<WrappedTreeType, Allocator>::createNewChild(juce::ValueTree& targetChild)
 {
-    auto newPtr = new WrappedTreeType();
+    WrappedTreeType* newPtr = nullptr;
+    {
+        VTWRAPPER_INSTRUMENT_SCOPE(allocation, "WrappedTreeList", childTypeId, {});
+        newPtr = allocator.create();
+    }
     newPtr->wrap(targetChild, childTypeId, undoManager);
     return newPtr;
 }
 
+template <typename WrappedTreeType, typename Allocator>
+bool WrappedTreeList<WrappedTreeType, Allocator>::insertChildTree(int index, WrappedTreeType* t)
+{
+    // 初期化前なら新たに子ValueTreeを作成して紐付ける
+    if (! t->isValid())
+    {
+        auto vtNewChild = juce::ValueTree(childTypeId);
+        valueTree.addChild(vtNewChild, index, undoManager);
+        t->wrap(vtNewChild, childTypeId, undoManager);
+    }
+    // 他のValueTreeに紐付いている場合は追加しない
+    else if (t->getValueTree().getParent().isValid())
+    {
+        jassertfalse;
+        return false;
+    }
+    else
+    {
+        valueTree.addChild(t->getValueTree(), index, undoManager);
+    }
+    
+    jassert(t->getTypeID() == childTypeId);
+    return true;
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::beginBulkTransaction()
+{
+    if (undoManager != nullptr)
+        undoManager->beginNewTransaction();
+}
+
+template <typename WrappedTreeType, typename Allocator>
+void WrappedTreeList<WrappedTreeType, Allocator>::destroyAllChildren()
+{
+    auto oldChildren = std::move(children);
+    children.clear();
+    
+    for (auto* t : oldChildren)
+        destroyChild(t);
+}
+
 } // namespace vtwrapper
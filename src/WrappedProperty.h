@@ -9,6 +9,12 @@
 
 #pragma once
 #include <juce_data_structures/juce_data_structures.h>
+#include "PropertyDispatcher.h"
+#include "Instrumentation.h"
+#include "RealtimeValue.h"
+#include "Constrainer.h"
+#include "UndoCoalescer.h"
+#include "AsyncChangeQueue.h"
 
 namespace vtwrapper
 {
@@ -19,6 +25,16 @@ namespace vtwrapper
  - juce::ValueTree::Listenerを使用する場合、想定の順番でリスナー関数が呼ばれないことがあったり取り扱いが難しいため、 @n
  このクラスの変更コールバックを使用することで値の制限などを行なった上で外部に通知することが可能。(そのためjuce::ValueTree::Listenerは非推奨)
  - プロパティと値を同期するため,プロパティのremove操作は行われない想定
+ - WrappedTree::wrapPropertiesAndChildren()内でWrappedTreeのValueTreeにreferTo()した場合は,そのWrappedTreeのPropertyDispatcher経由で通知を受け取る。 @n
+ それ以外の場合は自身をjuce::ValueTree::Listenerとして登録する。
+ - WrappedTree::ScopedTransactionの間はset()によるjuce::ValueTreeへの書き込みおよびonChangeの呼び出しが保留され、 @n
+ トランザクション終了時に最終値のみが書き込まれ、値が変化したプロパティのonChangeが一度だけ呼ばれる。
+ - setAsyncChangeNotification(true)の場合はonChangeを非同期に呼び出す。連続した変更は配信時に一度の呼び出しにまとめられる。(AsyncChangeQueue.hを参照)
+ - setUndoCoalescingWindow()もしくはbeginGesture()〜endGesture()により、スライダーのドラッグなどの連続したset()をひとつのUndo操作にまとめることが可能。(UndoCoalescer.hを参照)
+ - get()はメッセージスレッドからのみ呼び出せる。オーディオスレッドから読み出す場合はsetRealtimeReadEnabled(true)を呼んだ上でgetRealtime()を使用する。
+ - 値の制限処理および変更コールバックの型はテンプレート引数で指定可能。 @n
+ デフォルトでは共にstd::functionを用いるが、ConstrainerTypeにRangeConstrainerなどを指定すると制限処理がインライン展開され、 @n
+ CallbackTypeにjuce::FixedSizeFunctionを指定するとヒープ確保が行われなくなる。大量のプロパティを扱う場合はオブジェクトのサイズも小さくなる。(Constrainer.hを参照)
  
  CachedValueとは以下の点で異なる
  [キャッシュ / 同期]
@@ -30,22 +46,23 @@ namespace vtwrapper
  - WrappedPropertyでのデフォルト状態は,対象プロパティを除外せずに指定のデフォルト値をプロパティに書き込む
  */
 
-template <typename Type>
+template <typename Type, typename ConstrainerType = DynamicConstrainer<Type>, typename CallbackType = std::function<void()>>
 class WrappedProperty
 : private juce::ValueTree::Listener
+, private PropertyDispatcher::Client
 {
 public:
     //! デフォルトコンストラクタ。紐付けされていないためreferTo()を呼び出す必要がある
     WrappedProperty() = default;
     WrappedProperty(juce::ValueTree& tree, const juce::Identifier& property, juce::UndoManager* um) { referTo(tree, property, um); }
     WrappedProperty(juce::ValueTree& tree, const juce::Identifier& property, juce::UndoManager* um, const Type& defaultVal) { referTo(tree, property, um, defaultVal); }
-    ~WrappedProperty() override = default;
+    ~WrappedProperty() override { stopListening(); }
 
-    bool operator== (const WrappedProperty<Type>& other) const { return get() == other.get(); }
-    bool operator!= (const WrappedProperty<Type>& other) const { return ! operator== (other); }
+    bool operator== (const WrappedProperty& other) const { return get() == other.get(); }
+    bool operator!= (const WrappedProperty& other) const { return ! operator== (other); }
     bool operator== (const Type& other) const { return get() == other; }
     bool operator!= (const Type& other) const { return ! operator== (other); }
-    inline WrappedProperty<Type>& operator= (const Type& newValue) { set(newValue); return *this; }
+    inline WrappedProperty& operator= (const Type& newValue) { set(newValue); return *this; }
     
     Type get() const;
     void set(Type newValue);
@@ -56,7 +73,9 @@ public:
     void resetToDefault() { set(defaultValue); }
     
     void setDefault(const Type& defaultVal);
-    void setConstrainer(std::function<void(Type& newValue, bool isDefault)> newConstrainer);
+    //! @brief 値の制限処理を設定し、現在の値およびデフォルト値に適用する。referTo()の前に呼び出すことも可能
+    void setConstrainer(ConstrainerType newConstrainer);
+    const ConstrainerType& getConstrainer() const noexcept { return constrainer; }
 
     //! @brief デフォルト値の場合にjuce::ValueTreeのプロパティにもデフォルト値として保持しておくかどうか。
     //! @param shouldSync trueでは常にjuce::ValueTreeのプロパティとして保持され、falseではデフォルト値の場合にjuce::ValueTreeのプロパティから削除される。
@@ -64,6 +83,32 @@ public:
     void setSyncPropertyWhenDefault(bool shouldSync);
     bool isSyncPropertyWhenDefault() const { return syncPropertyWhenDefault; }
 
+    //! @brief リアルタイムスレッドから値を読み出せるようにするかどうか。
+    //! 有効にするとメッセージスレッドでの値の更新に合わせてgetRealtime()用の値も更新される。
+    //! @n 読み出し側スレッドでgetRealtime()を呼び出し始める前にメッセージスレッドで有効にしておく必要がある。
+    //! @n 読み出し用のバッファは最初に有効にした時に確保され、無効にしても破棄されない。(読み出し中のオーディオスレッドが解放済みのバッファを参照しないため)
+    void setRealtimeReadEnabled(bool shouldBeEnabled);
+    bool isRealtimeReadEnabled() const noexcept { return realtimeReadEnabled.load(std::memory_order_acquire); }
+    
+    //! @brief リアルタイムスレッドから値を読み出す。wait-freeかつメモリ確保を行わない
+    //! @n 読み出し側のスレッドはひとつである必要がある。
+    //! @n 無効の間は最後に公開された値を返し続ける。(一度も有効にしていなければ既定構築した値)
+    typename RealtimeValue<Type>::ReadType getRealtime() const noexcept;
+
+    //! @brief 最後のset()から指定時間内に続いたset()をひとつのUndo操作にまとめる。0の場合はまとめない
+    void setUndoCoalescingWindow(int milliseconds) { getUndoCoalescer().setWindow(milliseconds); }
+    int getUndoCoalescingWindow() const noexcept { return undoCoalescer != nullptr ? undoCoalescer->getWindow() : 0; }
+
+    //! @brief ドラッグなどの操作の開始時に呼び出す。endGesture()までのset()がひとつのUndo操作にまとめられる
+    void beginGesture() { getUndoCoalescer().beginGesture(); }
+    void endGesture() { getUndoCoalescer().endGesture(); }
+
+    //! @brief onChangeを非同期に呼び出すかどうか。有効な場合は変更時にqueueへ登録し、配信時にonChangeを一度だけ呼び出す
+    //! @n 要素の貼り付けなど連続した変更で、再描画などの重い処理が変更の数だけ繰り返されるのを防ぐ。配信までに元の値に戻った場合は呼び出さない。
+    //! 無効にした時点で配信待ちの変更があった場合は、その場でonChangeを呼び出す
+    void setAsyncChangeNotification(bool shouldBeAsync, AsyncChangeQueue& queue = AsyncChangeQueue::getSharedInstance());
+    bool isAsyncChangeNotification() const noexcept { return asyncNotifier != nullptr; }
+
     bool isValid() const { return targetTree.isValid() && targetProperty.isValid(); }
     juce::Value getPropertyAsValue() { jassert(isValid()); return targetTree.getPropertyAsValue(targetProperty, undoManager); }
     bool isUsingDefault() const { return getDefault() == get(); }
@@ -73,62 +118,123 @@ public:
     juce::UndoManager* getUndoManager() noexcept { return undoManager; }
     Type getDefault() const noexcept { return defaultValue; }
 
-    std::function<void()> onChange = nullptr;
+    CallbackType onChange = nullptr;
     
 private:
     void valueTreePropertyChanged(juce::ValueTree& changedTree, const juce::Identifier& changedProperty) override;
     void valueTreeRedirected(juce::ValueTree& treeWhichHasBeenChanged) override;
+    void dispatchedPropertyChanged() override { valueTreePropertyChanged(targetTree, targetProperty); }
+    void dispatcherDetached() override;
+    void commitPendingValue() override;
+    void flushDeferredChange() override;
+    
+    //! AsyncChangeQueueから配信を受け取るためのClient。非同期通知を使用する場合のみ作成する
+    class AsyncNotifier
+    : public AsyncChangeQueue::Client
+    {
+    public:
+        AsyncNotifier(WrappedProperty& ownerToUse, AsyncChangeQueue& queueToUse) : owner(ownerToUse), targetQueue(queueToUse) {}
+        void handleQueuedChange() override { owner.handleAsyncChange(); }
+        
+        WrappedProperty& owner;
+        AsyncChangeQueue& targetQueue;
+        Type valueBeforeChange {};
+    };
+    
+    void startListening();
+    void stopListening();
+    void updateRealtimeValue();
+    void writeToTree(Type newValue);
+    void deferChange(const Type& valueBeforeChange);
+    void resetTransactionState();
+    void notifyChange(const Type& valueBeforeChange);
+    void handleAsyncChange();
+    UndoCoalescer& getUndoCoalescer();
     
     juce::ValueTree targetTree;
     juce::Identifier targetProperty;
     juce::UndoManager* undoManager = nullptr;
+    PropertyDispatcher* dispatcher = nullptr;
     Type defaultValue;
     Type cachedValue;
+    Type valueBeforeTransaction;
     bool ignoreCallback = false;
     bool syncPropertyWhenDefault = false;
-    std::function<void(Type& newValue, bool isDefault)> constrainer = nullptr;
+    bool hasPendingWrite = false;
+    bool isChangeDeferred = false;
+    ConstrainerType constrainer;
+    std::unique_ptr<RealtimeValue<Type>> realtimeValue;
+    std::atomic<const RealtimeValue<Type>*> publishedRealtimeValue { nullptr };
+    std::atomic<bool> realtimeReadEnabled { false };
+    std::unique_ptr<UndoCoalescer> undoCoalescer;
+    std::unique_ptr<AsyncNotifier> asyncNotifier;
 };
 
 //==============================================================================
 // implementation
 //==============================================================================
-template <typename Type>
-void WrappedProperty<Type>::referTo(juce::ValueTree& tree, const juce::Identifier& property, juce::UndoManager* um, const Type& defaultVal)
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::referTo(juce::ValueTree& tree, const juce::Identifier& property, juce::UndoManager* um, const Type& defaultVal)
 {
     jassert(tree.isValid());
     jassert(property.isValid());
     
-    targetTree.removeListener (this);
+    stopListening();
     
     targetTree = tree;
     targetProperty = property;
     undoManager = um;
     defaultValue = defaultVal;
+    if (undoCoalescer != nullptr)
+        undoCoalescer->setTarget(targetTree, targetProperty, undoManager);
     valueTreePropertyChanged(targetTree, targetProperty);
 
-    targetTree.addListener (this);
+    startListening();
 }
 
-template <typename Type>
-Type WrappedProperty<Type>::get() const
+template <typename Type, typename ConstrainerType, typename CallbackType>
+Type WrappedProperty<Type, ConstrainerType, CallbackType>::get() const
 {
     return cachedValue;
 }
 
-template <typename Type>
-void WrappedProperty<Type>::set(Type newValue)
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::set(Type newValue)
 {
     if (! isValid())
     {
         jassertfalse;
         cachedValue = newValue;
+        updateRealtimeValue();
+        return;
+    }
+    
+    // トランザクション中はキャッシュのみ更新し、終了時にまとめて書き込む
+    if (dispatcher != nullptr && dispatcher->shouldDeferWrites())
+    {
+        if (constrainer)
+            constrainer(newValue, false);
+        
+        deferChange(cachedValue);
+        hasPendingWrite = true;
+        cachedValue = newValue;
+        updateRealtimeValue();
         return;
     }
     
+    writeToTree(newValue);
+}
+
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::writeToTree(Type newValue)
+{
+    // Undo操作をまとめている間はUndoManagerを経由せずに書き込む
+    auto* um = undoCoalescer != nullptr ? undoCoalescer->prepareWrite() : undoManager;
+    
     // デフォルト値同期offかつデフォルト値と同じ値の場合にプロパティ削除
     if (! syncPropertyWhenDefault && newValue == defaultValue)
     {
-        targetTree.removeProperty(targetProperty, undoManager);
+        targetTree.removeProperty(targetProperty, um);
     }
     // それ以外はpropertyをセット
     else
@@ -136,12 +242,46 @@ void WrappedProperty<Type>::set(Type newValue)
         if (constrainer) 
             constrainer(newValue, false);
         
-        targetTree.setProperty(targetProperty, juce::VariantConverter<Type>::toVar(newValue), undoManager);
+        targetTree.setProperty(targetProperty, juce::VariantConverter<Type>::toVar(newValue), um);
     }
 }
 
-template <typename Type>
-void WrappedProperty<Type>::setDefault(const Type& newDefaultVal)
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::setRealtimeReadEnabled(bool shouldBeEnabled)
+{
+    if (isRealtimeReadEnabled() == shouldBeEnabled) return;
+    
+    // バッファは破棄せずに使い回し、有効化の前に現在の値を反映しておく
+    if (shouldBeEnabled)
+    {
+        if (realtimeValue == nullptr)
+        {
+            realtimeValue = std::make_unique<RealtimeValue<Type>>(cachedValue);
+            publishedRealtimeValue.store(realtimeValue.get(), std::memory_order_release);
+        }
+        else
+            realtimeValue->store(cachedValue);
+    }
+    realtimeReadEnabled.store(shouldBeEnabled, std::memory_order_release);
+}
+
+template <typename Type, typename ConstrainerType, typename CallbackType>
+typename RealtimeValue<Type>::ReadType WrappedProperty<Type, ConstrainerType, CallbackType>::getRealtime() const noexcept
+{
+    // setRealtimeReadEnabled(true)を呼んでいない
+    jassert(isRealtimeReadEnabled());
+
+    // メッセージスレッドが書き換えるcachedValueは読まず、最後に公開された値を返す
+    if (auto* published = publishedRealtimeValue.load(std::memory_order_acquire))
+        return published->load();
+
+    // 一度も有効化されていない場合は、書き込まれることの無い既定値を返す
+    static const Type neverWritten {};
+    return neverWritten;
+}
+
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::setDefault(const Type& newDefaultVal)
 {
     defaultValue = newDefaultVal;
     if (constrainer) constrainer(defaultValue, true);
@@ -159,16 +299,20 @@ void WrappedProperty<Type>::setDefault(const Type& newDefaultVal)
     }
 }
 
-template <typename Type>
-void WrappedProperty<Type>::setConstrainer(std::function<void(Type& newValue, bool isDefault)> newConstrainer)
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::setConstrainer(ConstrainerType newConstrainer)
 {
-    constrainer = newConstrainer;
+    constrainer = std::move(newConstrainer);
+    
+    // 紐付け前の場合は保持のみ行い、referTo()時に現在の値に適用される
+    if (! isValid()) return;
+    
     setDefault(defaultValue);
     set(cachedValue);
 }
 
-template <typename Type>
-void WrappedProperty<Type>::setSyncPropertyWhenDefault(bool shouldSync)
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::setSyncPropertyWhenDefault(bool shouldSync)
 {
     if (syncPropertyWhenDefault == shouldSync) return;
     syncPropertyWhenDefault = shouldSync;
@@ -176,9 +320,11 @@ void WrappedProperty<Type>::setSyncPropertyWhenDefault(bool shouldSync)
 }
 
 //==============================================================================
-template <typename Type>
-void WrappedProperty<Type>::valueTreePropertyChanged(juce::ValueTree& changedTree, const juce::Identifier& changedProperty)
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::valueTreePropertyChanged(juce::ValueTree& changedTree, const juce::Identifier& changedProperty)
 {
+    VTWRAPPER_INSTRUMENT_SCOPE(propertyChanged, "WrappedProperty", changedTree.getType(), changedProperty);
+
     if (ignoreCallback) return;
     juce::ScopedValueSetter<bool> svs(ignoreCallback, true);
     
@@ -190,29 +336,44 @@ void WrappedProperty<Type>::valueTreePropertyChanged(juce::ValueTree& changedTre
     }
     
     auto lastValue = cachedValue;
+    
+    // juce::NamedValueSetの探索は線形のため、プロパティの取得は一度だけ行う
+    const auto* propertyValue = targetTree.getPropertyPointer(targetProperty);
         
+    if (propertyValue != nullptr)
+        cachedValue = juce::VariantConverter<Type>::fromVar(*propertyValue);
     // デフォルト同期offの場合にproperty削除された場合はキャッシュ値をデフォルトにする
-    if (!syncPropertyWhenDefault && targetTree.hasProperty(targetProperty) == false)
+    else if (! syncPropertyWhenDefault)
         cachedValue = defaultValue;
-    else if (targetTree.hasProperty(targetProperty))
-        cachedValue = juce::VariantConverter<Type>::fromVar(targetTree[targetProperty]);
     // デフォルト同期off以外でproperty削除されることは想定されていない
     else
         jassertfalse;
     
     if (constrainer) 
     {
+        const auto unconstrainedValue = cachedValue;
         constrainer(cachedValue, false);
-        if (targetTree.hasProperty(targetProperty))
+        
+        // 制限により値が変わった場合のみ書き戻す
+        if (propertyValue != nullptr && ! (cachedValue == unconstrainedValue))
         {
-            targetTree.setPropertyExcludingListener(this, targetProperty, juce::VariantConverter<Type>::toVar(cachedValue), undoManager);
+            auto* listenerToExclude = dispatcher != nullptr ? dispatcher->getListener() : this;
+            targetTree.setPropertyExcludingListener(listenerToExclude, targetProperty, juce::VariantConverter<Type>::toVar(cachedValue), undoManager);
         }
     }
-    if (lastValue != cachedValue && onChange) onChange();
+    updateRealtimeValue();
+    
+    if (lastValue == cachedValue) return;
+    
+    // トランザクション中は変更通知を保留する
+    if (dispatcher != nullptr && dispatcher->isInTransaction())
+        deferChange(lastValue);
+    else
+        notifyChange(lastValue);
 }
 
-template <typename Type>
-void WrappedProperty<Type>::valueTreeRedirected(juce::ValueTree& treeWhichHasBeenChanged)
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::valueTreeRedirected(juce::ValueTree& treeWhichHasBeenChanged)
 {
     if (ignoreCallback) return;
     juce::ScopedValueSetter<bool> svs(ignoreCallback, true);
@@ -220,4 +381,139 @@ void WrappedProperty<Type>::valueTreeRedirected(juce::ValueTree& treeWhichHasBee
     referTo(treeWhichHasBeenChanged, targetProperty, undoManager);
 }
 
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::updateRealtimeValue()
+{
+    if (isRealtimeReadEnabled())
+        realtimeValue->store(cachedValue);
+}
+
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::dispatcherDetached()
+{
+    dispatcher = nullptr;
+    resetTransactionState();
+    ListenerRegistrar::add(targetTree, this);
+}
+
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::commitPendingValue()
+{
+    if (! hasPendingWrite) return;
+    hasPendingWrite = false;
+    
+    if (isValid())
+        writeToTree(cachedValue);
+}
+
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::flushDeferredChange()
+{
+    if (! isChangeDeferred) return;
+    isChangeDeferred = false;
+    
+    // トランザクション中に元の値に戻った場合は通知しない
+    if (valueBeforeTransaction != cachedValue)
+        notifyChange(valueBeforeTransaction);
+}
+
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::notifyChange(const Type& valueBeforeChange)
+{
+    if (asyncNotifier == nullptr)
+    {
+        if (onChange)
+            onChange();
+        return;
+    }
+    
+    // 配信待ちの間は最初の変更前の値を保持する
+    if (asyncNotifier->isQueued()) return;
+    
+    asyncNotifier->valueBeforeChange = valueBeforeChange;
+    asyncNotifier->targetQueue.enqueue(asyncNotifier.get());
+}
+
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::handleAsyncChange()
+{
+    if (asyncNotifier->valueBeforeChange != cachedValue && onChange)
+        onChange();
+}
+
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::setAsyncChangeNotification(bool shouldBeAsync, AsyncChangeQueue& queue)
+{
+    if (asyncNotifier != nullptr)
+    {
+        if (shouldBeAsync && &asyncNotifier->targetQueue == &queue) return;
+        
+        // 配信待ちの変更は切り替え前に通知する
+        if (asyncNotifier->isQueued())
+        {
+            asyncNotifier->targetQueue.remove(asyncNotifier.get());
+            handleAsyncChange();
+        }
+        asyncNotifier = nullptr;
+    }
+    
+    if (shouldBeAsync)
+        asyncNotifier = std::make_unique<AsyncNotifier>(*this, queue);
+}
+
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::deferChange(const Type& valueBeforeChange)
+{
+    if (isChangeDeferred) return;
+    
+    isChangeDeferred = true;
+    valueBeforeTransaction = valueBeforeChange;
+    dispatcher->addPendingClient(this);
+}
+
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::resetTransactionState()
+{
+    hasPendingWrite = false;
+    isChangeDeferred = false;
+}
+
+template <typename Type, typename ConstrainerType, typename CallbackType>
+UndoCoalescer& WrappedProperty<Type, ConstrainerType, CallbackType>::getUndoCoalescer()
+{
+    if (undoCoalescer == nullptr)
+    {
+        undoCoalescer = std::make_unique<UndoCoalescer>();
+        undoCoalescer->setTarget(targetTree, targetProperty, undoManager);
+    }
+    return *undoCoalescer;
+}
+
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::startListening()
+{
+    // WrappedTree::wrap()中であれば、そのWrappedTreeのPropertyDispatcherを共有する
+    dispatcher = PropertyDispatcher::findActive(targetTree);
+    
+    if (dispatcher != nullptr)
+        dispatcher->addClient(targetProperty, this);
+    else
+        ListenerRegistrar::add(targetTree, this);
+}
+
+template <typename Type, typename ConstrainerType, typename CallbackType>
+void WrappedProperty<Type, ConstrainerType, CallbackType>::stopListening()
+{
+    if (dispatcher != nullptr)
+    {
+        dispatcher->removeClient(targetProperty, this);
+        dispatcher = nullptr;
+        resetTransactionState();
+    }
+    else
+    {
+        ListenerRegistrar::remove(targetTree, this);
+    }
+}
+
 } // namespace vtwrapper
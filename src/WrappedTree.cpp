@@ -8,27 +8,67 @@
 */
 
 #include "WrappedTree.h"
+#include "Instrumentation.h"
 
 namespace vtwrapper
 {
 
+std::atomic<WrappedTree::TreeLoader> WrappedTree::treeLoader { nullptr };
+
+//==============================================================================
+WrappedTree::ScopedTransaction::ScopedTransaction(WrappedTree& treeToBatch, const juce::String& transactionName)
+: target(treeToBatch), name(transactionName)
+{
+    target.propertyDispatcher.beginTransaction();
+}
+
+WrappedTree::ScopedTransaction::~ScopedTransaction()
+{
+    target.propertyDispatcher.endTransaction(target.undoManager, name);
+}
+
 //==============================================================================
 void WrappedTree::wrap(juce::ValueTree targetTree, const juce::Identifier& targetType, juce::UndoManager* um, bool allowCreationIfInvalid, bool allowChildWrapping)
+{
+    VTWRAPPER_INSTRUMENT_SCOPE(wrap, "WrappedTree", targetType, {});
+
+    if (setTarget(targetTree, targetType, um, allowCreationIfInvalid, allowChildWrapping))
+        bindPropertiesAndChildren();
+}
+
+void WrappedTree::wrapDeferred(juce::ValueTree targetTree, const juce::Identifier& targetType, juce::UndoManager* um, bool allowCreationIfInvalid, bool allowChildWrapping)
+{
+    if (setTarget(targetTree, targetType, um, allowCreationIfInvalid, allowChildWrapping))
+        isBindingDeferred = true;
+}
+
+void WrappedTree::ensureWrapped()
+{
+    if (isBindingDeferred && isValid())
+    {
+        VTWRAPPER_INSTRUMENT_SCOPE(wrap, "WrappedTree", typeId, {});
+        bindPropertiesAndChildren();
+    }
+}
+
+bool WrappedTree::setTarget(juce::ValueTree targetTree, const juce::Identifier& targetType, juce::UndoManager* um, bool allowCreationIfInvalid, bool allowChildWrapping)
 {
     jassert(targetType.isValid());
     
     typeId = targetType;
     undoManager = um;
     valueTree = targetTree;
+    isBindingDeferred = false;
 
     updateTreeIfNeeded(valueTree, typeId, undoManager, allowCreationIfInvalid, allowChildWrapping);
     
     if (valueTree.isValid() == false)
     {
+        propertyDispatcher.detach();
         jassertfalse;
-        return;
+        return false;
     }
-    wrapPropertiesAndChildren();
+    return true;
 }
 
 void WrappedTree::copyPropertiesAndChildrenFrom(const WrappedTree& copySource)
@@ -40,7 +80,7 @@ void WrappedTree::copyPropertiesAndChildrenFrom(const WrappedTree& copySource)
     }
     
     valueTree.copyPropertiesAndChildrenFrom(copySource.getValueTree(), undoManager);
-    wrapPropertiesAndChildren();
+    bindPropertiesAndChildren();
 }
 
 bool WrappedTree::isValid() const
@@ -48,6 +88,43 @@ bool WrappedTree::isValid() const
     return valueTree.isValid() && typeId.isValid() && valueTree.hasType(typeId);
 }
 
+void WrappedTree::bindPropertiesAndChildren()
+{
+    isBindingDeferred = false;
+    loadIfNeeded(valueTree);
+    propertyDispatcher.attachTo(valueTree);
+    
+    {
+        PropertyDispatcher::ScopedActivation activation(propertyDispatcher);
+        wrapPropertiesAndChildren();
+    }
+    
+    // 紐付けられたプロパティが無ければValueTreeの参照を保持しない
+    if (propertyDispatcher.getNumClients() == 0)
+        propertyDispatcher.detach();
+}
+
+void WrappedTree::addPropertyClient(const juce::Identifier& property, PropertyDispatcher::Client* client)
+{
+    if (! isValid())
+    {
+        jassertfalse;
+        return;
+    }
+    
+    // プロパティが紐付けられていない場合はPropertyDispatcherが切り離されているため、ここで紐付ける
+    propertyDispatcher.attachTo(valueTree);
+    propertyDispatcher.addClient(property, client);
+}
+
+void WrappedTree::removePropertyClient(const juce::Identifier& property, PropertyDispatcher::Client* client)
+{
+    propertyDispatcher.removeClient(property, client);
+    
+    if (propertyDispatcher.getNumClients() == 0)
+        propertyDispatcher.detach();
+}
+
 void WrappedTree::updateTreeIfNeeded(juce::ValueTree& targetTree, const juce::Identifier& targetType, juce::UndoManager* um, bool allowCreationIfInvalid, bool allowChildWrapping) // static
 {
     // 空の場合は新規作成する
@@ -65,6 +142,8 @@ void WrappedTree::updateTreeIfNeeded(juce::ValueTree& targetTree, const juce::Id
     // Type有効な子が無ければ新規作成する
     else if (allowChildWrapping)
     {
+        loadIfNeeded(targetTree);
+        
         if (allowCreationIfInvalid || targetTree.getChildWithName(targetType).isValid())
         {
             targetTree = targetTree.getOrCreateChildWithName(targetType, um);
@@ -9,6 +9,8 @@
 
 #pragma once
 #include <juce_data_structures/juce_data_structures.h>
+#include <atomic>
+#include "PropertyDispatcher.h"
 
 namespace vtwrapper
 {
@@ -18,10 +20,35 @@ namespace vtwrapper
  @brief juce::ValueTreeをラップする基底クラス
  このクラスを継承することでjuce::ValueTreeをメンバに持つ静的型付なクラスとして扱うことが可能になる。
  wrapPropertiesAndChildren()をoverrideし、ValueTreeがセットされた時の各プロパティや子要素の紐付けを行うことが可能。
+ wrapPropertiesAndChildren()内でvalueTreeに紐付けたWrappedPropertyはPropertyDispatcherを共有するため、 @n
+ プロパティ数に関わらずjuce::ValueTree::Listenerの登録はひとつとなる。
  */
 class WrappedTree
 {
 public:
+    //==============================================================================
+    /**
+     @brief スコープの間、このWrappedTreeのプロパティへの書き込みをまとめるトランザクション
+     - スコープ中のWrappedProperty::set()はjuce::ValueTreeへ書き込まれず、同じプロパティへの複数回の書き込みは最終値にまとめられる。
+     - スコープ中はonChangeの呼び出しが保留され、スコープ終了時に全ての書き込みを反映した後、値が変化したプロパティごとに一度だけ呼ばれる。
+     - スコープ終了時の書き込みはひとつのUndoトランザクションとして記録される。
+     - 対象はwrapPropertiesAndChildren()でこのWrappedTreeのValueTreeに紐付けたWrappedPropertyのみで、子のWrappedTreeは含まれない。
+     - 入れ子にすることが可能で、最も外側のスコープ終了時に反映される。
+     */
+    class ScopedTransaction
+    {
+    public:
+        explicit ScopedTransaction(WrappedTree& treeToBatch, const juce::String& transactionName = {});
+        ~ScopedTransaction();
+        
+    private:
+        WrappedTree& target;
+        juce::String name;
+        
+        JUCE_DECLARE_NON_COPYABLE(ScopedTransaction)
+    };
+    
+    //==============================================================================
     //! デフォルトコンストラクタ。紐付けされていないためwrap()を呼び出す必要がある
     WrappedTree() = default;
     
@@ -43,6 +70,19 @@ public:
      */
     void wrap(juce::ValueTree targetTree, const juce::Identifier& targetType, juce::UndoManager* um, bool allowCreationIfInvalid = true, bool allowChildWrapping = true);
     
+    /**
+     @brief wrap()と同様に紐付けを行うが、wrapPropertiesAndChildren()の呼び出しをensureWrapped()まで遅延する
+     @n 大きなツリーのうち実際に使用される部分のみを初期化したい場合に用いる。
+     ensureWrapped()が呼ばれるまでプロパティや子要素は紐付けられないため、それらにアクセスする前にensureWrapped()を呼び出す必要がある。
+     */
+    void wrapDeferred(juce::ValueTree targetTree, const juce::Identifier& targetType, juce::UndoManager* um, bool allowCreationIfInvalid = true, bool allowChildWrapping = true);
+    
+    //! @brief wrapDeferred()で遅延したwrapPropertiesAndChildren()の呼び出しを行う。既に呼び出し済みの場合は何もしない
+    void ensureWrapped();
+    
+    //! @brief 有効な状態かつwrapPropertiesAndChildren()による紐付けが完了しているか
+    bool isBound() const { return ! isBindingDeferred && isValid(); }
+    
     //! @brief コピーソースのプロパティと子で置き換えた後にwrapPropertiesAndChildren()を呼び出す
     //! 既にコピー元およびコピー先が有効な状態のWrappedTreeかつ同じTypeを持つ必要があり、そうでない場合は何も行わない。
     void copyPropertiesAndChildrenFrom(const WrappedTree& copySource);
@@ -54,8 +94,29 @@ public:
     const juce::Identifier& getTypeID() const noexcept { return typeId; }
     juce::UndoManager* getUndoManager() noexcept { return undoManager; }
     
+    //! @brief このWrappedTreeのValueTreeのpropertyの変更を、共有のPropertyDispatcher経由でclientに通知する
+    //! @n WrappedTreeListの索引など、WrappedPropertyを介さずに外部からプロパティを監視する場合に用いる。
+    //! 別のValueTreeにwrap()された場合はclient->dispatcherDetached()が呼ばれ、以降は通知されない
+    void addPropertyClient(const juce::Identifier& property, PropertyDispatcher::Client* client);
+    void removePropertyClient(const juce::Identifier& property, PropertyDispatcher::Client* client);
+    
     static void updateTreeIfNeeded(juce::ValueTree& targetTree, const juce::Identifier& targetType, juce::UndoManager* um, bool allowCreationIfInvalid, bool allowChildWrapping);
     
+    //==============================================================================
+    //! @brief 遅延して構築されるValueTreeを、紐付けの前に読み込む関数
+    using TreeLoader = void (*)(const juce::ValueTree& tree);
+    
+    //! @brief 紐付けの前に呼び出す読み込み関数を登録する。MappedSessionがopen()時に登録する
+    static void setTreeLoader(TreeLoader loader) noexcept { treeLoader.store(loader, std::memory_order_release); }
+    
+    //! @brief 登録された読み込み関数でtreeを読み込む。登録されていない場合は何もしない
+    //! @n WrappedTree、WrappedTreeList、UniquePtrなどが、treeのプロパティや子を参照する前に呼び出す
+    static void loadIfNeeded(const juce::ValueTree& tree)
+    {
+        if (auto loader = treeLoader.load(std::memory_order_acquire))
+            loader(tree);
+    }
+    
 protected:
     //! @brief wrap()でValueTreeがセットされた時の各プロパティや子要素の紐付けを行う初期化処理
     virtual void wrapPropertiesAndChildren() = 0;
@@ -65,7 +126,18 @@ protected:
     juce::Identifier typeId;
     
 private:
+    //! 引数に与えられた情報を紐付ける。有効なValueTreeを紐付けられなかった場合はfalseを返す
+    bool setTarget(juce::ValueTree targetTree, const juce::Identifier& targetType, juce::UndoManager* um, bool allowCreationIfInvalid, bool allowChildWrapping);
+    
+    //! PropertyDispatcherをアクティブにした上でwrapPropertiesAndChildren()を呼び出す
+    void bindPropertiesAndChildren();
+    
+    PropertyDispatcher propertyDispatcher;
+    bool isBindingDeferred = false;
+    
+    static std::atomic<TreeLoader> treeLoader;
     
+    JUCE_DECLARE_NON_COPYABLE(WrappedTree)
 };
 
 } // namespace vtwrapper
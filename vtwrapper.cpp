@@ -2,4 +2,15 @@
 #error "Incorrect use of cpp file"
 #endif
 
+#include "src/Instrumentation.cpp"
+#include "src/ListenerRegistrar.cpp"
+#include "src/ParallelFor.cpp"
+#include "src/PropertyDispatcher.cpp"
+#include "src/UndoCoalescer.cpp"
+#include "src/AsyncChangeQueue.cpp"
 #include "src/WrappedTree.cpp"
+#include "src/TreeIndex.cpp"
+#include "src/TreeSnapshot.cpp"
+#include "src/BinaryTreeFormat.cpp"
+#include "src/MappedSession.cpp"
+#include "src/TreeDelta.cpp"
@@ -19,7 +19,31 @@
 
 #define VTWRAPPER_H_INCLUDED
 
+//==============================================================================
+/** Config: VTWRAPPER_ENABLE_INSTRUMENTATION
+    リスナーのコールバック、wrap()、オブジェクトの確保の回数と時間をvtwrapper::Instrumentationで計測する。
+    無効な場合は計測のコードは展開されない。デフォルトは0
+*/
+
+#include "src/Hash.h"
+#include "src/Instrumentation.h"
+#include "src/ListenerRegistrar.h"
+#include "src/ParallelFor.h"
+#include "src/PropertyDispatcher.h"
+#include "src/RealtimeValue.h"
+#include "src/UndoCoalescer.h"
+#include "src/AsyncChangeQueue.h"
+#include "src/ObjectPool.h"
+#include "src/Constrainer.h"
 #include "src/WrappedProperty.h"
 #include "src/WrappedTree.h"
+#include "src/TreeIndex.h"
+#include "src/PropertySchema.h"
 #include "src/UniquePtr.h"
 #include "src/ValueTreeObjectList.h"
+#include "src/SortedWrappedTreeList.h"
+#include "src/PropertyColumn.h"
+#include "src/TreeSnapshot.h"
+#include "src/BinaryTreeFormat.h"
+#include "src/MappedSession.h"
+#include "src/TreeDelta.h"